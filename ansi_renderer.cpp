@@ -0,0 +1,183 @@
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "ansi_renderer.h"
+
+namespace
+{
+    winsize querySize()
+    {
+        winsize size = {};
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_row == 0 || size.ws_col == 0)
+        {
+            size.ws_row = 24;
+            size.ws_col = 80;
+        }
+        return size;
+    }
+}
+
+int AnsiRenderer::terminalHeight()
+{
+    return querySize().ws_row;
+}
+
+int AnsiRenderer::terminalWidth()
+{
+    return querySize().ws_col;
+}
+
+AnsiRenderer::AnsiRenderer(): CellRenderer(terminalHeight(), terminalWidth())
+{
+    this->mRestoreTermios = tcgetattr(STDIN_FILENO, &this->mSavedTermios) == 0;
+    if (this->mRestoreTermios)
+    {
+        termios raw = this->mSavedTermios;
+        raw.c_iflag &= ~(IXON | ICRNL | BRKINT | INPCK | ISTRIP);
+        // No output processing: '\n' is a plain line feed for the encoder
+        raw.c_oflag &= ~OPOST;
+        raw.c_lflag &= ~(ECHO | ICANON | ISIG | IEXTEN);
+        // read() returns immediately even when no key is waiting
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+    }
+    // Alternate screen, hidden cursor, then the state CellRenderer expects
+    this->writeAll("\x1b[?1049h\x1b[?25l" + resetSequence());
+    // Frames must never stall the game, see writeFrame()
+    this->mSavedFlags = fcntl(STDOUT_FILENO, F_GETFL);
+    if (this->mSavedFlags != -1)
+    {
+        fcntl(STDOUT_FILENO, F_SETFL, this->mSavedFlags | O_NONBLOCK);
+    }
+}
+
+AnsiRenderer::~AnsiRenderer()
+{
+    this->writeAll(this->mPending);
+    if (this->mSavedFlags != -1)
+    {
+        fcntl(STDOUT_FILENO, F_SETFL, this->mSavedFlags);
+    }
+    this->writeAll("\x1b[0m\x1b(B\x1b[?25h\x1b[?1049l");
+    if (this->mRestoreTermios)
+    {
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &this->mSavedTermios);
+    }
+}
+
+void AnsiRenderer::writeAll(const std::string& bytes)
+{
+    size_t written = 0;
+    while (written < bytes.size())
+    {
+        ssize_t n = write(STDOUT_FILENO, bytes.data() + written, bytes.size() - written);
+        this->mStats.writes ++;
+        if (n > 0)
+        {
+            written += n;
+        }
+        else if (n < 0 && errno == EAGAIN)
+        {
+            pollfd out = {STDOUT_FILENO, POLLOUT, 0};
+            poll(&out, 1, -1);
+        }
+        else if (n < 0 && errno != EINTR)
+        {
+            return;
+        }
+    }
+}
+
+void AnsiRenderer::flushPending()
+{
+    while (!this->mPending.empty())
+    {
+        ssize_t n = write(STDOUT_FILENO, this->mPending.data(), this->mPending.size());
+        this->mStats.writes ++;
+        if (n > 0)
+        {
+            this->mPending.erase(0, n);
+        }
+        else if (n < 0 && errno == EAGAIN)
+        {
+            this->mStats.wouldBlock ++;
+            return;
+        }
+        else if (n < 0 && errno != EINTR)
+        {
+            // The terminal is gone, nothing left to keep in sync
+            this->mPending.clear();
+            return;
+        }
+    }
+}
+
+bool AnsiRenderer::readyForFrame()
+{
+    this->flushPending();
+    return this->mPending.empty();
+}
+
+void AnsiRenderer::writeFrame(const std::string& frame)
+{
+    this->mPending = frame;
+    this->flushPending();
+}
+
+int AnsiRenderer::readKey()
+{
+    char buffer[64];
+    ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (n > 0)
+    {
+        this->mInput.append(buffer, n);
+    }
+    if (this->mInput.empty())
+    {
+        return ERR;
+    }
+
+    int key = static_cast<unsigned char>(this->mInput[0]);
+    size_t used = 1;
+    if (key == 27 && this->mInput.size() >= 3 && (this->mInput[1] == '[' || this->mInput[1] == 'O'))
+    {
+        // Arrow keys arrive as ESC [ A or, in application mode, ESC O A
+        switch (this->mInput[2])
+        {
+            case 'A': key = KEY_UP; break;
+            case 'B': key = KEY_DOWN; break;
+            case 'C': key = KEY_RIGHT; break;
+            case 'D': key = KEY_LEFT; break;
+        }
+        used = 3;
+    }
+    else if (key == '\r')
+    {
+        // ICRNL is off, make Enter look like it does under curses
+        key = 10;
+    }
+    else if (key == 127)
+    {
+        key = KEY_BACKSPACE;
+    }
+    this->mInput.erase(0, used);
+    return key;
+}
+
+int AnsiRenderer::waitKey()
+{
+    while (true)
+    {
+        int key = this->readKey();
+        if (key != ERR)
+        {
+            return key;
+        }
+        pollfd in = {STDIN_FILENO, POLLIN, 0};
+        poll(&in, 1, -1);
+    }
+}
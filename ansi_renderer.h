@@ -0,0 +1,41 @@
+#ifndef ANSI_RENDERER_H
+#define ANSI_RENDERER_H
+
+#include <string>
+#include <termios.h>
+
+#include "cell_renderer.h"
+
+// Talks to the terminal directly with ANSI escape sequences, without
+// curses. Every present() goes out in a single write() call. Output is
+// non-blocking: whatever a slow terminal refuses is kept and sent before
+// the next frame, and frames are coalesced until it has drained.
+class AnsiRenderer : public CellRenderer
+{
+public:
+    AnsiRenderer();
+    ~AnsiRenderer();
+
+    int readKey() override;
+    int waitKey() override;
+
+protected:
+    void writeFrame(const std::string& frame) override;
+    bool readyForFrame() override;
+
+private:
+    // Send as much of mPending as the terminal takes without blocking
+    void flushPending();
+    static int terminalHeight();
+    static int terminalWidth();
+    void writeAll(const std::string& bytes);
+
+    termios mSavedTermios;
+    bool mRestoreTermios;
+    int mSavedFlags;
+    std::string mPending;
+    // Bytes read from stdin that do not form a whole key yet
+    std::string mInput;
+};
+
+#endif
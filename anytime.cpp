@@ -0,0 +1,90 @@
+#include <algorithm>
+
+#include "anytime.h"
+
+namespace
+{
+    const long kLateMicros = 1000;
+}
+
+CancelToken::CancelToken()
+    : mDeadline(std::chrono::steady_clock::time_point::max()), mCancelled(false)
+{
+}
+
+void CancelToken::reset(std::chrono::steady_clock::time_point deadline)
+{
+    this->mDeadline = deadline;
+    this->mCancelled.store(false, std::memory_order_release);
+}
+
+void CancelToken::cancel()
+{
+    this->mCancelled.store(true, std::memory_order_release);
+}
+
+bool CancelToken::isCancelled() const
+{
+    if (this->mCancelled.load(std::memory_order_acquire))
+    {
+        return true;
+    }
+    if (std::chrono::steady_clock::now() >= this->mDeadline)
+    {
+        this->mCancelled.store(true, std::memory_order_release);
+        return true;
+    }
+    return false;
+}
+
+std::chrono::steady_clock::time_point CancelToken::getDeadline() const
+{
+    return this->mDeadline;
+}
+
+AnytimePlanner::AnytimePlanner()
+{
+    this->resetStats();
+}
+
+Direction AnytimePlanner::plan(const ClassicState& root, const CancelToken& token)
+{
+    bool truncated = false;
+    Direction move = this->search(root, token, truncated);
+
+    this->mStats.plans ++;
+    if (truncated)
+    {
+        this->mStats.truncated ++;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now > token.getDeadline())
+    {
+        long lateMicros = std::chrono::duration_cast<std::chrono::microseconds>(now - token.getDeadline()).count();
+        this->mStats.maxLateMicros = std::max(this->mStats.maxLateMicros, lateMicros);
+        if (lateMicros > kLateMicros)
+        {
+            this->mStats.late ++;
+        }
+    }
+    return move;
+}
+
+const AnytimeStats& AnytimePlanner::getStats() const
+{
+    return this->mStats;
+}
+
+double AnytimePlanner::getTruncatedPercent() const
+{
+    if (this->mStats.plans == 0)
+    {
+        return 0;
+    }
+    return 100.0 * this->mStats.truncated / this->mStats.plans;
+}
+
+void AnytimePlanner::resetStats()
+{
+    this->mStats = AnytimeStats{0, 0, 0, 0};
+}
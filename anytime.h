@@ -0,0 +1,68 @@
+#ifndef ANYTIME_H
+#define ANYTIME_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "classic_state.h"
+
+// Tells a search to stop. The tick scheduler resets it with the time the
+// move is due, and anyone may cancel it early, from any thread. Searches
+// poll it between units of work.
+class CancelToken
+{
+public:
+    CancelToken();
+
+    void reset(std::chrono::steady_clock::time_point deadline);
+    void cancel();
+    bool isCancelled() const;
+    std::chrono::steady_clock::time_point getDeadline() const;
+
+private:
+    std::chrono::steady_clock::time_point mDeadline;
+    // Latches once the deadline has passed, so polls after it skip the clock
+    mutable std::atomic<bool> mCancelled;
+};
+
+struct AnytimeStats
+{
+    long plans;
+    // Stopped by the token before the search had finished
+    long truncated;
+    // Returned more than a millisecond after the deadline
+    long late;
+    long maxLateMicros;
+};
+
+// A planner that can be stopped at any moment and still answer with the
+// best move it has found so far. A search ends either because it has
+// nothing left to refine or because the token was cancelled, and plan()
+// keeps count of how often it was the token.
+class AnytimePlanner
+{
+public:
+    AnytimePlanner();
+    virtual ~AnytimePlanner() {}
+
+    Direction plan(const ClassicState& root, const CancelToken& token);
+
+    virtual const char* getName() const = 0;
+    // How far recent searches got, short enough for the HUD
+    virtual std::string describe() const = 0;
+
+    const AnytimeStats& getStats() const;
+    // Percentage of plans the deadline cut short
+    double getTruncatedPercent() const;
+    void resetStats();
+
+protected:
+    // Sets truncated when the token stopped the search early
+    virtual Direction search(const ClassicState& root, const CancelToken& token, bool& truncated) = 0;
+
+private:
+    AnytimeStats mStats;
+};
+
+#endif
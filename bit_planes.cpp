@@ -0,0 +1,81 @@
+#include <algorithm>
+
+#include "bit_planes.h"
+
+BitPlanes::BitPlanes() : mWidth(0), mHeight(0), mWordsPerRow(0)
+{
+}
+
+void BitPlanes::reset(int width, int height, int planes)
+{
+    this->mWidth = width;
+    this->mHeight = height;
+    this->mWordsPerRow = (width + 63) / 64;
+    this->mWords.assign(static_cast<size_t>(planes) * height * this->mWordsPerRow, 0);
+}
+
+void BitPlanes::clear()
+{
+    std::fill(this->mWords.begin(), this->mWords.end(), 0);
+}
+
+uint64_t BitPlanes::straight(const uint64_t* words, int x, int count) const
+{
+    int word = x >> 6;
+    int shift = x & 63;
+    uint64_t bits = words[word] >> shift;
+    // The run spills into the next word
+    if (shift != 0 && shift + count > 64)
+    {
+        bits |= words[word + 1] << (64 - shift);
+    }
+    return count == 64 ? bits : bits & ((uint64_t(1) << count) - 1);
+}
+
+uint64_t BitPlanes::row(int plane, int x, int y, int count) const
+{
+    const uint64_t* words = &this->mWords[this->wordOf(plane, 0, y)];
+    int first = std::min(count, this->mWidth - x);
+    uint64_t bits = this->straight(words, x, first);
+    if (first < count)
+    {
+        // The rest comes from the left edge
+        bits |= this->straight(words, 0, count - first) << first;
+    }
+    return bits;
+}
+
+void BitPlanes::window(int plane, int cx, int cy, int radius, uint64_t* rows) const
+{
+    int side = 2 * radius + 1;
+    // Wrapped starting corner, the modulo keeps negative offsets on the board
+    int x = ((cx - radius) % this->mWidth + this->mWidth) % this->mWidth;
+    int y = ((cy - radius) % this->mHeight + this->mHeight) % this->mHeight;
+    for (int i = 0; i < side; i ++)
+    {
+        // One pass unless the board is narrower than the window, which
+        // then shows the same columns again
+        uint64_t bits = 0;
+        for (int done = 0; done < side; done += this->mWidth)
+        {
+            bits |= this->row(plane, x, y, std::min(this->mWidth, side - done)) << done;
+        }
+        rows[i] = bits;
+        y = y + 1 == this->mHeight ? 0 : y + 1;
+    }
+}
+
+int BitPlanes::getWidth() const
+{
+    return this->mWidth;
+}
+
+int BitPlanes::getHeight() const
+{
+    return this->mHeight;
+}
+
+int BitPlanes::getWordsPerRow() const
+{
+    return this->mWordsPerRow;
+}
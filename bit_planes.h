@@ -0,0 +1,65 @@
+#ifndef BIT_PLANES_H
+#define BIT_PLANES_H
+
+#include <cstdint>
+#include <vector>
+
+// A few one-bit images of a wrapping board, 64 cells per word. Every
+// row starts on a fresh word, so a run of cells is at most two words
+// and a shift apart. Owners keep the planes current by setting and
+// clearing the cells that change, instead of rebuilding them from the
+// snake and obstacle lists every tick.
+class BitPlanes
+{
+public:
+    BitPlanes();
+
+    void reset(int width, int height, int planes);
+    void clear();
+
+    void set(int plane, int x, int y)
+    {
+        this->mWords[this->wordOf(plane, x, y)] |= bitOf(x);
+    }
+    void unset(int plane, int x, int y)
+    {
+        this->mWords[this->wordOf(plane, x, y)] &= ~bitOf(x);
+    }
+    bool test(int plane, int x, int y) const
+    {
+        return (this->mWords[this->wordOf(plane, x, y)] & bitOf(x)) != 0;
+    }
+
+    // count (at most 64) cells of row y from column x on, wrapping at
+    // the right edge. Bit i is cell x + i.
+    uint64_t row(int plane, int x, int y, int count) const;
+    // The (2 * radius + 1) square centred on (cx, cy), wrapping on all
+    // sides: one word per row, top row first, bit i of a row is column
+    // cx - radius + i. radius may be at most kMaxRadius, so a row fits
+    // in a word.
+    void window(int plane, int cx, int cy, int radius, uint64_t* rows) const;
+    static const int kMaxRadius = 31;
+
+    int getWidth() const;
+    int getHeight() const;
+    int getWordsPerRow() const;
+
+private:
+    size_t wordOf(int plane, int x, int y) const
+    {
+        return (static_cast<size_t>(plane) * this->mHeight + y) * this->mWordsPerRow + (x >> 6);
+    }
+    static uint64_t bitOf(int x)
+    {
+        return uint64_t(1) << (x & 63);
+    }
+    // Bits [x, x + count) of a row that does not wrap
+    uint64_t straight(const uint64_t* words, int x, int count) const;
+
+    int mWidth;
+    int mHeight;
+    int mWordsPerRow;
+    std::vector<uint64_t> mWords;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "board_index.h"
+
+const int32_t BoardIndex::kEmpty;
+const int32_t BoardIndex::kObstacle;
+const int32_t BoardIndex::kFood;
+
+BoardIndex::BoardIndex(int width, int height): mWidth(width), mHeight(height), mAllocatedChunks(0)
+{
+    this->mChunksX = (width + kChunkSize - 1) >> kChunkBits;
+    this->clear();
+}
+
+int BoardIndex::getWidth() const
+{
+    return this->mWidth;
+}
+
+int BoardIndex::getHeight() const
+{
+    return this->mHeight;
+}
+
+void BoardIndex::clear()
+{
+    int chunksY = (this->mHeight + kChunkSize - 1) >> kChunkBits;
+    this->mChunks.clear();
+    this->mChunks.resize(this->mChunksX * chunksY);
+    this->mAllocatedChunks = 0;
+}
+
+BoardIndex::Chunk& BoardIndex::chunkAt(int x, int y)
+{
+    return this->mChunks[(y >> kChunkBits) * this->mChunksX + (x >> kChunkBits)];
+}
+
+void BoardIndex::set(int x, int y, int32_t value)
+{
+    Chunk& chunk = this->chunkAt(x, y);
+    if (chunk.values.empty())
+    {
+        if (value == kEmpty)
+        {
+            return;
+        }
+        chunk.values.assign(kChunkSize * kChunkSize, kEmpty);
+        chunk.blocked.assign(kChunkSize, 0);
+        this->mAllocatedChunks ++;
+    }
+    int32_t& cell = chunk.values[cellOffset(x, y)];
+    chunk.occupied += (value != kEmpty) - (cell != kEmpty);
+    cell = value;
+    uint32_t bit = uint32_t(1) << (x & (kChunkSize - 1));
+    if (value == kObstacle || isSnake(value))
+    {
+        chunk.blocked[y & (kChunkSize - 1)] |= bit;
+    }
+    else
+    {
+        chunk.blocked[y & (kChunkSize - 1)] &= ~bit;
+    }
+    if (chunk.occupied == 0)
+    {
+        // Claims of earlier ticks are worthless, and World::step() makes
+        // all claims of a tick before it clears any dead body
+        chunk.values = std::vector<int32_t>();
+        chunk.claims = std::vector<Claim>();
+        chunk.blocked = std::vector<uint32_t>();
+        this->mAllocatedChunks --;
+    }
+}
+
+int BoardIndex::claim(int x, int y, uint32_t tick, int id)
+{
+    Chunk& chunk = this->chunkAt(x, y);
+    if (chunk.claims.empty())
+    {
+        // Tick 0 is never used, so no cell starts out claimed
+        chunk.claims.assign(kChunkSize * kChunkSize, Claim{0, -1});
+    }
+    Claim& claim = chunk.claims[cellOffset(x, y)];
+    if (claim.tick == tick)
+    {
+        return claim.claimant;
+    }
+    claim.tick = tick;
+    claim.claimant = id;
+    return -1;
+}
+
+int BoardIndex::getAllocatedChunks() const
+{
+    return this->mAllocatedChunks;
+}
@@ -0,0 +1,111 @@
+#ifndef BOARD_INDEX_H
+#define BOARD_INDEX_H
+
+#include <cstdint>
+#include <vector>
+
+// Shared occupancy grid for boards with many snakes. Every cell knows
+// what is on it, so collision checks are one lookup instead of a scan
+// over every snake. Each cell also carries a per-tick claim used to
+// detect two heads entering the same cell during one simultaneous move.
+//
+// Cells are stored in 32x32 chunks that are allocated on the first write
+// and released again once nothing is left on them. An empty chunk reads
+// as empty cells, so a 10k x 10k arena only pays for the places snakes,
+// food and obstacles are.
+class BoardIndex
+{
+public:
+    static const int32_t kEmpty = 0;
+    static const int32_t kObstacle = -1;
+    static const int32_t kFood = -2;
+    // Snake n is stored as n + 1
+    static int32_t snakeValue(int id) { return id + 1; }
+    static int snakeId(int32_t value) { return value - 1; }
+    static bool isSnake(int32_t value) { return value > 0; }
+
+    static const int kChunkBits = 5;
+    static const int kChunkSize = 1 << kChunkBits;
+
+    BoardIndex(int width, int height);
+
+    int getWidth() const;
+    int getHeight() const;
+    void clear();
+
+    int32_t get(int x, int y) const
+    {
+        const Chunk& chunk = this->mChunks[(y >> kChunkBits) * this->mChunksX + (x >> kChunkBits)];
+        return chunk.values.empty() ? kEmpty : chunk.values[cellOffset(x, y)];
+    }
+    void set(int x, int y, int32_t value);
+
+    // Snakes and obstacles of the 32 cells from (x, y) on, x a multiple of
+    // kChunkSize, one bit per cell. Food is not in the way. Kept as cells
+    // are set, so reading a stretch of board costs a word per chunk row.
+    uint32_t getBlockedBits(int x, int y) const
+    {
+        const Chunk& chunk = this->mChunks[(y >> kChunkBits) * this->mChunksX + (x >> kChunkBits)];
+        return chunk.blocked.empty() ? 0 : chunk.blocked[y & (kChunkSize - 1)];
+    }
+
+    // Claim a cell for the given tick. Returns the id that already
+    // claimed it during the same tick, or -1 when this is the first claim.
+    int claim(int x, int y, uint32_t tick, int id);
+
+    // Calls visit(x, y, value) for every occupied cell, chunks that were
+    // never written are skipped
+    template <typename Visit>
+    void forEachOccupied(Visit visit) const
+    {
+        for (int c = 0; c < this->mChunks.size(); c ++)
+        {
+            const Chunk& chunk = this->mChunks[c];
+            if (chunk.occupied == 0)
+            {
+                continue;
+            }
+            int baseX = (c % this->mChunksX) << kChunkBits;
+            int baseY = (c / this->mChunksX) << kChunkBits;
+            for (int i = 0; i < chunk.values.size(); i ++)
+            {
+                if (chunk.values[i] != kEmpty)
+                {
+                    visit(baseX + (i & (kChunkSize - 1)), baseY + (i >> kChunkBits), chunk.values[i]);
+                }
+            }
+        }
+    }
+
+    // Chunks holding at least one occupied cell
+    int getAllocatedChunks() const;
+
+private:
+    struct Claim
+    {
+        uint32_t tick;
+        int32_t claimant;
+    };
+    struct Chunk
+    {
+        // Both empty until first needed
+        std::vector<int32_t> values;
+        std::vector<Claim> claims;
+        // Row masks for getBlockedBits, allocated along with values
+        std::vector<uint32_t> blocked;
+        int occupied = 0;
+    };
+    static int cellOffset(int x, int y)
+    {
+        return (y & (kChunkSize - 1)) << kChunkBits | (x & (kChunkSize - 1));
+    }
+    Chunk& chunkAt(int x, int y);
+
+    int mWidth;
+    int mHeight;
+    int mChunksX;
+    std::vector<Chunk> mChunks;
+    int mAllocatedChunks;
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+#include "bot.h"
+#include "flood_fill.h"
+
+namespace
+{
+    // Kept between calls so its rows are allocated once per thread
+    thread_local FloodFill tFill;
+
+    Direction turnLeft(Direction direction)
+    {
+        switch (direction) {
+            case Direction::Up:    return Direction::Left;
+            case Direction::Left:  return Direction::Down;
+            case Direction::Down:  return Direction::Right;
+            case Direction::Right: return Direction::Up;
+        }
+        return direction;
+    }
+
+    Direction turnRight(Direction direction)
+    {
+        switch (direction) {
+            case Direction::Up:    return Direction::Right;
+            case Direction::Right: return Direction::Down;
+            case Direction::Down:  return Direction::Left;
+            case Direction::Left:  return Direction::Up;
+        }
+        return direction;
+    }
+
+    // Where the cells of a FloodFill window lie on the playable area,
+    // which starts at (1, 1)
+    struct Window
+    {
+        int originX;
+        int originY;
+        int innerWidth;
+        int innerHeight;
+
+        int toX(int x) const
+        {
+            return ((x - 1 - this->originX) % this->innerWidth + this->innerWidth) % this->innerWidth;
+        }
+
+        int toY(int y) const
+        {
+            return ((y - 1 - this->originY) % this->innerHeight + this->innerHeight) % this->innerHeight;
+        }
+    };
+
+    // Bodies and obstacles around the head. A fill from a move never
+    // needs more than length cells, and all of them lie within length + 1
+    // moves of the head, so only that square is loaded. Where it covers
+    // the whole board it wraps like the board does. The bits come from
+    // the board index a chunk row at a time, so this costs the same on a
+    // small board and a huge arena.
+    Window loadBoard(const World& world, const WorldSnake& self, FloodFill& fill)
+    {
+        Window window;
+        window.innerWidth = world.getWidth() - 2;
+        window.innerHeight = world.getHeight() - 2;
+        int radius = self.body.size() + 1;
+        int width = std::min(window.innerWidth, 2 * radius + 1);
+        int height = std::min(window.innerHeight, 2 * radius + 1);
+        const SnakeBody& head = self.body.front();
+        window.originX = 0;
+        window.originY = 0;
+        if (width < window.innerWidth)
+        {
+            window.originX = window.toX(head.getX() - radius);
+        }
+        if (height < window.innerHeight)
+        {
+            window.originY = window.toY(head.getY() - radius);
+        }
+        fill.reset(width, height, width == window.innerWidth, height == window.innerHeight);
+
+        const BoardIndex& index = world.getIndex();
+        for (int y = 0; y < height; y ++)
+        {
+            int boardY = (window.originY + y) % window.innerHeight + 1;
+            // Up to the end of a chunk or of the playable row at a time
+            for (int x = 0; x < width; )
+            {
+                int boardX = (window.originX + x) % window.innerWidth + 1;
+                int chunkX = boardX & ~(BoardIndex::kChunkSize - 1);
+                int offset = boardX - chunkX;
+                int count = std::min(std::min(BoardIndex::kChunkSize - offset, width - x),
+                                     window.innerWidth + 1 - boardX);
+                fill.blockBits(x, y, index.getBlockedBits(chunkX, boardY) >> offset, count);
+                x += count;
+            }
+        }
+        // Our own tail moves on as we do
+        fill.unblock(window.toX(self.body.back().getX()), window.toY(self.body.back().getY()));
+        return window;
+    }
+}
+
+Direction chooseGreedyMove(const World& world, int id)
+{
+    const WorldSnake& snake = world.getSnakes()[id];
+    Direction forward = snake.movedDirection;
+    // Going straight first means ties keep the current heading
+    Direction candidates[3] = {forward, turnLeft(forward), turnRight(forward)};
+
+    Direction open[3];
+    int scores[3];
+    int count = 0;
+    for (Direction candidate : candidates)
+    {
+        SnakeBody head = world.nextHead(snake.body.front(), candidate);
+        int32_t value = world.getIndex().get(head.getX(), head.getY());
+        if (value != BoardIndex::kEmpty && value != BoardIndex::kFood)
+        {
+            continue;
+        }
+        int score = 0;
+        if (value != BoardIndex::kFood)
+        {
+            int distance = world.foodDistance(head);
+            score = distance < 0 ? INT_MAX - 1 : distance;
+        }
+        // Closest to the food first, keeping the order above on ties
+        int i = count ++;
+        for (; i > 0 && scores[i - 1] > score; i --)
+        {
+            open[i] = open[i - 1];
+            scores[i] = scores[i - 1];
+        }
+        open[i] = candidate;
+        scores[i] = score;
+    }
+    if (count == 0)
+    {
+        return forward;
+    }
+
+    // Of the moves that do not crash at once, take the best one that
+    // still leaves a way to the tail or room for the whole body. When
+    // every move walls the snake in, take the one with the most room.
+    FloodFill& fill = tFill;
+    Window window = loadBoard(world, snake, fill);
+    SnakeBody tail = snake.body.back();
+    int length = snake.body.size();
+    Direction roomiest = open[0];
+    int mostRoom = -1;
+    for (int i = 0; i < count; i ++)
+    {
+        SnakeBody head = world.nextHead(snake.body.front(), open[i]);
+        int room = fill.fill(window.toX(head.getX()), window.toY(head.getY()), length,
+                             window.toX(tail.getX()), window.toY(tail.getY()));
+        if (fill.reachedTarget() || room >= length)
+        {
+            return open[i];
+        }
+        if (room > mostRoom)
+        {
+            mostRoom = room;
+            roomiest = open[i];
+        }
+    }
+    return roomiest;
+}
+
+Direction chooseWeightedMove(const World& world, int id, const BotWeights& weights)
+{
+    const WorldSnake& snake = world.getSnakes()[id];
+    Direction forward = snake.movedDirection;
+    Direction candidates[3] = {forward, turnLeft(forward), turnRight(forward)};
+    Direction all[4] = {Direction::Up, Direction::Down, Direction::Left, Direction::Right};
+
+    FloodFill& fill = tFill;
+    Window window = loadBoard(world, snake, fill);
+    SnakeBody tail = snake.body.back();
+    int length = snake.body.size();
+    // Stands in for the distance to food when there is none
+    int noFood = world.getWidth() + world.getHeight();
+
+    Direction best = forward;
+    double bestScore = 0;
+    bool found = false;
+    for (Direction candidate : candidates)
+    {
+        SnakeBody head = world.nextHead(snake.body.front(), candidate);
+        int32_t value = world.getIndex().get(head.getX(), head.getY());
+        if (value != BoardIndex::kEmpty && value != BoardIndex::kFood)
+        {
+            continue;
+        }
+        int food = 0;
+        if (value != BoardIndex::kFood)
+        {
+            food = world.foodDistance(head);
+            food = food < 0 ? noFood : food;
+        }
+        int room = fill.fill(window.toX(head.getX()), window.toY(head.getY()), length,
+                             window.toX(tail.getX()), window.toY(tail.getY()));
+        double area = fill.reachedTarget() ? 1 : std::min(room, length) / static_cast<double>(length);
+        int walls = -1;
+        for (Direction direction : all)
+        {
+            SnakeBody next = world.nextHead(head, direction);
+            int32_t around = world.getIndex().get(next.getX(), next.getY());
+            walls += around != BoardIndex::kEmpty && around != BoardIndex::kFood;
+        }
+        double score = weights.food * food + weights.area * area
+                       + weights.tail * world.distance(head, tail) + weights.wall * walls;
+        // Ties keep the order above, straight on first
+        if (!found || score > bestScore)
+        {
+            best = candidate;
+            bestScore = score;
+            found = true;
+        }
+    }
+    return best;
+}
+
+Direction chooseRandomMove(const World& world, int id, Rng& rng)
+{
+    const WorldSnake& snake = world.getSnakes()[id];
+    Direction forward = snake.movedDirection;
+    Direction candidates[3] = {forward, turnLeft(forward), turnRight(forward)};
+    Direction open[3];
+    int count = 0;
+    for (Direction candidate : candidates)
+    {
+        SnakeBody head = world.nextHead(snake.body.front(), candidate);
+        int32_t value = world.getIndex().get(head.getX(), head.getY());
+        if (value == BoardIndex::kEmpty || value == BoardIndex::kFood)
+        {
+            open[count ++] = candidate;
+        }
+    }
+    return count == 0 ? forward : open[rng.nextInt(count)];
+}
@@ -0,0 +1,37 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include "world.h"
+#include "rng.h"
+
+// Greedy autopilot for World snakes: of the three moves that do not
+// reverse, take the closest one to the nearest food that does not run
+// straight into something, unless it leaves neither a way back to the
+// tail nor room for the body (see FloodFill).
+Direction chooseGreedyMove(const World& world, int id);
+
+// Weights for chooseWeightedMove. Every move that does not crash at once
+// is scored as the weighted sum of:
+//   food  distance to the nearest food from the new head
+//   area  share of the body that fits in the room left there, 0 to 1,
+//         or 1 when that room holds the tail
+//   tail  distance from the new head to the tail
+//   wall  cells next to the new head that are taken, not counting the
+//         one it came from
+// and the highest score wins. The defaults play much like the greedy bot,
+// snake-tune searches for better ones.
+struct BotWeights
+{
+    double food = -1;
+    double area = 10;
+    double tail = 0;
+    double wall = 0;
+};
+
+Direction chooseWeightedMove(const World& world, int id, const BotWeights& weights);
+
+// Any of the moves that do not run straight into something, a baseline
+// for the others to beat
+Direction chooseRandomMove(const World& world, int id, Rng& rng);
+
+#endif
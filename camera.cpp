@@ -0,0 +1,54 @@
+#include <algorithm>
+
+#include "camera.h"
+
+Camera::Camera()
+    : mViewWidth(0), mViewHeight(0), mBoardWidth(0), mBoardHeight(0), mX(0), mY(0), mCentred(false)
+{
+}
+
+void Camera::reset(int viewWidth, int viewHeight, int boardWidth, int boardHeight)
+{
+    this->mViewWidth = viewWidth;
+    this->mViewHeight = viewHeight;
+    this->mBoardWidth = boardWidth;
+    this->mBoardHeight = boardHeight;
+    this->mX = 0;
+    this->mY = 0;
+    this->mCentred = false;
+}
+
+void Camera::follow(int x, int y)
+{
+    if (!this->mCentred)
+    {
+        this->mX = std::max(0, std::min(this->mBoardWidth - this->mViewWidth, x - this->mViewWidth / 2));
+        this->mY = std::max(0, std::min(this->mBoardHeight - this->mViewHeight, y - this->mViewHeight / 2));
+        this->mCentred = true;
+        return;
+    }
+    this->mX = scrollAxis(this->mX, x, this->mViewWidth, this->mBoardWidth);
+    this->mY = scrollAxis(this->mY, y, this->mViewHeight, this->mBoardHeight);
+}
+
+int Camera::scrollAxis(int origin, int target, int view, int board)
+{
+    int margin = view / 4;
+    int offset = target - origin;
+    if (offset >= margin && offset < view - margin)
+    {
+        return origin;
+    }
+    // Boards that fit the window never scroll
+    return std::max(0, std::min(board - view, target - view / 2));
+}
+
+int Camera::getX() const
+{
+    return this->mX;
+}
+
+int Camera::getY() const
+{
+    return this->mY;
+}
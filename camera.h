@@ -0,0 +1,37 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+// Which part of a board larger than the game window is on screen.
+//
+// The camera follows a target cell with a dead zone: it stays put while
+// the target is away from the edges of the view and jumps to centre it
+// once it gets within a quarter view of one. Most ticks the view does
+// not move, so the cell renderer only sends the cells that changed
+// instead of a whole shifted screen.
+class Camera
+{
+public:
+    Camera();
+
+    // Cells the window shows, border included, and the whole board.
+    // The next follow() centres the target.
+    void reset(int viewWidth, int viewHeight, int boardWidth, int boardHeight);
+    void follow(int x, int y);
+
+    // Board cell shown in the top left corner of the window
+    int getX() const;
+    int getY() const;
+
+private:
+    static int scrollAxis(int origin, int target, int view, int board);
+
+    int mViewWidth;
+    int mViewHeight;
+    int mBoardWidth;
+    int mBoardHeight;
+    int mX;
+    int mY;
+    bool mCentred;
+};
+
+#endif
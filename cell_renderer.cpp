@@ -0,0 +1,424 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include "cell_renderer.h"
+
+namespace
+{
+    // Attribute bits the encoder knows how to express
+    const int kAttrMask = A_BOLD | A_REVERSE | A_STANDOUT | A_UNDERLINE | A_ALTCHARSET | A_COLOR;
+    const int kMaxColorPairs = 64;
+    // Rewriting up to this many unchanged cells is cheaper than a cursor move
+    const int kMaxGapFill = 3;
+    const Cell kBlank = {' ', 0};
+    const Cell kInvalid = {'\0', -1};
+}
+
+bool Cell::operator == (const Cell& cell) const
+{
+    return this->ch == cell.ch && this->attr == cell.attr;
+}
+
+bool Cell::operator != (const Cell& cell) const
+{
+    return !(*this == cell);
+}
+
+CellSurface::CellSurface(CellRenderer& owner, int height, int width, int startY, int startX)
+    : mOwner(owner), mHeight(height), mWidth(width), mStartY(startY), mStartX(startX),
+      mAttr(0), mVisible(false), mCells(height * width, kBlank)
+{
+}
+
+CellSurface::~CellSurface()
+{
+    this->mOwner.remove(this);
+}
+
+void CellSurface::setCell(int y, int x, char ch, int attr)
+{
+    if (y < 0 || y >= this->mHeight || x < 0 || x >= this->mWidth)
+    {
+        return;
+    }
+    this->mCells[y * this->mWidth + x] = Cell{ch, attr & kAttrMask};
+}
+
+void CellSurface::erase()
+{
+    std::fill(this->mCells.begin(), this->mCells.end(), kBlank);
+}
+
+void CellSurface::drawBox()
+{
+    // DEC special graphics: l k m j are the corners, q and x the lines
+    int bottom = this->mHeight - 1;
+    int right = this->mWidth - 1;
+    for (int x = 1; x < right; x ++)
+    {
+        this->setCell(0, x, 'q', A_ALTCHARSET);
+        this->setCell(bottom, x, 'q', A_ALTCHARSET);
+    }
+    for (int y = 1; y < bottom; y ++)
+    {
+        this->setCell(y, 0, 'x', A_ALTCHARSET);
+        this->setCell(y, right, 'x', A_ALTCHARSET);
+    }
+    this->setCell(0, 0, 'l', A_ALTCHARSET);
+    this->setCell(0, right, 'k', A_ALTCHARSET);
+    this->setCell(bottom, 0, 'm', A_ALTCHARSET);
+    this->setCell(bottom, right, 'j', A_ALTCHARSET);
+}
+
+void CellSurface::putChar(int y, int x, char ch)
+{
+    this->setCell(y, x, ch, this->mAttr);
+}
+
+void CellSurface::print(int y, int x, const std::string& text)
+{
+    for (int i = 0; i < text.size(); i ++)
+    {
+        this->setCell(y, x + i, text[i], this->mAttr);
+    }
+}
+
+void CellSurface::clearToEol(int y, int x)
+{
+    for (int i = x; i < this->mWidth; i ++)
+    {
+        this->setCell(y, i, ' ', 0);
+    }
+}
+
+void CellSurface::attrOn(int attr)
+{
+    // Like wattron, a new colour pair replaces the old one
+    if (attr & A_COLOR)
+    {
+        this->mAttr &= ~A_COLOR;
+    }
+    this->mAttr |= attr;
+}
+
+void CellSurface::attrOff(int attr)
+{
+    this->mAttr &= ~attr;
+}
+
+void CellSurface::show()
+{
+    this->mOwner.raise(this);
+    this->mVisible = true;
+}
+
+void CellSurface::hide()
+{
+    this->mOwner.remove(this);
+    this->mVisible = false;
+}
+
+bool CellSurface::isVisible() const
+{
+    return this->mVisible;
+}
+
+CellRenderer::CellRenderer(int height, int width)
+    : mHeight(height), mWidth(width),
+      mFront(height * width, kBlank), mBack(height * width, kBlank),
+      mCursorY(0), mCursorX(0), mCurrentAttr(0),
+      mPairForeground(kMaxColorPairs, -1), mPairBackground(kMaxColorPairs, -1)
+{
+    // The front buffer starts out as the screen left by resetSequence()
+}
+
+Surface* CellRenderer::createSurface(int height, int width, int startY, int startX)
+{
+    return new CellSurface(*this, height, width, startY, startX);
+}
+
+void CellRenderer::getScreenSize(int& height, int& width) const
+{
+    height = this->mHeight;
+    width = this->mWidth;
+}
+
+bool CellRenderer::hasColors() const
+{
+    return true;
+}
+
+void CellRenderer::initColorPair(short pair, short foreground, short background)
+{
+    if (pair <= 0 || pair >= kMaxColorPairs)
+    {
+        return;
+    }
+    if (this->mPairForeground[pair] == foreground && this->mPairBackground[pair] == background)
+    {
+        return;
+    }
+    this->mPairForeground[pair] = foreground;
+    this->mPairBackground[pair] = background;
+    // Cells already on screen in this pair now have the wrong colours
+    this->invalidate();
+}
+
+const RenderStats& CellRenderer::getStats() const
+{
+    return this->mStats;
+}
+
+const Cell& CellRenderer::getCell(int y, int x) const
+{
+    return this->mFront[y * this->mWidth + x];
+}
+
+void CellRenderer::invalidate()
+{
+    std::fill(this->mFront.begin(), this->mFront.end(), kInvalid);
+}
+
+const std::string& CellRenderer::resetSequence()
+{
+    // Default attributes, ASCII charset, cursor home, clear screen
+    static const std::string sequence = "\x1b[0m\x1b(B\x1b[H\x1b[2J";
+    return sequence;
+}
+
+void CellRenderer::raise(CellSurface* surface)
+{
+    this->remove(surface);
+    this->mStack.push_back(surface);
+}
+
+void CellRenderer::remove(CellSurface* surface)
+{
+    this->mStack.erase(std::remove(this->mStack.begin(), this->mStack.end(), surface), this->mStack.end());
+}
+
+void CellRenderer::compose()
+{
+    std::fill(this->mBack.begin(), this->mBack.end(), kBlank);
+    for (const CellSurface* surface : this->mStack)
+    {
+        for (int y = 0; y < surface->mHeight; y ++)
+        {
+            int screenY = surface->mStartY + y;
+            if (screenY < 0 || screenY >= this->mHeight)
+            {
+                continue;
+            }
+            int startX = std::max(0, -surface->mStartX);
+            int endX = std::min(surface->mWidth, this->mWidth - surface->mStartX);
+            if (startX >= endX)
+            {
+                continue;
+            }
+            const Cell* source = &surface->mCells[y * surface->mWidth];
+            std::copy(source + startX, source + endX,
+                      this->mBack.begin() + screenY * this->mWidth + surface->mStartX + startX);
+        }
+    }
+}
+
+namespace
+{
+    std::string horizontalMove(int fromX, int toX)
+    {
+        if (fromX == toX)
+        {
+            return "";
+        }
+        if (toX == 0)
+        {
+            return "\r";
+        }
+        int distance = std::abs(toX - fromX);
+        std::string count = distance == 1 ? "" : std::to_string(distance);
+        return "\x1b[" + count + (toX > fromX ? "C" : "D");
+    }
+
+    std::string verticalMove(int fromY, int toY)
+    {
+        if (fromY == toY)
+        {
+            return "";
+        }
+        int distance = std::abs(toY - fromY);
+        // Line feed only moves down because OPOST is off
+        if (toY > fromY && distance <= 3)
+        {
+            return std::string(distance, '\n');
+        }
+        std::string count = distance == 1 ? "" : std::to_string(distance);
+        return "\x1b[" + count + (toY > fromY ? "B" : "A");
+    }
+}
+
+void CellRenderer::moveCursor(int y, int x)
+{
+    if (this->mCursorY == y && this->mCursorX == x)
+    {
+        return;
+    }
+    std::string best = "\x1b[" + std::to_string(y + 1);
+    best += x == 0 ? "H" : ";" + std::to_string(x + 1) + "H";
+
+    // Relative moves only work while the cursor position is known
+    if (this->mCursorY >= 0 && this->mCursorX >= 0)
+    {
+        std::string relative = verticalMove(this->mCursorY, y) + horizontalMove(this->mCursorX, x);
+        if (relative.size() < best.size())
+        {
+            best = relative;
+        }
+        std::string fromLineStart = "\r" + verticalMove(this->mCursorY, y) + horizontalMove(0, x);
+        if (fromLineStart.size() < best.size())
+        {
+            best = fromLineStart;
+        }
+    }
+    this->mFrame += best;
+    this->mCursorY = y;
+    this->mCursorX = x;
+}
+
+void CellRenderer::appendColor(std::string& params, int pair, bool foreground) const
+{
+    short color = foreground ? this->mPairForeground[pair] : this->mPairBackground[pair];
+    if (!params.empty())
+    {
+        params += ";";
+    }
+    if (color < 0)
+    {
+        params += foreground ? "39" : "49";
+    }
+    else if (color < 8)
+    {
+        params += std::to_string((foreground ? 30 : 40) + color);
+    }
+    else
+    {
+        params += (foreground ? "38;5;" : "48;5;") + std::to_string(color);
+    }
+}
+
+void CellRenderer::setAttr(int attr)
+{
+    int current = this->mCurrentAttr;
+    if (attr == current)
+    {
+        return;
+    }
+    if ((attr ^ current) & A_ALTCHARSET)
+    {
+        this->mFrame += (attr & A_ALTCHARSET) ? "\x1b(0" : "\x1b(B";
+    }
+
+    std::string params;
+    auto toggle = [&](int mask, const char* on, const char* off) {
+        bool wasOn = (current & mask) != 0;
+        bool isOn = (attr & mask) != 0;
+        if (wasOn != isOn)
+        {
+            params += params.empty() ? "" : ";";
+            params += isOn ? on : off;
+        }
+    };
+    toggle(A_BOLD, "1", "22");
+    toggle(A_UNDERLINE, "4", "24");
+    toggle(A_REVERSE | A_STANDOUT, "7", "27");
+
+    int oldPair = PAIR_NUMBER(current);
+    int newPair = PAIR_NUMBER(attr);
+    if (this->mPairForeground[oldPair] != this->mPairForeground[newPair])
+    {
+        this->appendColor(params, newPair, true);
+    }
+    if (this->mPairBackground[oldPair] != this->mPairBackground[newPair])
+    {
+        this->appendColor(params, newPair, false);
+    }
+
+    if (!params.empty())
+    {
+        this->mFrame += "\x1b[" + params + "m";
+    }
+    this->mCurrentAttr = attr;
+}
+
+bool CellRenderer::readyForFrame()
+{
+    return true;
+}
+
+void CellRenderer::present()
+{
+    if (!this->readyForFrame())
+    {
+        // The front buffer is untouched, nothing drawn so far gets lost
+        this->mStats.coalesced ++;
+        return;
+    }
+    this->compose();
+    this->mFrame.clear();
+
+    for (int y = 0; y < this->mHeight; y ++)
+    {
+        for (int x = 0; x < this->mWidth; x ++)
+        {
+            int i = y * this->mWidth + x;
+            const Cell& cell = this->mBack[i];
+            if (cell == this->mFront[i])
+            {
+                continue;
+            }
+
+            // Coalesce runs: reprint a short gap of unchanged cells in the
+            // current attribute instead of jumping over it
+            int gap = x - this->mCursorX;
+            bool canFill = this->mCursorY == y && this->mCursorX >= 0 && gap > 0 && gap <= kMaxGapFill;
+            for (int j = i - gap; canFill && j < i; j ++)
+            {
+                canFill = this->mBack[j].attr == this->mCurrentAttr;
+            }
+            if (canFill)
+            {
+                for (int j = i - gap; j < i; j ++)
+                {
+                    this->mFrame += this->mBack[j].ch;
+                }
+                this->mCursorX = x;
+            }
+            else
+            {
+                this->moveCursor(y, x);
+            }
+
+            this->setAttr(cell.attr);
+            this->mFrame += cell.ch;
+            this->mFront[i] = cell;
+            this->mCursorX ++;
+            if (this->mCursorX >= this->mWidth)
+            {
+                // Pending wrap, terminals disagree on where the cursor is
+                this->mCursorY = -1;
+                this->mCursorX = -1;
+            }
+        }
+    }
+
+    this->mStats.frames ++;
+    this->mStats.stallMicros = 0;
+    if (!this->mFrame.empty())
+    {
+        this->mStats.bytes += this->mFrame.size();
+        auto start = std::chrono::steady_clock::now();
+        this->writeFrame(this->mFrame);
+        auto end = std::chrono::steady_clock::now();
+        this->mStats.stallMicros = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    }
+}
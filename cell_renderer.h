@@ -0,0 +1,115 @@
+#ifndef CELL_RENDERER_H
+#define CELL_RENDERER_H
+
+#include <string>
+#include <vector>
+
+#include "renderer.h"
+
+struct Cell
+{
+    char ch;
+    int attr;
+    bool operator == (const Cell& cell) const;
+    bool operator != (const Cell& cell) const;
+};
+
+class CellRenderer;
+
+// A surface backed by a plain cell array. Nothing reaches the terminal
+// until the owning CellRenderer composes the surface stack in present().
+class CellSurface : public Surface
+{
+public:
+    CellSurface(CellRenderer& owner, int height, int width, int startY, int startX);
+    ~CellSurface();
+    CellSurface(const CellSurface&) = delete;
+    CellSurface& operator = (const CellSurface&) = delete;
+
+    void erase() override;
+    void drawBox() override;
+    void putChar(int y, int x, char ch) override;
+    void print(int y, int x, const std::string& text) override;
+    void clearToEol(int y, int x) override;
+    void attrOn(int attr) override;
+    void attrOff(int attr) override;
+
+    void show() override;
+    void hide() override;
+    bool isVisible() const override;
+
+private:
+    friend class CellRenderer;
+    void setCell(int y, int x, char ch, int attr);
+
+    CellRenderer& mOwner;
+    const int mHeight;
+    const int mWidth;
+    const int mStartY;
+    const int mStartX;
+    int mAttr;
+    bool mVisible;
+    std::vector<Cell> mCells;
+};
+
+// Double-buffered compositor shared by the terminal-less backends.
+// present() flattens the visible surfaces into the back buffer, diffs it
+// against the front buffer (what the terminal shows) and encodes only the
+// changed cells with the shortest cursor moves and SGR changes it can find.
+// Subclasses decide where the encoded frame goes.
+class CellRenderer : public Renderer
+{
+public:
+    CellRenderer(int height, int width);
+
+    Surface* createSurface(int height, int width, int startY, int startX) override;
+    void getScreenSize(int& height, int& width) const override;
+
+    bool hasColors() const override;
+    void initColorPair(short pair, short foreground, short background) override;
+
+    void present() override;
+
+    const RenderStats& getStats() const override;
+
+    // What the terminal currently shows
+    const Cell& getCell(int y, int x) const;
+    // Forget the front buffer so that the next frame repaints everything
+    void invalidate();
+
+protected:
+    // Called at most once per present() with the encoded frame
+    virtual void writeFrame(const std::string& frame) = 0;
+    // False while the previous frame is still on its way out. present()
+    // then skips the frame, the next one carries the accumulated changes.
+    virtual bool readyForFrame();
+    // Escape sequences that put the terminal in the state the encoder assumes
+    static const std::string& resetSequence();
+
+    RenderStats mStats;
+
+private:
+    friend class CellSurface;
+    void raise(CellSurface* surface);
+    void remove(CellSurface* surface);
+
+    void compose();
+    void moveCursor(int y, int x);
+    void setAttr(int attr);
+    void appendColor(std::string& params, int pair, bool foreground) const;
+
+    const int mHeight;
+    const int mWidth;
+    // Visible surfaces, bottom first
+    std::vector<CellSurface*> mStack;
+    std::vector<Cell> mFront;
+    std::vector<Cell> mBack;
+    std::string mFrame;
+    int mCursorY;
+    int mCursorX;
+    int mCurrentAttr;
+    std::vector<short> mPairForeground;
+    std::vector<short> mPairBackground;
+};
+
+#endif
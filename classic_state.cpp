@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "classic_state.h"
+
+namespace
+{
+    const int kFoodTries = 64;
+
+    // What a cell key stands for, kind 0 is left to the directions
+    enum KeyKind { BODY_KEY = 1, HEAD_KEY, FOOD_KEY, OBSTACLE_KEY };
+
+    Direction turnLeft(Direction direction)
+    {
+        switch (direction) {
+            case Direction::Up:    return Direction::Left;
+            case Direction::Left:  return Direction::Down;
+            case Direction::Down:  return Direction::Right;
+            case Direction::Right: return Direction::Up;
+        }
+        return direction;
+    }
+
+    Direction turnRight(Direction direction)
+    {
+        switch (direction) {
+            case Direction::Up:    return Direction::Right;
+            case Direction::Right: return Direction::Down;
+            case Direction::Down:  return Direction::Left;
+            case Direction::Left:  return Direction::Up;
+        }
+        return direction;
+    }
+}
+
+ClassicState::ClassicState()
+    : mWidth(0), mHeight(0), mDistances(nullptr), mHead(0), mLength(0), mFood(-1), mDirection(Direction::Up), mAlive(false), mHash(0)
+{
+}
+
+void ClassicState::load(int boardWidth, int boardHeight, const std::vector<SnakeBody>& snake, Direction direction,
+                        const SnakeBody& food, const std::vector<Obstacle>& obstacles)
+{
+    this->mWidth = boardWidth;
+    this->mHeight = boardHeight;
+    this->mCells.assign(static_cast<size_t>(boardWidth) * boardHeight, EMPTY);
+    this->mBody.assign(this->mCells.size(), 0);
+    for (const Obstacle& obs : obstacles)
+    {
+        if (obs.x >= 0 && obs.x < boardWidth && obs.y >= 0 && obs.y < boardHeight)
+        {
+            this->mCells[obs.y * boardWidth + obs.x] = OBSTACLE;
+        }
+    }
+    // Tail in slot 0, head in slot length - 1
+    this->mLength = snake.size();
+    for (int i = 0; i < this->mLength; i ++)
+    {
+        const SnakeBody& part = snake[this->mLength - 1 - i];
+        this->mBody[i] = part.getY() * boardWidth + part.getX();
+        this->mCells[this->mBody[i]] = BODY;
+    }
+    this->mHead = this->mLength - 1;
+    this->mFood = food.getY() * boardWidth + food.getX();
+    this->mDirection = direction;
+    this->mAlive = this->mLength > 0;
+    this->mHash = this->computeHash();
+}
+
+void ClassicState::setDistances(const DistanceTable* distances)
+{
+    this->mDistances = distances;
+}
+
+void ClassicState::copyFrom(const ClassicState& other)
+{
+    this->mWidth = other.mWidth;
+    this->mHeight = other.mHeight;
+    this->mDistances = other.mDistances;
+    // Same sizes every time, so the vectors keep their storage
+    this->mCells = other.mCells;
+    this->mBody = other.mBody;
+    this->mHead = other.mHead;
+    this->mLength = other.mLength;
+    this->mFood = other.mFood;
+    this->mDirection = other.mDirection;
+    this->mAlive = other.mAlive;
+    this->mHash = other.mHash;
+}
+
+int ClassicState::nextCell(Direction direction) const
+{
+    int cell = this->mBody[this->mHead];
+    int x = cell % this->mWidth;
+    int y = cell / this->mWidth;
+    switch (direction) {
+        case Direction::Up:    y--; break;
+        case Direction::Down:  y++; break;
+        case Direction::Left:  x--; break;
+        case Direction::Right: x++; break;
+    }
+    // Inside the border the board wraps, as in Snake::createNewHead
+    if (x < 1) x = this->mWidth - 2;
+    else if (x >= this->mWidth - 1) x = 1;
+    if (y < 1) y = this->mHeight - 2;
+    else if (y >= this->mHeight - 1) y = 1;
+    return y * this->mWidth + x;
+}
+
+bool ClassicState::isFree(int cell) const
+{
+    return this->mCells[cell] == EMPTY;
+}
+
+int ClassicState::foodDistance(int cell) const
+{
+    if (this->mFood < 0)
+    {
+        return -1;
+    }
+    if (this->mDistances != nullptr)
+    {
+        return this->mDistances->distance(cell, this->mFood);
+    }
+    int spanX = this->mWidth - 2;
+    int spanY = this->mHeight - 2;
+    int dx = std::abs(cell % this->mWidth - this->mFood % this->mWidth);
+    int dy = std::abs(cell / this->mWidth - this->mFood / this->mWidth);
+    return std::min(dx, spanX - dx) + std::min(dy, spanY - dy);
+}
+
+int ClassicState::step(Direction direction, Rng& rng)
+{
+    Undo undo;
+    return this->step(direction, rng, undo);
+}
+
+int ClassicState::step(Direction direction, Rng& rng, Undo& undo)
+{
+    undo = Undo{this->mHead, this->mLength, this->mFood, -1, this->mDirection, this->mAlive, this->mHash};
+    this->mHash ^= directionKey(this->mDirection) ^ directionKey(direction);
+    this->mDirection = direction;
+    int next = this->nextCell(direction);
+    // The tail has not moved yet, the game counts it as body too
+    if (this->mCells[next] != EMPTY)
+    {
+        this->mAlive = false;
+        return -1;
+    }
+    int capacity = this->mBody.size();
+    this->mHash ^= cellKey(this->mBody[this->mHead], HEAD_KEY) ^ cellKey(next, HEAD_KEY) ^ cellKey(next, BODY_KEY);
+    this->mHead = this->mHead + 1 == capacity ? 0 : this->mHead + 1;
+    this->mBody[this->mHead] = next;
+    this->mCells[next] = BODY;
+    if (next == this->mFood)
+    {
+        this->mLength ++;
+        this->placeFood(rng);
+        return 1;
+    }
+    int tail = (this->mHead - this->mLength + capacity) % capacity;
+    undo.tail = this->mBody[tail];
+    this->mCells[undo.tail] = EMPTY;
+    this->mHash ^= cellKey(undo.tail, BODY_KEY);
+    return 0;
+}
+
+void ClassicState::undo(const Undo& undo)
+{
+    // A crash changed no cells, a move filled the new head's
+    if (this->mAlive)
+    {
+        this->mCells[this->mBody[this->mHead]] = EMPTY;
+    }
+    if (undo.tail >= 0)
+    {
+        this->mCells[undo.tail] = BODY;
+    }
+    this->mHead = undo.head;
+    this->mLength = undo.length;
+    this->mFood = undo.food;
+    this->mDirection = undo.direction;
+    this->mAlive = undo.alive;
+    this->mHash = undo.hash;
+}
+
+void ClassicState::getMoves(Direction moves[3]) const
+{
+    moves[0] = this->mDirection;
+    moves[1] = turnLeft(this->mDirection);
+    moves[2] = turnRight(this->mDirection);
+}
+
+void ClassicState::placeFood(Rng& rng)
+{
+    if (this->mFood >= 0)
+    {
+        this->mHash ^= cellKey(this->mFood, FOOD_KEY);
+    }
+    this->mFood = -1;
+    for (int i = 0; i < kFoodTries; i ++)
+    {
+        int cell = (rng.nextInt(this->mHeight - 2) + 1) * this->mWidth + rng.nextInt(this->mWidth - 2) + 1;
+        if (this->mCells[cell] == EMPTY)
+        {
+            this->mFood = cell;
+            this->mHash ^= cellKey(cell, FOOD_KEY);
+            return;
+        }
+    }
+}
+
+uint64_t ClassicState::cellKey(int cell, int kind)
+{
+    return mixBits(static_cast<uint64_t>(cell) << 3 | kind);
+}
+
+uint64_t ClassicState::directionKey(Direction direction)
+{
+    // Plus one, mixBits(0) is 0
+    return mixBits((static_cast<uint64_t>(direction) + 1) << 3);
+}
+
+bool ClassicState::isAlive() const
+{
+    return this->mAlive;
+}
+
+Direction ClassicState::getDirection() const
+{
+    return this->mDirection;
+}
+
+int ClassicState::getHead() const
+{
+    return this->mBody[this->mHead];
+}
+
+uint64_t ClassicState::getHash() const
+{
+    return this->mHash;
+}
+
+uint64_t ClassicState::computeHash() const
+{
+    uint64_t hash = directionKey(this->mDirection);
+    for (int cell = 0; cell < this->mCells.size(); cell ++)
+    {
+        if (this->mCells[cell] == BODY)
+        {
+            hash ^= cellKey(cell, BODY_KEY);
+        }
+        else if (this->mCells[cell] == OBSTACLE)
+        {
+            hash ^= cellKey(cell, OBSTACLE_KEY);
+        }
+    }
+    if (this->mLength > 0)
+    {
+        hash ^= cellKey(this->mBody[this->mHead], HEAD_KEY);
+    }
+    if (this->mFood >= 0)
+    {
+        hash ^= cellKey(this->mFood, FOOD_KEY);
+    }
+    return hash;
+}
@@ -0,0 +1,92 @@
+#ifndef CLASSIC_STATE_H
+#define CLASSIC_STATE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "snake.h"
+#include "map.h"
+#include "distance_table.h"
+#include "rng.h"
+
+// The classic game reduced to what a search needs: a cell grid and the
+// body as a ring of cell indices. Copying one into another reuses the
+// storage, so simulations allocate nothing once the first copy is made.
+// Moves wrap around the board like Snake::createNewHead, food eaten
+// during a simulation comes back at a random free cell.
+//
+// The state keeps a Zobrist hash of itself: the XOR of one key per body
+// cell, the head cell, the direction, the food cell and the obstacles.
+// A step changes a handful of keys, so the hash follows along in O(1).
+// Equal states hash equal, which makes the hash a cheap way to find
+// states a search has seen before, or to check a replay against the
+// game it came from. Keys are mixed from what they stand for, like in
+// World::boardHash, so they are the same in every run.
+class ClassicState
+{
+public:
+    ClassicState();
+
+    void load(int boardWidth, int boardHeight, const std::vector<SnakeBody>& snake, Direction direction,
+              const SnakeBody& food, const std::vector<Obstacle>& obstacles);
+    void copyFrom(const ClassicState& other);
+    // Food distances go around obstacles once the map's table is set,
+    // the table has to outlive the state
+    void setDistances(const DistanceTable* distances);
+
+    // What step() changed, enough for undo() to put it back
+    struct Undo
+    {
+        int head;
+        int length;
+        int food;
+        int tail;
+        Direction direction;
+        bool alive;
+        uint64_t hash;
+    };
+
+    // +1 for food, -1 for a crash, 0 otherwise
+    int step(Direction direction, Rng& rng);
+    int step(Direction direction, Rng& rng, Undo& undo);
+    // Takes back the step that filled in undo. Steps are undone newest
+    // first, so depth-first searches need only one state.
+    void undo(const Undo& undo);
+    // Forward, left and right of the current direction
+    void getMoves(Direction moves[3]) const;
+    // Cell the head would move to
+    int nextCell(Direction direction) const;
+    bool isFree(int cell) const;
+    // Moves to the food ignoring the body: around obstacles with a
+    // distance table, wrapped Manhattan without. -1 without food or
+    // without a way there.
+    int foodDistance(int cell) const;
+
+    bool isAlive() const;
+    Direction getDirection() const;
+    int getHead() const;
+    uint64_t getHash() const;
+    // The same hash worked out from scratch
+    uint64_t computeHash() const;
+
+private:
+    enum Cell : uint8_t { EMPTY, BODY, OBSTACLE };
+    void placeFood(Rng& rng);
+    static uint64_t cellKey(int cell, int kind);
+    static uint64_t directionKey(Direction direction);
+
+    int mWidth;
+    int mHeight;
+    const DistanceTable* mDistances;
+    std::vector<uint8_t> mCells;
+    // Ring of body cells, mHead is the slot of the head
+    std::vector<int> mBody;
+    int mHead;
+    int mLength;
+    int mFood;
+    Direction mDirection;
+    bool mAlive;
+    uint64_t mHash;
+};
+
+#endif
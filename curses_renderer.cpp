@@ -0,0 +1,150 @@
+#include <chrono>
+
+#include "curses_renderer.h"
+
+CursesSurface::CursesSurface(int height, int width, int startY, int startX): mVisible(false)
+{
+    this->mWindow = newwin(height, width, startY, startX);
+    this->mPanel = new_panel(this->mWindow);
+    // Panels start visible, keep it off screen until someone shows it
+    hide_panel(this->mPanel);
+}
+
+CursesSurface::~CursesSurface()
+{
+    del_panel(this->mPanel);
+    delwin(this->mWindow);
+}
+
+void CursesSurface::erase()
+{
+    werase(this->mWindow);
+}
+
+void CursesSurface::drawBox()
+{
+    box(this->mWindow, 0, 0);
+}
+
+void CursesSurface::putChar(int y, int x, char ch)
+{
+    mvwaddch(this->mWindow, y, x, ch);
+}
+
+void CursesSurface::print(int y, int x, const std::string& text)
+{
+    mvwaddstr(this->mWindow, y, x, text.c_str());
+}
+
+void CursesSurface::clearToEol(int y, int x)
+{
+    wmove(this->mWindow, y, x);
+    wclrtoeol(this->mWindow);
+}
+
+void CursesSurface::attrOn(int attr)
+{
+    wattron(this->mWindow, attr);
+}
+
+void CursesSurface::attrOff(int attr)
+{
+    wattroff(this->mWindow, attr);
+}
+
+void CursesSurface::show()
+{
+    // show_panel also moves an already visible panel to the top
+    show_panel(this->mPanel);
+    this->mVisible = true;
+}
+
+void CursesSurface::hide()
+{
+    if (!this->mVisible)
+    {
+        return;
+    }
+    hide_panel(this->mPanel);
+    this->mVisible = false;
+}
+
+bool CursesSurface::isVisible() const
+{
+    return this->mVisible;
+}
+
+CursesRenderer::CursesRenderer()
+{
+    initscr();
+    // If there wasn't any key pressed don't wait for keypress
+    nodelay(stdscr, true);
+    // Turn on keypad control
+    keypad(stdscr, true);
+    // No echo for the key pressed
+    noecho();
+    // No cursor show
+    curs_set(0);
+    if (has_colors())
+    {
+        start_color();
+    }
+    // stdscr is the bottom of the panel stack, flush it once so that
+    // getch() never repaints it over the panels later on
+    refresh();
+}
+
+CursesRenderer::~CursesRenderer()
+{
+    endwin();
+}
+
+Surface* CursesRenderer::createSurface(int height, int width, int startY, int startX)
+{
+    return new CursesSurface(height, width, startY, startX);
+}
+
+void CursesRenderer::getScreenSize(int& height, int& width) const
+{
+    getmaxyx(stdscr, height, width);
+}
+
+bool CursesRenderer::hasColors() const
+{
+    return has_colors();
+}
+
+void CursesRenderer::initColorPair(short pair, short foreground, short background)
+{
+    init_pair(pair, foreground, background);
+}
+
+void CursesRenderer::present()
+{
+    // update_panels only touches the lines uncovered by hidden panels
+    update_panels();
+    // curses writes blocking, so backpressure shows up as time spent here
+    auto start = std::chrono::steady_clock::now();
+    doupdate();
+    auto end = std::chrono::steady_clock::now();
+    this->mStats.stallMicros = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    this->mStats.frames ++;
+}
+
+int CursesRenderer::readKey()
+{
+    return getch();
+}
+
+int CursesRenderer::waitKey()
+{
+    nodelay(stdscr, false);
+    int key = getch();
+    nodelay(stdscr, true);
+    return key;
+}
+
+const RenderStats& CursesRenderer::getStats() const
+{
+    return this->mStats;
+}
@@ -0,0 +1,59 @@
+#ifndef CURSES_RENDERER_H
+#define CURSES_RENDERER_H
+
+#include <ncurses.h>
+#include <panel.h>
+
+#include "renderer.h"
+
+// A curses window kept alive in the panel stack. Showing or hiding it
+// only repaints the cells it covers, so menus never need clear().
+class CursesSurface : public Surface
+{
+public:
+    CursesSurface(int height, int width, int startY, int startX);
+    ~CursesSurface();
+    CursesSurface(const CursesSurface&) = delete;
+    CursesSurface& operator = (const CursesSurface&) = delete;
+
+    void erase() override;
+    void drawBox() override;
+    void putChar(int y, int x, char ch) override;
+    void print(int y, int x, const std::string& text) override;
+    void clearToEol(int y, int x) override;
+    void attrOn(int attr) override;
+    void attrOff(int attr) override;
+
+    void show() override;
+    void hide() override;
+    bool isVisible() const override;
+
+private:
+    WINDOW* mWindow;
+    PANEL* mPanel;
+    bool mVisible;
+};
+
+class CursesRenderer : public Renderer
+{
+public:
+    CursesRenderer();
+    ~CursesRenderer();
+
+    Surface* createSurface(int height, int width, int startY, int startX) override;
+    void getScreenSize(int& height, int& width) const override;
+
+    bool hasColors() const override;
+    void initColorPair(short pair, short foreground, short background) override;
+
+    void present() override;
+    int readKey() override;
+    int waitKey() override;
+
+    const RenderStats& getStats() const override;
+
+private:
+    RenderStats mStats;
+};
+
+#endif
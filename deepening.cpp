@@ -0,0 +1,191 @@
+#include <cstdio>
+
+#include "deepening.h"
+
+namespace
+{
+    const int kMaxDepth = 16;
+    const double kDiscount = 0.95;
+    // Pull towards the food at the horizon, small enough that eating wins.
+    // A line ends at the food, as where the next one shows up is a guess.
+    const double kDistanceWeight = 0.01;
+    // Nodes between looks at the token, which may read the clock
+    const long kPollNodes = 256;
+    // Nearer the horizon a search is cheaper than the table's cache miss
+    const int kTableDepth = 3;
+}
+
+DeepeningPlanner::DeepeningPlanner()
+    : mToken(nullptr), mNodes(0), mStopped(false), mReachedLimit(false), mDepth(0)
+{
+    this->mRng.seed(mixBits(1));
+}
+
+Direction DeepeningPlanner::search(const ClassicState& root, const CancelToken& token, bool& truncated)
+{
+    this->mState.copyFrom(root);
+    this->mToken = &token;
+    this->mNodes = 0;
+    this->mStopped = false;
+    this->mTable.age();
+
+    Direction moves[3];
+    root.getMoves(moves);
+    Direction best = this->chooseQuickMove();
+    int finished = 0;
+    truncated = true;
+    for (int depth = 1; depth <= kMaxDepth; depth ++)
+    {
+        this->mReachedLimit = false;
+        Direction passBest = best;
+        double passValue = -1e300;
+        // Last pass's best first, then the others in their usual order
+        Direction order[3] = {best, best, best};
+        for (int i = 0, n = 1; i < 3; i ++)
+        {
+            if (moves[i] != best)
+            {
+                order[n ++] = moves[i];
+            }
+        }
+        int searched = 0;
+        for (Direction move : order)
+        {
+            ClassicState::Undo undo;
+            double reward = this->mState.step(move, this->mRng, undo);
+            double total = reward;
+            if (reward == 0 && this->mState.isAlive())
+            {
+                total += kDiscount * this->value(depth - 1);
+            }
+            this->mState.undo(undo);
+            if (this->mStopped)
+            {
+                break;
+            }
+            searched ++;
+            if (total > passValue)
+            {
+                passValue = total;
+                passBest = move;
+            }
+        }
+        if (searched > 0)
+        {
+            best = passBest;
+        }
+        if (this->mStopped)
+        {
+            break;
+        }
+        finished = depth;
+        if (!this->mReachedLimit || depth == kMaxDepth)
+        {
+            truncated = false;
+            break;
+        }
+    }
+    this->mDepth = this->mDepth == 0 ? finished : 0.8 * this->mDepth + 0.2 * finished;
+    return best;
+}
+
+double DeepeningPlanner::value(int depth)
+{
+    if (++ this->mNodes % kPollNodes == 0 && this->mToken->isCancelled())
+    {
+        this->mStopped = true;
+    }
+    if (this->mStopped)
+    {
+        return 0;
+    }
+    if (depth == 0)
+    {
+        this->mReachedLimit = true;
+        int distance = this->mState.foodDistance(this->mState.getHead());
+        return distance < 0 ? 0 : -kDistanceWeight * distance;
+    }
+    TranspositionTable::Entry entry;
+    // Only a value searched to the same depth will do. A deeper one has its
+    // food distance penalty discounted further, and would outbid the
+    // fresh values of its siblings.
+    bool useTable = depth >= kTableDepth;
+    if (useTable && this->mTable.probe(this->mState.getHash(), entry) && entry.depth == depth)
+    {
+        // The horizon may be somewhere under it
+        this->mReachedLimit = true;
+        return entry.value;
+    }
+    Direction moves[3];
+    this->mState.getMoves(moves);
+    double best = -1e300;
+    Direction bestMove = moves[0];
+    for (Direction move : moves)
+    {
+        ClassicState::Undo undo;
+        double total = this->mState.step(move, this->mRng, undo);
+        if (total == 0 && this->mState.isAlive())
+        {
+            total += kDiscount * this->value(depth - 1);
+        }
+        this->mState.undo(undo);
+        if (total > best)
+        {
+            best = total;
+            bestMove = move;
+        }
+    }
+    // A cancelled search below leaves the value unfinished
+    if (useTable && !this->mStopped)
+    {
+        this->mTable.store(this->mState.getHash(), depth, best, bestMove);
+    }
+    return best;
+}
+
+Direction DeepeningPlanner::chooseQuickMove() const
+{
+    Direction moves[3];
+    this->mState.getMoves(moves);
+    Direction best = moves[0];
+    int bestDistance = -1;
+    bool found = false;
+    for (Direction move : moves)
+    {
+        int cell = this->mState.nextCell(move);
+        if (!this->mState.isFree(cell))
+        {
+            continue;
+        }
+        int distance = this->mState.foodDistance(cell);
+        if (!found || (distance >= 0 && distance < bestDistance))
+        {
+            found = true;
+            bestDistance = distance;
+            best = move;
+        }
+    }
+    return best;
+}
+
+const char* DeepeningPlanner::getName() const
+{
+    return "Deep";
+}
+
+std::string DeepeningPlanner::describe() const
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "depth %.1f", this->mDepth);
+    return text;
+}
+
+double DeepeningPlanner::getDepth() const
+{
+    return this->mDepth;
+}
+
+const TranspositionTable& DeepeningPlanner::getTable() const
+{
+    return this->mTable;
+}
@@ -0,0 +1,53 @@
+#ifndef DEEPENING_H
+#define DEEPENING_H
+
+#include <string>
+
+#include "anytime.h"
+#include "classic_state.h"
+#include "rng.h"
+#include "transposition.h"
+
+// Iterative deepening autopilot for the classic game. Looks at every line
+// of moves one step deeper than the last pass, taking moves back with
+// ClassicState::undo so a pass allocates nothing. When the token cancels
+// a pass halfway, the root moves it had already finished still count, and
+// last pass's best move goes first so it is always one of them.
+//
+// Results go into a transposition table. A later pass, or the next
+// tick's search one move further along, takes a state's value from
+// there instead of searching below it again.
+class DeepeningPlanner : public AnytimePlanner
+{
+public:
+    DeepeningPlanner();
+
+    const char* getName() const;
+    std::string describe() const;
+    // Average depth the last passes finished
+    double getDepth() const;
+    const TranspositionTable& getTable() const;
+
+protected:
+    Direction search(const ClassicState& root, const CancelToken& token, bool& truncated);
+
+private:
+    // Best discounted reward from mState within depth moves. Sets
+    // mStopped and returns nothing useful once the token is cancelled.
+    double value(int depth);
+    // Free move nearest the food, for when not even one pass finished
+    Direction chooseQuickMove() const;
+
+    ClassicState mState;
+    Rng mRng;
+    TranspositionTable mTable;
+    const CancelToken* mToken;
+    long mNodes;
+    bool mStopped;
+    // Whether the last pass ran into its depth limit anywhere, if not
+    // every line ends in a crash and deeper passes see nothing new
+    bool mReachedLimit;
+    double mDepth;
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+
+#include "distance_table.h"
+
+const size_t DistanceTable::kMaxExactBytes;
+const int DistanceTable::kLandmarks;
+const uint16_t DistanceTable::kUnreachable;
+
+DistanceTable::DistanceTable()
+    : mWidth(0), mHeight(0), mFree(0), mLandmarks(0)
+{
+}
+
+void DistanceTable::build(int boardWidth, int boardHeight, const std::vector<Obstacle>& obstacles, int threads)
+{
+    this->mWidth = boardWidth;
+    this->mHeight = boardHeight;
+    this->mIndex.assign(static_cast<size_t>(boardWidth) * boardHeight, 0);
+    for (int x = 0; x < boardWidth; x ++)
+    {
+        this->mIndex[x] = -1;
+        this->mIndex[(boardHeight - 1) * boardWidth + x] = -1;
+    }
+    for (int y = 0; y < boardHeight; y ++)
+    {
+        this->mIndex[y * boardWidth] = -1;
+        this->mIndex[y * boardWidth + boardWidth - 1] = -1;
+    }
+    for (const Obstacle& obs : obstacles)
+    {
+        if (obs.x >= 0 && obs.x < boardWidth && obs.y >= 0 && obs.y < boardHeight)
+        {
+            this->mIndex[obs.y * boardWidth + obs.x] = -1;
+        }
+    }
+    this->mCells.clear();
+    for (int cell = 0; cell < this->mIndex.size(); cell ++)
+    {
+        if (this->mIndex[cell] == 0)
+        {
+            this->mIndex[cell] = this->mCells.size();
+            this->mCells.push_back(cell);
+        }
+    }
+    this->mFree = this->mCells.size();
+    size_t n = this->mFree;
+
+    if (n * n * sizeof(uint16_t) <= kMaxExactBytes)
+    {
+        this->mLandmarks = 0;
+        this->mTable.assign(n * n, kUnreachable);
+        if (threads <= 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        // Sources are handed out one at a time, searches in open areas
+        // take longer than ones in corners
+        std::atomic<int> next(0);
+        auto work = [this, &next]() {
+            std::vector<int> queue;
+            for (int source = next ++; source < this->mFree; source = next ++)
+            {
+                this->search(source, &this->mTable[static_cast<size_t>(source) * this->mFree], queue);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (int i = 1; i < threads; i ++)
+        {
+            workers.emplace_back(work);
+        }
+        work();
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+        return;
+    }
+
+    // Each landmark is the cell farthest from the ones before it, a cell
+    // none of them reaches counting as farthest of all
+    this->mLandmarks = std::min<int>(kLandmarks, n);
+    this->mTable.assign(static_cast<size_t>(this->mLandmarks) * n, kUnreachable);
+    std::vector<int> nearest(n, kUnreachable);
+    std::vector<int> queue;
+    int source = 0;
+    for (int l = 0; l < this->mLandmarks; l ++)
+    {
+        uint16_t* row = &this->mTable[static_cast<size_t>(l) * n];
+        this->search(source, row, queue);
+        int farthest = 0;
+        for (int i = 0; i < n; i ++)
+        {
+            nearest[i] = std::min<int>(nearest[i], row[i]);
+            if (nearest[i] > nearest[farthest])
+            {
+                farthest = i;
+            }
+        }
+        source = farthest;
+    }
+}
+
+void DistanceTable::search(int source, uint16_t* out, std::vector<int>& queue) const
+{
+    std::fill(out, out + this->mFree, kUnreachable);
+    queue.clear();
+    queue.push_back(source);
+    out[source] = 0;
+    for (int head = 0; head < queue.size(); head ++)
+    {
+        int cell = this->mCells[queue[head]];
+        int x = cell % this->mWidth;
+        int y = cell / this->mWidth;
+        // Inside the border the board wraps
+        int neighbours[4] = {
+            y * this->mWidth + (x == 1 ? this->mWidth - 2 : x - 1),
+            y * this->mWidth + (x == this->mWidth - 2 ? 1 : x + 1),
+            (y == 1 ? this->mHeight - 2 : y - 1) * this->mWidth + x,
+            (y == this->mHeight - 2 ? 1 : y + 1) * this->mWidth + x,
+        };
+        uint16_t distance = out[queue[head]] + 1;
+        for (int neighbour : neighbours)
+        {
+            int index = this->mIndex[neighbour];
+            if (index >= 0 && out[index] == kUnreachable)
+            {
+                out[index] = distance;
+                queue.push_back(index);
+            }
+        }
+    }
+}
+
+int DistanceTable::estimate(int a, int b) const
+{
+    int best = 0;
+    for (int l = 0; l < this->mLandmarks; l ++)
+    {
+        const uint16_t* row = &this->mTable[static_cast<size_t>(l) * this->mFree];
+        bool reachA = row[a] != kUnreachable;
+        bool reachB = row[b] != kUnreachable;
+        if (reachA != reachB)
+        {
+            // One side of a wall the other side cannot get past
+            return -1;
+        }
+        if (reachA)
+        {
+            best = std::max(best, std::abs(row[a] - row[b]));
+        }
+    }
+    return best;
+}
+
+int DistanceTable::distance(int fromX, int fromY, int toX, int toY) const
+{
+    return this->distance(fromY * this->mWidth + fromX, toY * this->mWidth + toX);
+}
+
+bool DistanceTable::isExact() const
+{
+    return this->mLandmarks == 0;
+}
+
+int DistanceTable::getWidth() const
+{
+    return this->mWidth;
+}
+
+int DistanceTable::getHeight() const
+{
+    return this->mHeight;
+}
+
+int DistanceTable::getFreeCells() const
+{
+    return this->mFree;
+}
+
+size_t DistanceTable::getBytes() const
+{
+    return this->mTable.size() * sizeof(uint16_t) + this->mIndex.size() * sizeof(int)
+           + this->mCells.size() * sizeof(int);
+}
@@ -0,0 +1,75 @@
+#ifndef DISTANCE_TABLE_H
+#define DISTANCE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "map.h"
+
+// Moves from any free cell to any other around a map's obstacles, worked
+// out once because the obstacles never move during a game. Bodies and
+// food are not obstacles here, so this is the distance on an empty board.
+// The playable area wraps like in Snake::createNewHead.
+//
+// Small boards keep every pair, one uint16 each, filled by one BFS per
+// cell spread over all cores. Where that would pass kMaxExactBytes only
+// the distances to a few landmarks are kept, spread out by picking each
+// one as far as possible from the others. A distance is then the best
+// lower bound the landmarks give: d(a, b) >= |d(L, a) - d(L, b)|.
+class DistanceTable
+{
+public:
+    static const size_t kMaxExactBytes = 32 << 20;
+    static const int kLandmarks = 16;
+
+    DistanceTable();
+
+    // 0 threads means one per core
+    void build(int boardWidth, int boardHeight, const std::vector<Obstacle>& obstacles, int threads = 0);
+
+    // Cells are y * boardWidth + x. -1 when either is blocked or there is
+    // no way between them.
+    int distance(int from, int to) const
+    {
+        int a = this->mIndex[from];
+        int b = this->mIndex[to];
+        if (a < 0 || b < 0)
+        {
+            return -1;
+        }
+        if (this->mLandmarks == 0)
+        {
+            uint16_t d = this->mTable[static_cast<size_t>(a) * this->mFree + b];
+            return d == kUnreachable ? -1 : d;
+        }
+        return this->estimate(a, b);
+    }
+    int distance(int fromX, int fromY, int toX, int toY) const;
+
+    bool isExact() const;
+    int getWidth() const;
+    int getHeight() const;
+    // Free cells, and what the table takes for them
+    int getFreeCells() const;
+    size_t getBytes() const;
+
+private:
+    static const uint16_t kUnreachable = 0xffff;
+
+    // Distances from the free cell source to every free cell, by index
+    void search(int source, uint16_t* out, std::vector<int>& queue) const;
+    int estimate(int a, int b) const;
+
+    int mWidth;
+    int mHeight;
+    // Board cell to free cell index, -1 for borders and obstacles
+    std::vector<int> mIndex;
+    std::vector<int> mCells;
+    int mFree;
+    // Exact: row per free cell. Landmarks: row per landmark.
+    std::vector<uint16_t> mTable;
+    int mLandmarks;
+};
+
+#endif
@@ -0,0 +1,111 @@
+// Throughput benchmark for VecEnv: steps --envs games with random
+// actions on --threads threads and reports environment steps per second
+// as JSON, together with how the episodes went. --window R also cuts
+// out the packed (2R + 1) square around every head after each step.
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "vec_env.h"
+
+namespace
+{
+    struct Options
+    {
+        int envs = 256;
+        int steps = 2000;
+        // Chance in percent that an agent turns on a given step
+        int turnPercent = 20;
+        int window = 0;
+        VecEnvConfig config;
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; i ++)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--envs" && hasValue) options.envs = std::atoi(argv[++ i]);
+            else if (arg == "--steps" && hasValue) options.steps = std::atoi(argv[++ i]);
+            else if (arg == "--turn" && hasValue) options.turnPercent = std::atoi(argv[++ i]);
+            else if (arg == "--window" && hasValue) options.window = std::atoi(argv[++ i]);
+            else if (arg == "--threads" && hasValue) options.config.threads = std::atoi(argv[++ i]);
+            else if (arg == "--width" && hasValue) options.config.width = std::atoi(argv[++ i]);
+            else if (arg == "--height" && hasValue) options.config.height = std::atoi(argv[++ i]);
+            else if (arg == "--map" && hasValue) options.config.map = std::atoi(argv[++ i]);
+            else if (arg == "--max-steps" && hasValue) options.config.maxSteps = std::atoi(argv[++ i]);
+            else if (arg == "--seed" && hasValue) options.config.seed = std::atoll(argv[++ i]);
+            else
+            {
+                std::cerr << "usage: " << argv[0]
+                          << " [--envs B] [--steps N] [--turn PERCENT] [--window R] [--threads T] [--width W] [--height H] [--map I] [--max-steps N] [--seed S]" << std::endl;
+                std::exit(1);
+            }
+        }
+        if (options.window < 0 || options.window > BitPlanes::kMaxRadius)
+        {
+            std::cerr << "--window takes 0 to " << BitPlanes::kMaxRadius << std::endl;
+            std::exit(1);
+        }
+        return options;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options = parseOptions(argc, argv);
+    VecEnv env(options.envs, options.config);
+    int count = env.getCount();
+    std::vector<uint8_t> observations(env.getObservationSize() * count);
+    std::vector<int> actions(count);
+    std::vector<float> rewards(count);
+    std::vector<uint8_t> dones(count);
+    std::vector<uint64_t> windows(static_cast<size_t>(count) * VecEnv::PLANES * (2 * options.window + 1));
+    env.resetAll(observations.data());
+
+    Rng rng(options.config.seed);
+    long episodes = 0;
+    long foods = 0;
+    long deaths = 0;
+    double stepSeconds = 0;
+    double windowSeconds = 0;
+    for (int step = 0; step < options.steps; step ++)
+    {
+        // Choosing actions is the agent's time, not the environment's
+        for (int i = 0; i < count; i ++)
+        {
+            actions[i] = rng.nextInt(100) < options.turnPercent ? rng.nextInt(4) : -1;
+        }
+        auto start = std::chrono::steady_clock::now();
+        env.stepAll(actions.data(), rewards.data(), dones.data());
+        auto stepped = std::chrono::steady_clock::now();
+        stepSeconds += std::chrono::duration<double>(stepped - start).count();
+        if (options.window > 0)
+        {
+            env.writeWindows(options.window, windows.data());
+            windowSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - stepped).count();
+        }
+        for (int i = 0; i < count; i ++)
+        {
+            foods += rewards[i] > 0;
+            deaths += rewards[i] < 0;
+            episodes += dones[i];
+        }
+    }
+
+    long total = static_cast<long>(count) * options.steps;
+    std::cout << "{\"envs\":" << count
+              << ",\"threads\":" << options.config.threads
+              << ",\"board\":[" << env.getWidth() << "," << env.getHeight() << "]"
+              << ",\"steps\":" << total
+              << ",\"stepsPerSecond\":" << static_cast<long>(total / stepSeconds)
+              << ",\"windowNanos\":" << (options.window > 0 ? static_cast<long>(windowSeconds * 1e9 / total) : 0)
+              << ",\"episodes\":" << episodes
+              << ",\"foods\":" << foods
+              << ",\"deaths\":" << deaths << "}" << std::endl;
+    return 0;
+}
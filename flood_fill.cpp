@@ -0,0 +1,263 @@
+#include <algorithm>
+
+#include "flood_fill.h"
+
+namespace
+{
+    // Kogge-Stone occluded fill: spreads the set bits of gen through the
+    // runs of free bits they sit in, towards the high end of the word
+    uint64_t spreadUp(uint64_t gen, uint64_t free)
+    {
+        gen |= free & (gen << 1);
+        free &= free << 1;
+        gen |= free & (gen << 2);
+        free &= free << 2;
+        gen |= free & (gen << 4);
+        free &= free << 4;
+        gen |= free & (gen << 8);
+        free &= free << 8;
+        gen |= free & (gen << 16);
+        free &= free << 16;
+        return gen | (free & (gen << 32));
+    }
+
+    // The same towards the low end
+    uint64_t spreadDown(uint64_t gen, uint64_t free)
+    {
+        gen |= free & (gen >> 1);
+        free &= free >> 1;
+        gen |= free & (gen >> 2);
+        free &= free >> 2;
+        gen |= free & (gen >> 4);
+        free &= free >> 4;
+        gen |= free & (gen >> 8);
+        free &= free >> 8;
+        gen |= free & (gen >> 16);
+        free &= free >> 16;
+        return gen | (free & (gen >> 32));
+    }
+}
+
+FloodFill::FloodFill()
+    : mWidth(0), mHeight(0), mWordsPerRow(0), mWrapX(true), mWrapY(true), mReachedTarget(false)
+{
+}
+
+void FloodFill::reset(int width, int height, bool wrapX, bool wrapY)
+{
+    this->mWidth = width;
+    this->mHeight = height;
+    this->mWrapX = wrapX;
+    this->mWrapY = wrapY;
+    this->mWordsPerRow = (width + 63) / 64;
+    this->mFree.assign(static_cast<size_t>(height) * this->mWordsPerRow, ~uint64_t(0));
+    this->mReached.assign(this->mFree.size(), 0);
+    this->mGrew.assign(height, 0);
+    this->mGrowing.assign(height, 0);
+    this->mTouched.clear();
+    // Nothing past the right edge is ever free
+    if (width % 64 != 0)
+    {
+        uint64_t last = (uint64_t(1) << (width % 64)) - 1;
+        for (int y = 0; y < height; y ++)
+        {
+            this->mFree[(y + 1) * this->mWordsPerRow - 1] = last;
+        }
+    }
+}
+
+void FloodFill::block(int x, int y)
+{
+    this->mFree[y * this->mWordsPerRow + (x >> 6)] &= ~(uint64_t(1) << (x & 63));
+}
+
+void FloodFill::unblock(int x, int y)
+{
+    this->mFree[y * this->mWordsPerRow + (x >> 6)] |= uint64_t(1) << (x & 63);
+}
+
+void FloodFill::blockBits(int x, int y, uint64_t bits, int count)
+{
+    if (count < 64)
+    {
+        bits &= (uint64_t(1) << count) - 1;
+    }
+    uint64_t* row = &this->mFree[y * this->mWordsPerRow];
+    int shift = x & 63;
+    row[x >> 6] &= ~(bits << shift);
+    if (shift != 0 && shift + count > 64)
+    {
+        row[(x >> 6) + 1] &= ~(bits >> (64 - shift));
+    }
+}
+
+bool FloodFill::isBlocked(int x, int y) const
+{
+    return (this->mFree[y * this->mWordsPerRow + (x >> 6)] & (uint64_t(1) << (x & 63))) == 0;
+}
+
+int FloodFill::fill(int x, int y, int enough, int targetX, int targetY)
+{
+    for (int row : this->mTouched)
+    {
+        std::fill_n(&this->mReached[row * this->mWordsPerRow], this->mWordsPerRow, 0);
+        this->mGrew[row] = 0;
+    }
+    this->mTouched.clear();
+    this->mReachedTarget = false;
+    if (this->isBlocked(x, y))
+    {
+        return 0;
+    }
+    this->mReached[y * this->mWordsPerRow + (x >> 6)] |= uint64_t(1) << (x & 63);
+    this->mTouched.push_back(y);
+    int area = 1 + this->spreadRow(y);
+    this->mGrew[y] = 1;
+
+    const uint64_t* target = nullptr;
+    uint64_t targetBit = 0;
+    if (targetX >= 0 && targetY >= 0)
+    {
+        target = &this->mReached[targetY * this->mWordsPerRow + (targetX >> 6)];
+        targetBit = uint64_t(1) << (targetX & 63);
+    }
+    // Sweeping down carries the fill down the whole board in one pass,
+    // sweeping up carries it up, so the two take turns
+    for (bool down = true; ; down = !down)
+    {
+        if (target != nullptr && (*target & targetBit) != 0)
+        {
+            this->mReachedTarget = true;
+            break;
+        }
+        if (area >= enough)
+        {
+            break;
+        }
+        int added = this->grow(down);
+        if (added == 0)
+        {
+            break;
+        }
+        area += added;
+    }
+    return area;
+}
+
+int FloodFill::grow(bool down)
+{
+    int added = 0;
+    int height = this->mHeight;
+    std::fill(this->mGrowing.begin(), this->mGrowing.end(), 0);
+    for (int i = 0; i < height; i ++)
+    {
+        int y = down ? i : height - 1 - i;
+        // Past an edge that does not wrap there is nothing to grow from
+        int above = y > 0 ? y - 1 : this->mWrapY ? height - 1 : -1;
+        int below = y < height - 1 ? y + 1 : this->mWrapY ? 0 : -1;
+        bool fromAbove = above >= 0 && (this->mGrew[above] | this->mGrowing[above]);
+        bool fromBelow = below >= 0 && (this->mGrew[below] | this->mGrowing[below]);
+        if (!fromAbove && !fromBelow)
+        {
+            continue;
+        }
+        uint64_t* row = &this->mReached[y * this->mWordsPerRow];
+        const uint64_t* free = &this->mFree[y * this->mWordsPerRow];
+        const uint64_t* up = above >= 0 ? &this->mReached[above * this->mWordsPerRow] : nullptr;
+        const uint64_t* low = below >= 0 ? &this->mReached[below * this->mWordsPerRow] : nullptr;
+        bool seeded = false;
+        bool reached = false;
+        for (int w = 0; w < this->mWordsPerRow; w ++)
+        {
+            reached |= row[w] != 0;
+            uint64_t seeds = ((up != nullptr ? up[w] : 0) | (low != nullptr ? low[w] : 0)) & free[w] & ~row[w];
+            if (seeds != 0)
+            {
+                row[w] |= seeds;
+                added += __builtin_popcountll(seeds);
+                seeded = true;
+            }
+        }
+        if (seeded)
+        {
+            added += this->spreadRow(y);
+            this->mGrowing[y] = 1;
+            if (!reached)
+            {
+                this->mTouched.push_back(y);
+            }
+        }
+    }
+    this->mGrew.swap(this->mGrowing);
+    return added;
+}
+
+int FloodFill::spreadRow(int y)
+{
+    uint64_t* row = &this->mReached[y * this->mWordsPerRow];
+    const uint64_t* free = &this->mFree[y * this->mWordsPerRow];
+    int words = this->mWordsPerRow;
+    int before = 0;
+    for (int w = 0; w < words; w ++)
+    {
+        before += __builtin_popcountll(row[w]);
+    }
+    int lastWord = (this->mWidth - 1) >> 6;
+    uint64_t lastBit = uint64_t(1) << ((this->mWidth - 1) & 63);
+    while (true)
+    {
+        // Runs may go on into the next word, the carry starts them there
+        uint64_t carry = 0;
+        for (int w = 0; w < words; w ++)
+        {
+            row[w] = spreadUp(row[w] | (carry & free[w]), free[w]);
+            carry = row[w] >> 63;
+        }
+        carry = 0;
+        for (int w = words - 1; w >= 0; w --)
+        {
+            row[w] = spreadDown(row[w] | ((carry << 63) & free[w]), free[w]);
+            carry = row[w] & 1;
+        }
+        // The row wraps, a run touching one end goes on at the other
+        if (!this->mWrapX)
+        {
+            break;
+        }
+        bool left = (row[0] & 1) != 0;
+        bool right = (row[lastWord] & lastBit) != 0;
+        if (left && !right && (free[lastWord] & lastBit) != 0)
+        {
+            row[lastWord] |= lastBit;
+        }
+        else if (right && !left && (free[0] & 1) != 0)
+        {
+            row[0] |= 1;
+        }
+        else
+        {
+            break;
+        }
+    }
+    int after = 0;
+    for (int w = 0; w < words; w ++)
+    {
+        after += __builtin_popcountll(row[w]);
+    }
+    return after - before;
+}
+
+bool FloodFill::reachedTarget() const
+{
+    return this->mReachedTarget;
+}
+
+int FloodFill::getWidth() const
+{
+    return this->mWidth;
+}
+
+int FloodFill::getHeight() const
+{
+    return this->mHeight;
+}
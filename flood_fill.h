@@ -0,0 +1,67 @@
+#ifndef FLOOD_FILL_H
+#define FLOOD_FILL_H
+
+#include <cstdint>
+#include <vector>
+
+// How much room a head has left: floods the free cells connected to a
+// start cell on a board that wraps on all sides, or on a window cut out
+// of one, which only wraps where it spans the whole board. Cells are
+// bits, 64 to a word. Within a row the fill runs along whole stretches
+// of free cells with a few shifts per word. Passes over the rows then
+// carry it to the rows above and below, and only rows next to ones that
+// grew since they were last looked at are looked at again.
+//
+// A fill stops as soon as it has reached enough cells, or the target
+// cell, so asking "is there room for my body or a way to my tail" costs
+// little when the answer is yes. Only the rows the last fill reached are
+// cleared before the next one.
+class FloodFill
+{
+public:
+    FloodFill();
+
+    // width x height cells, all free. Without wrapX the left and right
+    // edges are walls, without wrapY the top and bottom ones.
+    void reset(int width, int height, bool wrapX = true, bool wrapY = true);
+    void block(int x, int y);
+    // Blocks cells x to x + count - 1 of row y where bits has a 1,
+    // count at most 64
+    void blockBits(int x, int y, uint64_t bits, int count);
+    void unblock(int x, int y);
+    bool isBlocked(int x, int y) const;
+
+    // Number of cells reachable from (x, y), counting it, or the first
+    // count at or past enough. Pass a negative target for none.
+    int fill(int x, int y, int enough, int targetX = -1, int targetY = -1);
+    // Whether the last fill got to its target
+    bool reachedTarget() const;
+
+    int getWidth() const;
+    int getHeight() const;
+
+private:
+    // One pass over the rows next to ones that grew, top to bottom or
+    // bottom to top. Returns the cells added.
+    int grow(bool down);
+    // Floods row y along its runs of free cells from the cells already
+    // reached in it. Returns the cells added.
+    int spreadRow(int y);
+
+    int mWidth;
+    int mHeight;
+    int mWordsPerRow;
+    bool mWrapX;
+    bool mWrapY;
+    // Set bits are free cells, bits past the width are never set
+    std::vector<uint64_t> mFree;
+    std::vector<uint64_t> mReached;
+    // Rows that grew in the last pass, and in this one
+    std::vector<uint8_t> mGrew;
+    std::vector<uint8_t> mGrowing;
+    // Rows the last fill reached
+    std::vector<int> mTouched;
+    bool mReachedTarget;
+};
+
+#endif
@@ -1,6 +1,8 @@
 #include <string>
 #include <iostream>
 #include <cmath> 
+#include <ctime>
+#include <cstdio>
 
 // For terminal delay
 #include <chrono>
@@ -12,28 +14,28 @@
 
 #include "game.h"
 #include "map.h"
+#include "curses_renderer.h"
+#include "bot.h"
+#include "trace.h"
 
-Game::Game() : mIsPaused(false)
+Game::Game() : Game(std::unique_ptr<Renderer>(new CursesRenderer()))
+{
+}
+
+Game::Game(std::unique_ptr<Renderer> renderer) : mIsPaused(false), mRenderer(std::move(renderer))
 {
     // Separate the screen to three windows
     this->mWindows.resize(3);
-    initscr();
-    // If there wasn't any key pressed don't wait for keypress
-    nodelay(stdscr, true);
-    // Turn on keypad control
-    keypad(stdscr, true);
-    // No echo for the key pressed
-    noecho();
-    // No cursor show
-    curs_set(0);
     // Get screen and board parameters
-    getmaxyx(stdscr, this->mScreenHeight, this->mScreenWidth);
+    this->mRenderer->getScreenSize(this->mScreenHeight, this->mScreenWidth);
     this->mGameBoardWidth = this->mScreenWidth - this->mInstructionWidth;
     this->mGameBoardHeight = this->mScreenHeight - this->mInformationHeight;
 
     this->createInformationBoard();
     this->createGameBoard();
     this->createInstructionBoard();
+    this->createMenus();
+    this->hideBoards();
 
     // Initialize the leader board to be all zeros
     this->mLeaderBoard.assign(this->mNumLeaders, 0);
@@ -42,25 +44,62 @@ Game::Game() : mIsPaused(false)
     mOptionValues.push_back(&mInitialSnakeLength);  // Initial Length
     mOptionValues.push_back(&mSelectedDelay);           // Speed
     mOptionValues.push_back(&mColorTheme);          // Color Theme
-    mEditableOptionsCount = 3;                      // 可编辑的选项数量
+    mOptionValues.push_back(&mPartySnakes);         // Party Snakes
+    mOptionValues.push_back(&mPartyPlayers);        // Party Players
+    mOptionValues.push_back(&mArenaSize);           // Arena Size
+    mOptionValues.push_back(&mArenaBots);           // Arena Bots
+    mEditableOptionsCount = 7;                      // 可编辑的选项数量
 
     //maps
-    this->mAvailableMaps = GameMap::getDefaultMaps(mGameBoardWidth, mGameBoardHeight);  // 获取默认地图列表
+    this->setSeed(std::time(nullptr));                 // 获取默认地图列表
     this->mSelectedMapIndex = 0;                       // 默认选择第一个地图
     this->mCurrentMap = mAvailableMaps[mSelectedMapIndex]; // 设置当前地图
 
 }
 
 Game::~Game()
+{
+    // Surfaces are released before mRenderer by member order
+}
+
+void Game::createMenus()
+{
+    // Main menu and map menu are centered on the screen
+    this->mMainMenu.reset(this->mRenderer->createSurface(10, 30, (mScreenHeight - 10) / 2, (mScreenWidth - 30) / 2));
+    this->mMapMenu.reset(this->mRenderer->createSurface(8, 30, (mScreenHeight - 8) / 2, (mScreenWidth - 30) / 2));
+    this->mOptionsMenu.reset(this->mRenderer->createSurface(12, 60, (mScreenHeight - 12) / 2, (mScreenWidth - 60) / 2));
+
+    // Pause and restart menus cover the middle of the game board
+    int width = this->mGameBoardWidth * 0.5;
+    int height = this->mGameBoardHeight * 0.5;
+    int startX = this->mGameBoardWidth * 0.25;
+    int startY = this->mGameBoardHeight * 0.25 + this->mInformationHeight;
+    this->mPauseMenu.reset(this->mRenderer->createSurface(height, width, startY, startX));
+    this->mRestartMenu.reset(this->mRenderer->createSurface(height, width, startY, startX));
+}
+
+void Game::showBoards() const
+{
+    for (int i = 0; i < this->mWindows.size(); i ++)
+    {
+        this->mWindows[i]->show();
+    }
+}
+
+void Game::hideBoards() const
 {
     for (int i = 0; i < this->mWindows.size(); i ++)
     {
-        delwin(this->mWindows[i]);
+        this->mWindows[i]->hide();
     }
-    endwin();
 }
 
 // 切换暂停状态
+bool Game::startTelemetry(const std::string& path)
+{
+    return this->mTelemetry.start(path);
+}
+
 void Game::togglePause() {
     mIsPaused = !mIsPaused;
 }
@@ -74,54 +113,67 @@ void Game::createInformationBoard()
 {
     int startY = 0;
     int startX = 0;
-    this->mWindows[0] = newwin(this->mInformationHeight, this->mScreenWidth, startY, startX);
+    this->mWindows[0].reset(this->mRenderer->createSurface(this->mInformationHeight, this->mScreenWidth, startY, startX));
 }
 
 void Game::renderInformationBoard() const
 {
-    mvwprintw(this->mWindows[0], 1, 1, "Welcome to The Snake Game!");
-    mvwprintw(this->mWindows[0], 2, 1, "This is a mock version.");
-    mvwprintw(this->mWindows[0], 3, 1, "Please fill in the blanks to make it work properly!!");
-    mvwprintw(this->mWindows[0], 4, 1, "Implemented using C++ and libncurses library.");
-    wrefresh(this->mWindows[0]);
+    this->mWindows[0]->print(1, 1, "Welcome to The Snake Game!");
+    this->mWindows[0]->print(2, 1, "This is a mock version.");
+    this->mWindows[0]->print(3, 1, "Please fill in the blanks to make it work properly!!");
+    this->mWindows[0]->print(4, 1, "Implemented using C++ and libncurses library.");
 }
 
 void Game::createGameBoard()
 {
     int startY = this->mInformationHeight;
     int startX = 0;
-    this->mWindows[1] = newwin(this->mScreenHeight - this->mInformationHeight, this->mScreenWidth - this->mInstructionWidth, startY, startX);
+    this->mWindows[1].reset(this->mRenderer->createSurface(this->mScreenHeight - this->mInformationHeight, this->mScreenWidth - this->mInstructionWidth, startY, startX));
 }
 
 void Game::renderGameBoard() const
 {
-    //wrefresh(this->mWindows[1]);
+    if (this->partyWorld()) {
+        // Obstacles are on the party board itself
+        renderParty();
+        return;
+    }
     renderMap();
-    wrefresh(this->mWindows[1]);
+    renderFood();
+    renderSnake();
 }
 
 void Game::createInstructionBoard()
 {
     int startY = this->mInformationHeight;
     int startX = this->mScreenWidth - this->mInstructionWidth;
-    this->mWindows[2] = newwin(this->mScreenHeight - this->mInformationHeight, this->mInstructionWidth, startY, startX);
+    this->mWindows[2].reset(this->mRenderer->createSurface(this->mScreenHeight - this->mInformationHeight, this->mInstructionWidth, startY, startX));
 }
 
 void Game::renderInstructionBoard() const
 {
-    mvwprintw(this->mWindows[2], 1, 1, "Manual");
-
-    mvwprintw(this->mWindows[2], 2, 1, "Up: W");
-    mvwprintw(this->mWindows[2], 3, 1, "Down: S");
-    mvwprintw(this->mWindows[2], 4, 1, "Left: A");
-    mvwprintw(this->mWindows[2], 5, 1, "Right: D");
-    mvwprintw(this->mWindows[2], 6, 1, "Pause: P");
-    mvwprintw(this->mWindows[2], 7, 1, "Speed-Up: J");
-
-    mvwprintw(this->mWindows[2], 9, 1, "Difficulty");
-    mvwprintw(this->mWindows[2], 12, 1, "Points");
+    this->mWindows[2]->print(1, 1, "Manual");
+
+    this->mWindows[2]->print(2, 1, "Up: W");
+    this->mWindows[2]->print(3, 1, "Down: S");
+    this->mWindows[2]->print(4, 1, "Left: A");
+    this->mWindows[2]->print(5, 1, "Right: D");
+    this->mWindows[2]->print(6, 1, "Pause: P");
+    this->mWindows[2]->print(7, 1, "Speed-Up: J");
+    if (!this->partyWorld()) {
+        this->mWindows[2]->print(8, 1, "Profile: F");
+        this->renderAutopilot();
+    }
 
-    wrefresh(this->mWindows[2]);
+    this->mWindows[2]->print(9, 1, "Difficulty");
+    this->renderDifficulty();
+    if (this->partyWorld()) {
+        std::string aliveString = "Alive: " + std::to_string(this->partyWorld()->getAliveCount());
+        this->mWindows[2]->print(11, 1, aliveString);
+    }
+    this->mWindows[2]->print(12, 1, "Points");
+    this->renderPoints();
+    this->renderDroppedFrames();
 }
 
 
@@ -132,82 +184,79 @@ void Game::renderLeaderBoard() const
     {
         return;
     }
-    mvwprintw(this->mWindows[2], 15, 1, "Leader Board");
+    this->mWindows[2]->print(15, 1, "Leader Board");
     std::string pointString;
     std::string rank;
     for (int i = 0; i < std::min(this->mNumLeaders, this->mScreenHeight - this->mInformationHeight - 14 - 2); i ++)
     {
         pointString = std::to_string(this->mLeaderBoard[i]);
         rank = "#" + std::to_string(i + 1) + ":";
-        mvwprintw(this->mWindows[2], 15 + (i + 1), 1, rank.c_str());
-        mvwprintw(this->mWindows[2], 15 + (i + 1), 5, pointString.c_str());
+        this->mWindows[2]->print(15 + (i + 1), 1, rank);
+        this->mWindows[2]->print(15 + (i + 1), 5, pointString);
     }
-    wrefresh(this->mWindows[2]);
 }
 
 bool Game::renderRestartMenu() const
 {
-    WINDOW * menu;
-    int width = this->mGameBoardWidth * 0.5;
-    int height = this->mGameBoardHeight * 0.5;
-    int startX = this->mGameBoardWidth * 0.25;
-    int startY = this->mGameBoardHeight * 0.25 + this->mInformationHeight;
-
-    menu = newwin(height, width, startY, startX);
-    box(menu, 0, 0);
+    TraceScope trace("restartMenu");
+    Surface* menu = this->mRestartMenu.get();
+    menu->erase();
+    menu->drawBox();
     std::vector<std::string> menuItems = {"Restart", "Quit"};
 
     int index = 0;
     int offset = 4;
-    mvwprintw(menu, 1, 1, "Your Final Score:");
+    menu->print(1, 1, "Your Final Score:");
     std::string pointString = std::to_string(this->mPoints);
-    mvwprintw(menu, 2, 1, pointString.c_str());
-    wattron(menu, A_STANDOUT);
-    mvwprintw(menu, 0 + offset, 1, menuItems[0].c_str());
-    wattroff(menu, A_STANDOUT);
-    mvwprintw(menu, 1 + offset, 1, menuItems[1].c_str());
+    menu->print(2, 1, pointString);
+    menu->attrOn(A_STANDOUT);
+    menu->print(0 + offset, 1, menuItems[0]);
+    menu->attrOff(A_STANDOUT);
+    menu->print(1 + offset, 1, menuItems[1]);
 
-    wrefresh(menu);
+    this->mRestartMenu->show();
+    this->mRenderer->present();
 
     int key;
     while (true)
     {
-        key = getch();
+        key = this->mRenderer->readKey();
         switch(key)
         {
             case 'W':
             case 'w':
             case KEY_UP:
             {
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
+                menu->print(index + offset, 1, menuItems[index]);
                 index --;
                 index = (index < 0) ? menuItems.size() - 1 : index;
-                wattron(menu, A_STANDOUT);
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
-                wattroff(menu, A_STANDOUT);
+                menu->attrOn(A_STANDOUT);
+                menu->print(index + offset, 1, menuItems[index]);
+                menu->attrOff(A_STANDOUT);
                 break;
             }
             case 'S':
             case 's':
             case KEY_DOWN:
             {
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
+                menu->print(index + offset, 1, menuItems[index]);
                 index ++;
                 index = (index > menuItems.size() - 1) ? 0 : index;
-                wattron(menu, A_STANDOUT);
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
-                wattroff(menu, A_STANDOUT);
+                menu->attrOn(A_STANDOUT);
+                menu->print(index + offset, 1, menuItems[index]);
+                menu->attrOff(A_STANDOUT);
                 break;
             }
         }
-        wrefresh(menu);
+        this->mRenderer->present();
         if (key == ' ' || key == 10)
         {
             break;
         }
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
-    delwin(menu);
+    this->mRestartMenu->hide();
+    this->mRenderer->present();
 
     if (index == 0)
     {
@@ -222,48 +271,45 @@ bool Game::renderRestartMenu() const
 
 int Game::renderPauseMenu() const
 {
-    WINDOW* menu;
-    int width = this->mGameBoardWidth * 0.5;
-    int height = this->mGameBoardHeight * 0.5;
-    int startX = this->mGameBoardWidth * 0.25;
-    int startY = this->mGameBoardHeight * 0.25 + this->mInformationHeight;
-
-    menu = newwin(height, width, startY, startX);
-    box(menu, 0, 0);
+    TraceScope trace("pauseMenu");
+    Surface* menu = this->mPauseMenu.get();
+    menu->erase();
+    menu->drawBox();
 
     std::vector<std::string> menuItems = {"Continue", "Restart", "Quit"};
 
     int index = 0;
     int offset = 3;
 
-    mvwprintw(menu, 1, 1, "Game Paused");
-    mvwprintw(menu, 2, 1, "Current Score: ");
+    menu->print(1, 1, "Game Paused");
+    menu->print(2, 1, "Current Score: ");
     std::string pointString = std::to_string(this->mPoints);
-    mvwprintw(menu, 2, 16, pointString.c_str());
+    menu->print(2, 16, pointString);
 
-    wattron(menu, A_STANDOUT);
-    mvwprintw(menu, 0+offset, 1, menuItems[0].c_str());
-    wattroff(menu,A_STANDOUT);
-    mvwprintw(menu, 1+offset, 1, menuItems[1].c_str());
-    mvwprintw(menu, 2+offset, 1, menuItems[2].c_str());
+    menu->attrOn(A_STANDOUT);
+    menu->print(0+offset, 1, menuItems[0]);
+    menu->attrOff(A_STANDOUT);
+    menu->print(1+offset, 1, menuItems[1]);
+    menu->print(2+offset, 1, menuItems[2]);
 
-    wrefresh(menu);
+    this->mPauseMenu->show();
+    this->mRenderer->present();
 
     int key;
     while (true)
     {
-        key = getch();
+        key = this->mRenderer->readKey();
         switch(key)
         {
             case 'W':
             case 'w':
             case KEY_UP:
             {
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
+                menu->print(index + offset, 1, menuItems[index]);
                 index = (index - 1 + menuItems.size()) % menuItems.size(); // 循环选择
-                wattron(menu, A_STANDOUT);
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
-                wattroff(menu, A_STANDOUT);
+                menu->attrOn(A_STANDOUT);
+                menu->print(index + offset, 1, menuItems[index]);
+                menu->attrOff(A_STANDOUT);
                 break;
             }
 
@@ -271,22 +317,24 @@ int Game::renderPauseMenu() const
             case 's':
             case KEY_DOWN:
             {
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
+                menu->print(index + offset, 1, menuItems[index]);
                 index = (index + 1 + menuItems.size()) % menuItems.size(); // 循环选择
-                wattron(menu, A_STANDOUT);
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
-                wattroff(menu, A_STANDOUT);
+                menu->attrOn(A_STANDOUT);
+                menu->print(index + offset, 1, menuItems[index]);
+                menu->attrOff(A_STANDOUT);
                 break;
             }
         }
-        wrefresh(menu);
+        this->mRenderer->present();
         if (key == ' ' || key == 10) // 空格或回车，即确认
         {
             break;
         }
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
-    delwin(menu);
+    // Only the cells under the menu are repainted from the board window
+    this->mPauseMenu->hide();
+    this->mRenderer->present();
 
     return index;
 }
@@ -294,15 +342,77 @@ int Game::renderPauseMenu() const
 void Game::renderPoints() const
 {
     std::string pointString = std::to_string(this->mPoints);
-    mvwprintw(this->mWindows[2], 13, 1, pointString.c_str());
-    wrefresh(this->mWindows[2]);
+    this->mWindows[2]->print(13, 1, pointString);
+}
+
+void Game::renderDroppedFrames() const
+{
+    std::string droppedString = "Dropped: " + std::to_string(this->mPacer.getDroppedFrames());
+    this->mWindows[2]->print(14, 1, droppedString);
+}
+
+void Game::renderAutopilot() const
+{
+    if (!this->mAutopilot) {
+        this->mWindows[2]->print(11, 1, "Autopilot: B");
+        return;
+    }
+    std::string line = std::string(this->mAutopilot->getName()) + " " + this->mAutopilot->describe();
+    this->mWindows[2]->print(11, 1, line);
+}
+
+void Game::steerAutopilot(std::chrono::steady_clock::time_point deadline)
+{
+    TraceScope trace("autopilot");
+    this->mPlanState.load(this->mGameBoardWidth, this->mGameBoardHeight, this->mPtrSnake->getSnake(),
+                          this->mPtrSnake->getDirection(), this->mFood, this->mCurrentMap.getObstacles());
+    this->mPlanState.setDistances(&this->mCurrentMap.getDistances(this->mGameBoardWidth, this->mGameBoardHeight));
+    Direction current = this->mPtrSnake->getDirection();
+    this->mPlanToken.reset(deadline);
+    Direction move = this->mAutopilot->plan(this->mPlanState, this->mPlanToken);
+    // The planner never reverses, a turn goes through the same rule as keys
+    if (move != current) {
+        this->mPtrSnake->changeDirection(move);
+        this->mTelemetry.directionChange(this->mTick, move);
+    }
+}
+
+void Game::renderProfile() const
+{
+    // Same space the leader board would take
+    int rows = this->mScreenHeight - this->mInformationHeight - 14 - 2;
+    if (rows < 2)
+    {
+        return;
+    }
+    char line[32];
+    std::snprintf(line, sizeof(line), "Ticks/s %.1f", this->mProfiler.getTicksPerSecond());
+    this->mWindows[2]->print(15, 1, line);
+    this->mWindows[2]->print(16, 1, "us    p50   p99");
+    // Microseconds, milliseconds with an m once they get too wide
+    auto shorten = [](long micros) {
+        return micros < 10000 ? std::to_string(micros) : std::to_string(micros / 1000) + "m";
+    };
+    for (int i = 0; i < TickProfiler::PHASES && i + 2 < rows; i ++)
+    {
+        TickProfiler::Phase phase = static_cast<TickProfiler::Phase>(i);
+        std::snprintf(line, sizeof(line), "%-5s%5s%6s", TickProfiler::getPhaseName(phase),
+                      shorten(this->mProfiler.getPercentile(phase, 50)).c_str(),
+                      shorten(this->mProfiler.getPercentile(phase, 99)).c_str());
+        this->mWindows[2]->print(17 + i, 1, line);
+    }
+    // How often the tick cut the autopilot's search short
+    if (this->mAutopilot && TickProfiler::PHASES + 2 < rows) {
+        std::snprintf(line, sizeof(line), "Cut %.0f%% late %ld", this->mAutopilot->getTruncatedPercent(),
+                      this->mAutopilot->getStats().late);
+        this->mWindows[2]->print(17 + TickProfiler::PHASES, 1, line);
+    }
 }
 
 void Game::renderDifficulty() const
 {
     std::string difficultyString = std::to_string(this->mDifficulty);
-    mvwprintw(this->mWindows[2], 10, 1, difficultyString.c_str());
-    wrefresh(this->mWindows[2]);
+    this->mWindows[2]->print(10, 1, difficultyString);
 }
 
 void Game::initializeGame()
@@ -310,23 +420,8 @@ void Game::initializeGame()
     // allocate memory for a new snake
 		this->mPtrSnake.reset(new Snake(this->mGameBoardWidth, this->mGameBoardHeight, this->mInitialSnakeLength));
 
-    if (!has_colors()) {
-        printf("do not support colours.");
-        refresh();
-        return;
-    }
-        start_color();
-        
-        if (mColorTheme == 1) {
-            init_pair(1, COLOR_GREEN, COLOR_BLACK);
-            init_pair(2, COLOR_RED, COLOR_YELLOW);
-            init_pair(3, COLOR_BLUE, COLOR_RED);
-        } else {
-            init_pair(1, COLOR_CYAN, COLOR_BLACK);    
-            init_pair(2, COLOR_MAGENTA, COLOR_BLACK);
-            init_pair(3, COLOR_WHITE, COLOR_BLUE);   
-        }
-    
+    this->initializeColors();
+
 
     this->mPoints = 0;
     this->renderPoints();
@@ -339,9 +434,41 @@ void Game::initializeGame()
 
     this->mBaseDelay = this->mSelectedDelay;
     this->mIsFastSpeed = false;
+    this->mPacer.reset();
+    this->mProfiler.reset();
 
+    // Built once per map, the copy shares it
+    this->mAvailableMaps[mSelectedMapIndex].getDistances(this->mGameBoardWidth, this->mGameBoardHeight);
     this->mCurrentMap = mAvailableMaps[mSelectedMapIndex];
     //this->renderMap();
+
+    this->mTick = 0;
+    this->mTelemetry.gameStart(static_cast<int>(this->mCurrentMode), this->mSelectedMapIndex,
+                               this->mCurrentMap.getName(), this->mInitialSnakeLength, this->mSelectedDelay,
+                               this->mGameBoardWidth, this->mGameBoardHeight, this->mSeed);
+}
+
+void Game::initializeColors()
+{
+    // Without colours the pairs are simply never used
+    if (!this->mRenderer->hasColors()) {
+        return;
+    }
+    if (mColorTheme == 1) {
+        this->mRenderer->initColorPair(1, COLOR_GREEN, COLOR_BLACK);
+        this->mRenderer->initColorPair(2, COLOR_RED, COLOR_YELLOW);
+        this->mRenderer->initColorPair(3, COLOR_BLUE, COLOR_RED);
+    } else {
+        this->mRenderer->initColorPair(1, COLOR_CYAN, COLOR_BLACK);    
+        this->mRenderer->initColorPair(2, COLOR_MAGENTA, COLOR_BLACK);
+        this->mRenderer->initColorPair(3, COLOR_WHITE, COLOR_BLUE);   
+    }
+    // Party snakes cycle through these
+    this->mRenderer->initColorPair(4, COLOR_YELLOW, COLOR_BLACK);
+    this->mRenderer->initColorPair(5, COLOR_MAGENTA, COLOR_BLACK);
+    this->mRenderer->initColorPair(6, COLOR_CYAN, COLOR_BLACK);
+    this->mRenderer->initColorPair(7, COLOR_WHITE, COLOR_BLACK);
+    this->mRenderer->initColorPair(8, COLOR_RED, COLOR_BLACK);
 }
 
 void Game::createRamdonFood()
@@ -353,8 +480,8 @@ void Game::createRamdonFood()
 
     int foodX, foodY;
     do {
-        foodX = rand() % (this->mGameBoardWidth - 2) +1;
-        foodY = rand() % (this->mGameBoardHeight - 2) +1;
+        foodX = this->mRng.nextInt(this->mGameBoardWidth - 2) + 1;
+        foodY = this->mRng.nextInt(this->mGameBoardHeight - 2) + 1;
     } while (this->mPtrSnake->isPartOfSnake(foodX, foodY)
             || this->isObstacleAt(foodX, foodY));  // 食物不能生成在障碍物上
 
@@ -366,15 +493,18 @@ void Game::createRamdonFood()
 
 void Game::renderFood() const
 {
-    wattron(this->mWindows[1], COLOR_PAIR(2));
-    mvwaddch(this->mWindows[1], this->mFood.getY(), this->mFood.getX(), this->mFoodSymbol);
-    wattroff(this->mWindows[1], COLOR_PAIR(2));
-    wrefresh(this->mWindows[1]);
+    this->mWindows[1]->attrOn(COLOR_PAIR(2));
+    this->mWindows[1]->putChar(this->mFood.getY(), this->mFood.getX(), this->mFoodSymbol);
+    this->mWindows[1]->attrOff(COLOR_PAIR(2));
 }
 
 void Game::renderSnake() const
 {
-    wattron(this->mWindows[1], COLOR_PAIR(1));  // 启用颜色
+    if (!this->mPtrSnake)
+    {
+        return;
+    }
+    this->mWindows[1]->attrOn(COLOR_PAIR(1));  // 启用颜色
 
     int snakeLength = this->mPtrSnake->getLength();
     std::vector<SnakeBody>& snake = this->mPtrSnake->getSnake();
@@ -382,23 +512,42 @@ void Game::renderSnake() const
     // 绘制蛇身
     for (int i = 0; i < snakeLength; i ++)
     {
-        mvwaddch(this->mWindows[1], snake[i].getY(), snake[i].getX(), this->mSnakeSymbol);
+        this->mWindows[1]->putChar(snake[i].getY(), snake[i].getX(), this->mSnakeSymbol);
     }
-    wattroff(this->mWindows[1], COLOR_PAIR(1));
+    this->mWindows[1]->attrOff(COLOR_PAIR(1));
     
     // 突出蛇头
     if (snakeLength > 0) {
-        wattron(this->mWindows[1], COLOR_PAIR(1) | A_BOLD);
-        mvwaddch(this->mWindows[1], snake[0].getY(), snake[0].getX(), this->mSnakeSymbol);
-        wattroff(this->mWindows[1], COLOR_PAIR(1) | A_BOLD);
+        this->mWindows[1]->attrOn(COLOR_PAIR(1) | A_BOLD);
+        this->mWindows[1]->putChar(snake[0].getY(), snake[0].getX(), this->mSnakeSymbol);
+        this->mWindows[1]->attrOff(COLOR_PAIR(1) | A_BOLD);
+    }
+}
+
+void Game::renderHeadAndFood() const
+{
+    // The rest of the board keeps the last full frame, so the diff
+    // against the screen is just these cells. The tail's old cell is
+    // blanked first, the head may have moved onto it.
+    if (this->mHasVacated)
+    {
+        this->mWindows[1]->putChar(this->mVacated.getY(), this->mVacated.getX(), ' ');
     }
-    wrefresh(this->mWindows[1]);
+    this->renderFood();
+    const SnakeBody& head = this->mPtrSnake->getSnake()[0];
+    this->mWindows[1]->attrOn(COLOR_PAIR(1) | A_BOLD);
+    this->mWindows[1]->putChar(head.getY(), head.getX(), this->mSnakeSymbol);
+    this->mWindows[1]->attrOff(COLOR_PAIR(1) | A_BOLD);
+    Tracer::begin("present");
+    this->mRenderer->present();
+    Tracer::end("present");
 }
 
 void Game::controlSnake()   // CD: added pause function
 {
-    int key = getch();
+    int key = this->mRenderer->readKey();
     bool directionKeyPressed = false;
+    Direction direction = this->mPtrSnake->getDirection();
 
     switch(key)
     {
@@ -471,12 +620,36 @@ void Game::controlSnake()   // CD: added pause function
         case 'j':
         {
             mIsFastSpeed = !mIsFastSpeed;
+            break;
         }
+        case 'F':
+        case 'f':
+            this->mShowProfile = !this->mShowProfile;
+            break;
+        case 'B':
+        case 'b':
+            if (!this->mAutopilot) {
+                this->mAutopilot = &this->mPlanner;
+            }
+            else if (this->mAutopilot == &this->mPlanner) {
+                this->mAutopilot = &this->mDeepening;
+            }
+            else {
+                this->mAutopilot = nullptr;
+            }
+            if (this->mAutopilot) {
+                this->mAutopilot->resetStats();
+            }
+            break;
         default:
         {
             break;
         }
     }
+    if (this->mPtrSnake->getDirection() != direction)
+    {
+        this->mTelemetry.directionChange(this->mTick, this->mPtrSnake->getDirection());
+    }
 
 }
 
@@ -484,19 +657,29 @@ void Game::renderBoards() const
 {
     for (int i = 0; i < this->mWindows.size(); i ++)
     {
-        werase(this->mWindows[i]);
+        this->mWindows[i]->erase();
     }
     this->renderInformationBoard();
     this->renderGameBoard();
     this->renderInstructionBoard();
-    this->renderLeaderBoard();
+    if (this->partyWorld() && this->mShowMinimap) {
+        this->renderMinimap();
+    }
+    else if (!this->partyWorld() && this->mShowProfile) {
+        this->renderProfile();
+    }
+    else {
+        this->renderLeaderBoard();
+    }
 
     for (int i = 0; i < this->mWindows.size(); i ++)
     {
-        box(this->mWindows[i], 0, 0);
-        wrefresh(this->mWindows[i]);
+        this->mWindows[i]->drawBox();
     }
-    
+    // The whole frame goes out in one present()
+    Tracer::begin("present");
+    this->mRenderer->present();
+    Tracer::end("present");
 }
 
 
@@ -511,81 +694,159 @@ void Game::adjustDelay()
     }
 }
 
+bool Game::stepGame()
+{
+    this->adjustDelay();  
+    this->mTick ++;
+    Tracer::begin("collision");
+    auto start = std::chrono::steady_clock::now();
+    bool hitSelf = this->mPtrSnake->checkCollision();
+    bool crashed = hitSelf
+    || this->mPtrSnake->hitObstacle(mCurrentMap.getObstacles());
+    auto collided = std::chrono::steady_clock::now();
+    this->mProfiler.record(TickProfiler::COLLISION, collided - start);
+    Tracer::end("collision");
+    if (crashed)
+    {
+        this->mPlanState.load(this->mGameBoardWidth, this->mGameBoardHeight, this->mPtrSnake->getSnake(),
+                              this->mPtrSnake->getDirection(), this->mFood, this->mCurrentMap.getObstacles());
+        this->mTelemetry.death(this->mTick, hitSelf ? DeathCause::SELF : DeathCause::OBSTACLE,
+                               this->mPoints, this->mPtrSnake->getLength(), this->mPlanState.getHash());
+        return false;
+    }
+    TraceScope trace("food");
+    this->mHasVacated = !this->mPtrSnake->touchFood();
+    if (this->mHasVacated)
+    {
+        this->mVacated = this->mPtrSnake->getSnake().back();
+        this->mPtrSnake->getSnake().pop_back();
+    }
+    else
+    {
+        this->mPoints++;
+        this->mTelemetry.foodEaten(this->mTick, this->mFood.getX(), this->mFood.getY(), this->mPoints);
+        this->createRamdonFood();
+    }
+    this->mProfiler.record(TickProfiler::FOOD, std::chrono::steady_clock::now() - collided);
+    return true;
+}
+
+bool Game::resumeFromPause()
+{
+    // CD: 弹出暂停菜单:
+    int shouldRestart = this->renderPauseMenu();
+    if (shouldRestart == 1) {
+        mIsPaused = false;
+        mExitReason = GameExitReason::PLAYER_RESTART;
+        return false;
+    }
+    else if (shouldRestart == 2) {
+        mExitReason = GameExitReason::QUIT;
+        return false; // 返回主菜单
+    }
+    this->togglePause();
+    return true;
+}
+
 void Game::runGame()
 {
     bool moveSuccess;
     int key;
     // mExitReason = GameExitReason::COLLISION;
 
+    // Ticks follow a fixed schedule so that slow rendering drops frames
+    // instead of slowing the snake down
+    auto nextTick = std::chrono::steady_clock::now();
     while (true)
     {
+        TraceScope trace("tick");
+        Tracer::begin("input");
+        auto start = std::chrono::steady_clock::now();
         this->controlSnake();
-        this->renderSnake();
-        this->renderFood();
-        this->renderPoints();
-        this->renderDifficulty(); 
+        this->mProfiler.record(TickProfiler::INPUT, std::chrono::steady_clock::now() - start);
+        Tracer::end("input");
+        int actualDelay = mIsFastSpeed ? mBaseDelay / 2 : mBaseDelay;
+        if (this->mAutopilot && !mIsPaused) {
+            this->steerAutopilot(start + std::chrono::milliseconds(actualDelay * kAutopilotShare / 100));
+        }
         if (mIsPaused) {
-            // CD: 弹出暂停菜单:
-            int shouldRestart = this->renderPauseMenu();
-            if (shouldRestart == 1) {
-                mIsPaused = false;
-                mExitReason = GameExitReason::PLAYER_RESTART;
+            this->mTelemetry.pause(this->mTick, true);
+            if (!this->resumeFromPause()) {
                 return;
             }
-            else if (shouldRestart == 2) {
-                mExitReason = GameExitReason::QUIT;
-                return; // 返回主菜单
-            }
-            this->togglePause();
+            this->mTelemetry.pause(this->mTick, false);
+            nextTick = std::chrono::steady_clock::now();
+            // Time spent in the pause menu is not a slow tick
+            this->mProfiler.restart();
             continue;
         }
 
         if (!mIsPaused) 
         {        
-            this->adjustDelay();  
-            if (this->mPtrSnake->checkCollision() 
-            || this->mPtrSnake->hitObstacle(mCurrentMap.getObstacles()))
+            if (!this->stepGame())
             {
-                
                 //this->renderBoards();
                 mExitReason = GameExitReason::COLLISION;
                 //this->renderRestartMenu();
                 return;
             }
-            else if (!this->mPtrSnake->touchFood())
-            {
-                this->mPtrSnake->getSnake().pop_back();
-            }
-            else
-            {
-                this->createRamdonFood();
-                this->mPoints++;
-            }
-
         }
 
-        int actualDelay = mIsFastSpeed ? mBaseDelay / 2 : mBaseDelay;
-        std::this_thread::sleep_for(std::chrono::milliseconds(actualDelay));
-        this->renderBoards();
-        refresh();
-        
+        Tracer::begin("render");
+        auto drawStart = std::chrono::steady_clock::now();
+        if (this->mPacer.beginTick())
+        {
+            this->renderBoards();
+            this->mPacer.endFrame(this->mRenderer->getStats(), actualDelay);
+        }
+        else
+        {
+            this->renderHeadAndFood();
+        }
+        // The backends time their own terminal writes, the rest of the
+        // frame is building it
+        auto now = std::chrono::steady_clock::now();
+        Tracer::end("render");
+        std::chrono::microseconds present(this->mRenderer->getStats().stallMicros);
+        this->mProfiler.record(TickProfiler::RENDER, now - drawStart - present);
+        this->mProfiler.record(TickProfiler::PRESENT, present);
+
+        nextTick += std::chrono::milliseconds(actualDelay);
+        if (nextTick + std::chrono::milliseconds(actualDelay * 8) < now)
+        {
+            // Hopelessly behind after a long stall, do not fast-forward
+            nextTick = now;
+        }
+        Tracer::begin("sleep");
+        std::this_thread::sleep_until(nextTick);
+        Tracer::end("sleep");
+        this->mProfiler.record(TickProfiler::SLEEP, std::chrono::steady_clock::now() - now);
+        this->mProfiler.endTick();
     }
 }
 
 void Game::startGame()
 {
-    refresh();
     bool choice;
     while (true)
     {
         this->showMainMenu();
         switch (mCurrentMode) {
+            case GameMode::QUIT:
+                // Leave through ~Game() so the terminal gets restored
+                return;
             case GameMode::CLASSIC:
                 this->runClassicMode();
                 break;
             case GameMode::ENDLESS:
                 this->runEndlessMode();
                 break;
+            case GameMode::PARTY:
+                this->runPartyMode();
+                break;
+            case GameMode::ARENA:
+                this->runArenaMode();
+                break;
             case GameMode::OPTIONS:
                 this->showOptions();
                 break;
@@ -612,6 +873,7 @@ void Game::startGame()
 // https://en.cppreference.com/w/cpp/io/basic_fstream
 bool Game::readLeaderBoard()
 {
+    TraceScope trace("readLeaderBoard");
     std::fstream fhand(this->mRecordBoardFilePath, fhand.binary | fhand.in);
     if (!fhand.is_open())
     {
@@ -649,6 +911,7 @@ bool Game::updateLeaderBoard()
 
 bool Game::writeLeaderBoard()
 {
+    TraceScope trace("writeLeaderBoard");
     // trunc: clear the data file
     std::fstream fhand(this->mRecordBoardFilePath, fhand.binary | fhand.trunc | fhand.out);
     if (!fhand.is_open())
@@ -665,41 +928,39 @@ bool Game::writeLeaderBoard()
 
 void Game::showMainMenu() 
 {
-    clear();
-    refresh();
+    TraceScope trace("mainMenu");
+    // Leaving a game: uncover the background instead of clear()
+    this->hideBoards();
 
-    // create menu window
-    int height = 10;
-    int width = 30;
-    int startY = (mScreenHeight - height) / 2;
-    int startX = (mScreenWidth - width) / 2;
-
-    WINDOW* menuWin = newwin(height, width, startY, startX);
-    box(menuWin, 0, 0);
+    Surface* menuWin = this->mMainMenu.get();
+    menuWin->erase();
+    menuWin->drawBox();
+    this->mMainMenu->show();
 
     // menu options
     std::vector<std::string> menuOptions = {
         "Classic Mode",
         "Endless Mode",
+        "Party Mode",
+        "Arena Mode",
         "Options",
         "Quit"
     };
 
     int highlight = 0;
-    keypad(menuWin, true);
 
     while (true) {
         for (int i = 0; i < menuOptions.size(); i++) {
             if (i == highlight) 
-                wattron(menuWin, A_REVERSE);
-            mvwprintw(menuWin, i+2, 2, menuOptions[i].c_str());
+                menuWin->attrOn(A_REVERSE);
+            menuWin->print(i+2, 2, menuOptions[i]);
             if (i == highlight)
-                wattroff(menuWin, A_REVERSE);
+                menuWin->attrOff(A_REVERSE);
         }
 
-        wrefresh(menuWin);
+        this->mRenderer->present();
 
-        int choice = wgetch(menuWin);
+        int choice = this->mRenderer->waitKey();
 
         switch(choice) {
             case 'W':
@@ -714,7 +975,7 @@ void Game::showMainMenu()
                 break;
             case 10:
             case ' ':
-                delwin(menuWin);
+                this->mMainMenu->hide();
                 switch (highlight) {
                     case 0:
                         mCurrentMode = GameMode::CLASSIC;
@@ -725,29 +986,36 @@ void Game::showMainMenu()
                         //runEndlessMode();
                         break;
                     case 2:
+                        mCurrentMode = GameMode::PARTY;
+                        break;
+                    case 3:
+                        mCurrentMode = GameMode::ARENA;
+                        break;
+                    case 4:
                         mCurrentMode = GameMode::OPTIONS;
                         break;  // return to main menu
-                    case 3:
-                        endwin();
-                        exit(0);
+                    case 5:
+                        mCurrentMode = GameMode::QUIT;
+                        break;
                 }
             return;
             // 还有快捷键：
             case '1':
-                delwin(menuWin);
+                this->mMainMenu->hide();
                 runClassicMode();
                 return;
             case '2':
-                delwin(menuWin);
+                this->mMainMenu->hide();
                 runEndlessMode();
                 return;
             case '3':
-                delwin(menuWin);
+                // Options open on top of the main menu and uncover it when closed
                 showOptions();
                 break;
             case 27:
-                endwin();
-                exit(0);
+                this->mMainMenu->hide();
+                mCurrentMode = GameMode::QUIT;
+                return;
         }
     }
 }
@@ -761,10 +1029,11 @@ void Game::runClassicMode() {
         return;  // 回到主菜单
     }
 
+    this->showBoards();
     while (true) {
         this->readLeaderBoard();
-        this->renderBoards();
         this->initializeGame();
+        this->renderBoards();
         mIsPaused = false;
         this->runGame(); 
         switch (mExitReason) {
@@ -786,52 +1055,53 @@ void Game::runEndlessMode() {
 }
 
 void Game::showOptions() {
-    int height = 10;
-    int width = 60;
-    int startY = (mScreenHeight - height) / 2;
-    int startX = (mScreenWidth - width) / 2;
-
-    WINDOW* optionsWin = newwin(height, width, startY, startX);
-    box(optionsWin, 0, 0);
+    Surface* optionsWin = this->mOptionsMenu.get();
+    optionsWin->erase();
+    optionsWin->drawBox();
+    this->mOptionsMenu->show();
 
     std::vector<std::string> options = {
         "Initial Length",
         "Speed",
         "Color Theme",
+        "Party Snakes",
+        "Party Players",
+        "Arena Size (x100)",
+        "Arena Bots",
         "Back"
     };
 
     int highlight = 0;
-    keypad(optionsWin, true);
     mOptionIndex = 0; // CD: 添加选项索引
     mOptionActive = false; // CD: 添加选项激活状态
 
     while (true) {
         for (int i = 0; i < options.size(); i++) {
             int y = i+2;
-            wmove(optionsWin, y, 1);
-            wclrtoeol(optionsWin);
+            optionsWin->clearToEol(y, 1);
 
             if (i == highlight)
-                wattron(optionsWin, A_REVERSE);
+                optionsWin->attrOn(A_REVERSE);
             if (i < mEditableOptionsCount) {
                 if (mOptionActive && mOptionIndex == i) {
                     std::string optionText = options[i] + ": <" + std::to_string(*mOptionValues[i]) + ">";
-                    mvwprintw(optionsWin, i+2, 2, optionText.c_str());
+                    optionsWin->print(i+2, 2, optionText);
                 } else {
                     std::string optionText = options[i] + ": " + std::to_string(*mOptionValues[i]);
-                    mvwprintw(optionsWin, i+2, 2, optionText.c_str());
+                    optionsWin->print(i+2, 2, optionText);
                 }  
             } else {
-                mvwprintw(optionsWin, i+2, 2, options[i].c_str());
+                optionsWin->print(i+2, 2, options[i]);
             }
             if (i == highlight)
-                wattroff(optionsWin, A_REVERSE);
+                optionsWin->attrOff(A_REVERSE);
         }
+        // clearToEol wiped the right border of the edited lines
+        optionsWin->drawBox();
 
-        wrefresh(optionsWin);
+        this->mRenderer->present();
 
-        int key = wgetch(optionsWin);
+        int key = this->mRenderer->waitKey();
 
         if (mOptionActive) {
             switch (key) {
@@ -865,7 +1135,8 @@ void Game::showOptions() {
                 case 10:
                 case ' ':
                     if (highlight == options.size() - 1) {
-                        delwin(optionsWin);
+                        this->mOptionsMenu->hide();
+                        this->mRenderer->present();
                         return;
                     } else {
                         mOptionActive = true;
@@ -878,46 +1149,46 @@ void Game::showOptions() {
 }
 
 void Game::renderMap() const {
-    wattron(this->mWindows[1], COLOR_PAIR(3));
+    this->mWindows[1]->attrOn(COLOR_PAIR(3));
     for (const auto& obs:mCurrentMap.getObstacles()) {
-        mvwaddch(this->mWindows[1], obs.y, obs.x, '%');
+        this->mWindows[1]->putChar(obs.y, obs.x, '%');
     }
-    wattroff(this->mWindows[1], COLOR_PAIR(3));
+    this->mWindows[1]->attrOff(COLOR_PAIR(3));
 }
 
-void Game::selectMap() {
-    clear();
-    refresh();
-
-    int height = 8;
-    int width = 30;
-    int startY = (mScreenHeight - height) / 2;
-    int startX = (mScreenWidth - width) / 2;
+void Game::setSeed(uint64_t seed)
+{
+    this->mSeed = seed;
+    this->mRng.seed(seed);
+    this->mAvailableMaps = GameMap::getDefaultMaps(this->mGameBoardWidth, this->mGameBoardHeight, seed);
+}
 
-    WINDOW* mapWin = newwin(height, width, startY, startX);
-    box(mapWin, 0, 0);
+void Game::selectMap() {
+    Surface* mapWin = this->mMapMenu.get();
+    mapWin->erase();
+    mapWin->drawBox();
+    this->mMapMenu->show();
 
     std::vector<std::string> mapNames = {
         "Empty Field", "Boxed Arena", "Crossing Field", "Random", "Back"
     };
 
     int highlight = 0;
-    keypad(mapWin, true);
 
-    mvwprintw(mapWin, 1, 2, "Choose a Map:");
+    mapWin->print(1, 2, "Choose a Map:");
 
     while (true) {
         
         for (int i = 0; i < mapNames.size(); i++) {
             if (i == highlight)
-                wattron(mapWin, A_REVERSE);
-            mvwprintw(mapWin, i + 2, 4, mapNames[i].c_str());
+                mapWin->attrOn(A_REVERSE);
+            mapWin->print(i + 2, 4, mapNames[i]);
             if (i == highlight)
-                wattroff(mapWin, A_REVERSE);
+                mapWin->attrOff(A_REVERSE);
         }
 
-        wrefresh(mapWin);
-        int key = wgetch(mapWin);
+        this->mRenderer->present();
+        int key = this->mRenderer->waitKey();
         switch (key) {
             case 'w':
             case 'W':
@@ -933,15 +1204,16 @@ void Game::selectMap() {
             case ' ':
                 //mCurrentMap.loadFromFile(mapFiles[highlight]);
                 if (highlight == mapNames.size()-1) {
+                    this->mMapMenu->hide();
                     return;
                 } 
                 else if (highlight == mapNames.size()-2) {
-                    mSelectedMapIndex = rand() % mAvailableMaps.size();
+                    mSelectedMapIndex = mRng.nextInt(mAvailableMaps.size());
                 }
                 else {
                     mSelectedMapIndex = highlight;
                 }
-                delwin(mapWin);
+                this->mMapMenu->hide();
                 return;
         }
     }
@@ -959,3 +1231,407 @@ bool Game::isObstacleAt(int x, int y) const {
 
 
 
+
+void Game::runPartyMode() {
+    mCurrentMode = GameMode::PARTY;
+    this->selectMap();
+    this->mCurrentMap = mAvailableMaps[mSelectedMapIndex];
+    this->runPartyRounds();
+}
+
+void Game::runArenaMode() {
+    mCurrentMode = GameMode::ARENA;
+    // The map layouts are made for screen sized boards
+    this->mCurrentMap = GameMap("Arena", std::vector<Obstacle>{});
+    this->runPartyRounds();
+}
+
+void Game::runPartyRounds() {
+    this->initializeColors();
+    this->showBoards();
+
+    while (true) {
+        this->initializeParty();
+        mIsPaused = false;
+        this->runParty();
+        if (mExitReason == GameExitReason::COLLISION && this->renderRestartMenu()) {
+            continue;
+        }
+        if (mExitReason == GameExitReason::PLAYER_RESTART) {
+            continue;
+        }
+        break;
+    }
+    this->mPartyWorld.reset();
+    // Party scores do not go into the classic leader board
+    this->mPoints = 0;
+}
+
+void Game::initializeParty()
+{
+    int width = this->mGameBoardWidth;
+    int height = this->mGameBoardHeight;
+    int players = std::min(2, std::max(1, this->mPartyPlayers));
+    int snakes = std::max(players, this->mPartySnakes);
+    int foods = std::max(1, snakes / 2);
+    if (mCurrentMode == GameMode::ARENA) {
+        // Never smaller than the window, the view only scrolls one way
+        width = std::min(this->mMaxArenaSide, std::max(this->mGameBoardWidth, this->mArenaSize * 100));
+        height = std::min(this->mMaxArenaSide, std::max(this->mGameBoardHeight, this->mArenaSize * 100));
+        // One view can only follow one player
+        players = 1;
+        snakes = 1 + this->mArenaBots;
+        foods = snakes * 2;
+    }
+    this->mPartyWorld.reset(new World(width, height, this->mCurrentMap.getObstacles(), this->mRng.next()));
+    // Humans first, so players are snakes 0 and 1
+    for (int i = 0; i < snakes; i ++) {
+        this->mPartyWorld->spawnSnake(this->mInitialSnakeLength, i < players);
+    }
+    this->mPartyWorld->setFoodCount(foods);
+    this->resetPartyView();
+    this->mPoints = 0;
+    this->mDifficulty = 0;
+    this->mBaseDelay = this->mSelectedDelay;
+    this->mIsFastSpeed = false;
+}
+
+void Game::controlParty()
+{
+    // Two players can press keys within one tick, so drain them all.
+    // Online there is one player and both key sets steer its snake.
+    const World* world = this->partyWorld();
+    int wasdSnake = 0;
+    if (this->mNetClient) {
+        wasdSnake = this->mNetClient->getSnakeId();
+    }
+    else if (this->mLockstep) {
+        wasdSnake = this->mLockstep->getLocalPlayer();
+    }
+    bool twoPlayers = !this->mNetClient && !this->mLockstep && world->getSnakes().size() > 1
+                      && world->getSnakes()[1].human;
+    int arrowSnake = twoPlayers ? 1 : wasdSnake;
+    int key;
+    while ((key = this->mRenderer->readKey()) != ERR)
+    {
+        switch (key)
+        {
+            case 'P':
+            case 'p':
+            case 27:
+                this->togglePause();
+                return;
+            case 'W': case 'w': this->steerParty(wasdSnake, Direction::Up); break;
+            case 'S': case 's': this->steerParty(wasdSnake, Direction::Down); break;
+            case 'A': case 'a': this->steerParty(wasdSnake, Direction::Left); break;
+            case 'D': case 'd': this->steerParty(wasdSnake, Direction::Right); break;
+            case KEY_UP: this->steerParty(arrowSnake, Direction::Up); break;
+            case KEY_DOWN: this->steerParty(arrowSnake, Direction::Down); break;
+            case KEY_LEFT: this->steerParty(arrowSnake, Direction::Left); break;
+            case KEY_RIGHT: this->steerParty(arrowSnake, Direction::Right); break;
+            case 'J':
+            case 'j':
+                mIsFastSpeed = !mIsFastSpeed;
+                break;
+        }
+    }
+}
+
+void Game::steerParty(int id, Direction direction)
+{
+    if (this->mNetClient) {
+        // The server checks the turn against its own state
+        this->mNetClient->sendInput(direction);
+        return;
+    }
+    if (this->mLockstep) {
+        // Both peers turn the snake later, on the same tick
+        this->mLockstepInput = static_cast<int>(direction);
+        return;
+    }
+    this->mPartyWorld->turn(id, direction);
+}
+
+const World* Game::partyWorld() const
+{
+    if (this->mNetClient) {
+        return &this->mNetClient->getWorld();
+    }
+    return this->mPartyWorld.get();
+}
+
+void Game::runParty()
+{
+    auto nextTick = std::chrono::steady_clock::now();
+    while (true)
+    {
+        this->controlParty();
+        if (mIsPaused) {
+            if (!this->resumeFromPause()) {
+                return;
+            }
+            nextTick = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        // Bots come back after dying so the board stays busy
+        const std::vector<WorldSnake>& snakes = this->mPartyWorld->getSnakes();
+        for (int i = 0; i < snakes.size(); i ++) {
+            if (snakes[i].human) {
+                continue;
+            }
+            if (snakes[i].alive || this->mPartyWorld->respawnSnake(i, this->mInitialSnakeLength)) {
+                this->mPartyWorld->turn(i, chooseGreedyMove(*this->mPartyWorld, i));
+            }
+        }
+        this->mPartyWorld->step();
+
+        // The round lasts as long as a human is still alive
+        bool humanAlive = false;
+        for (const WorldSnake& snake : snakes) {
+            humanAlive = humanAlive || (snake.human && snake.alive);
+        }
+        this->mPoints = snakes[0].score;
+        this->updatePartyView();
+        this->renderBoards();
+        if (!humanAlive) {
+            mExitReason = GameExitReason::COLLISION;
+            return;
+        }
+
+        int actualDelay = mIsFastSpeed ? mBaseDelay / 2 : mBaseDelay;
+        nextTick += std::chrono::milliseconds(actualDelay);
+        std::this_thread::sleep_until(nextTick);
+    }
+}
+
+bool Game::runOnlineMode(const std::string& host, int port, bool spectate)
+{
+    mCurrentMode = GameMode::PARTY;
+    this->mNetClient.reset(new NetClient());
+    if (!this->mNetClient->connect(host, port, 3000, spectate)) {
+        this->mNetClient.reset();
+        return false;
+    }
+    // Obstacles come from the server, the local map list does not matter
+    this->mCurrentMap = GameMap("Online", this->mNetClient->getWorld().getObstacles());
+    this->resetPartyView();
+    this->mPoints = 0;
+    this->mDifficulty = 0;
+    this->initializeColors();
+    this->showBoards();
+    this->updatePartyView();
+    this->renderBoards();
+
+    mIsPaused = false;
+    while (true)
+    {
+        this->controlParty();
+        if (mIsPaused) {
+            // The server keeps going, missed ticks are applied on return
+            if (!this->resumeFromPause()) {
+                break;
+            }
+            continue;
+        }
+        // Ticks arrive at the server's pace, draw once per batch
+        int ticks = this->mNetClient->poll(10);
+        if (ticks < 0) {
+            break;
+        }
+        if (ticks > 0) {
+            int self = this->mNetClient->getSnakeId();
+            if (self >= 0) {
+                this->mPoints = this->partyWorld()->getSnakes()[self].score;
+            }
+            this->updatePartyView();
+            this->renderBoards();
+        }
+    }
+    this->mNetClient.reset();
+    this->mPoints = 0;
+    return true;
+}
+
+void Game::runLockstepMode(Lockstep& lockstep)
+{
+    const LockstepSetup& setup = lockstep.getSetup();
+    mCurrentMode = GameMode::PARTY;
+    // Everything random comes from the shared seed
+    std::vector<GameMap> maps = GameMap::getDefaultMaps(setup.width, setup.height, setup.seed);
+    this->mCurrentMap = maps[std::min<int>(setup.map, maps.size() - 1)];
+    this->mPartyWorld.reset(new World(setup.width, setup.height, this->mCurrentMap.getObstacles(), setup.seed));
+    int snakes = std::max(2, setup.snakes);
+    for (int i = 0; i < snakes; i ++) {
+        this->mPartyWorld->spawnSnake(setup.length, i < 2);
+    }
+    this->mPartyWorld->setFoodCount(std::max(1, snakes / 2));
+    this->mLockstep = &lockstep;
+    this->resetPartyView();
+    this->mLockstepInput = -1;
+    this->mPoints = 0;
+    this->mDifficulty = 0;
+    this->initializeColors();
+    this->showBoards();
+    this->updatePartyView();
+    this->renderBoards();
+
+    mIsPaused = false;
+    auto nextTick = std::chrono::steady_clock::now();
+    while (true)
+    {
+        this->controlParty();
+        if (mIsPaused) {
+            // The peer waits for our inputs meanwhile
+            if (!this->resumeFromPause()) {
+                break;
+            }
+            nextTick = std::chrono::steady_clock::now();
+            continue;
+        }
+        lockstep.submit(this->mLockstepInput);
+        this->mLockstepInput = -1;
+        int inputs[2];
+        if (!lockstep.nextInputs(inputs)) {
+            break;
+        }
+
+        // Same order on both peers: players, then bots, then the step
+        for (int i = 0; i < 2; i ++) {
+            if (inputs[i] >= 0) {
+                this->mPartyWorld->turn(i, static_cast<Direction>(inputs[i]));
+            }
+        }
+        const std::vector<WorldSnake>& all = this->mPartyWorld->getSnakes();
+        for (int i = 0; i < all.size(); i ++) {
+            if (all[i].alive || this->mPartyWorld->respawnSnake(i, setup.length)) {
+                if (!all[i].human) {
+                    this->mPartyWorld->turn(i, chooseGreedyMove(*this->mPartyWorld, i));
+                }
+            }
+        }
+        this->mPartyWorld->step();
+        lockstep.checkState(*this->mPartyWorld);
+        if (lockstep.getDesyncTick() >= 0) {
+            break;
+        }
+
+        this->mPoints = all[lockstep.getLocalPlayer()].score;
+        this->updatePartyView();
+        this->renderBoards();
+        nextTick += std::chrono::milliseconds(setup.tickMillis);
+        std::this_thread::sleep_until(nextTick);
+    }
+    this->mLockstep = nullptr;
+    this->mPartyWorld.reset();
+    this->mPoints = 0;
+}
+
+void Game::renderParty() const
+{
+    Surface* board = this->mWindows[1].get();
+    const World* world = this->partyWorld();
+    const BoardIndex& index = world->getIndex();
+    const std::vector<WorldSnake>& snakes = world->getSnakes();
+    int self = this->partySelf();
+    int originX = this->mCamera.getX();
+    int originY = this->mCamera.getY();
+    int endX = std::min(this->mGameBoardWidth - 1, world->getWidth() - originX);
+    int endY = std::min(this->mGameBoardHeight - 1, world->getHeight() - originY);
+
+    // Only the cells inside the window are looked at, so a frame costs
+    // the same on a 10k x 10k arena as on a screen sized board
+    for (int y = 1; y < endY; y ++) {
+        for (int x = 1; x < endX; x ++) {
+            int32_t value = index.get(originX + x, originY + y);
+            if (value == BoardIndex::kEmpty) {
+                continue;
+            }
+            if (value == BoardIndex::kFood) {
+                board->attrOn(COLOR_PAIR(2));
+                board->putChar(y, x, this->mFoodSymbol);
+                board->attrOff(COLOR_PAIR(2));
+                continue;
+            }
+            if (value == BoardIndex::kObstacle) {
+                board->attrOn(COLOR_PAIR(3));
+                board->putChar(y, x, '%');
+                board->attrOff(COLOR_PAIR(3));
+                continue;
+            }
+            int id = BoardIndex::snakeId(value);
+            if (id >= snakes.size() || snakes[id].body.empty()) {
+                continue;
+            }
+            const SnakeBody& head = snakes[id].body.front();
+            // The local player keeps the theme colour, everyone else cycles
+            int attr = COLOR_PAIR(id == self ? 1 : 4 + id % 5);
+            if (head.getX() == originX + x && head.getY() == originY + y) {
+                attr |= A_BOLD;
+            }
+            board->attrOn(attr);
+            board->putChar(y, x, snakes[id].human ? this->mSnakeSymbol : 'o');
+            board->attrOff(attr);
+        }
+    }
+}
+
+int Game::partySelf() const
+{
+    if (this->mNetClient) {
+        return this->mNetClient->getSnakeId();
+    }
+    if (this->mLockstep) {
+        return this->mLockstep->getLocalPlayer();
+    }
+    return 0;
+}
+
+void Game::resetPartyView()
+{
+    const World* world = this->partyWorld();
+    this->mCamera.reset(this->mGameBoardWidth, this->mGameBoardHeight, world->getWidth(), world->getHeight());
+    // Below the points, where the leader board goes in the other modes
+    int rows = this->mScreenHeight - this->mInformationHeight - 17;
+    bool scrolls = world->getWidth() > this->mGameBoardWidth || world->getHeight() > this->mGameBoardHeight;
+    this->mShowMinimap = scrolls && rows >= 3;
+    if (this->mShowMinimap) {
+        this->mMinimap.reset(*world, this->mInstructionWidth - 2, rows);
+    }
+    this->updatePartyView();
+}
+
+void Game::updatePartyView()
+{
+    const World* world = this->partyWorld();
+    int self = this->partySelf();
+    if (self >= 0 && self < world->getSnakes().size() && !world->getSnakes()[self].body.empty()) {
+        const SnakeBody& head = world->getSnakes()[self].body.front();
+        this->mCamera.follow(head.getX(), head.getY());
+    }
+    if (this->mShowMinimap) {
+        this->mMinimap.update(*world);
+    }
+}
+
+void Game::renderMinimap() const
+{
+    Surface* panel = this->mWindows[2].get();
+    panel->print(15, 1, "Minimap");
+    for (int y = 0; y < this->mMinimap.getHeight(); y ++) {
+        for (int x = 0; x < this->mMinimap.getWidth(); x ++) {
+            char cell = this->mMinimap.getCell(x, y);
+            if (cell != ' ') {
+                panel->putChar(16 + y, 1 + x, cell);
+            }
+        }
+    }
+    int self = this->partySelf();
+    const std::vector<WorldSnake>& snakes = this->partyWorld()->getSnakes();
+    if (self >= 0 && self < snakes.size() && snakes[self].alive) {
+        const SnakeBody& head = snakes[self].body.front();
+        panel->attrOn(COLOR_PAIR(1) | A_BOLD);
+        panel->putChar(16 + this->mMinimap.toMinimapY(head.getY()), 1 + this->mMinimap.toMinimapX(head.getX()), '@');
+        panel->attrOff(COLOR_PAIR(1) | A_BOLD);
+    }
+}
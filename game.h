@@ -1,7 +1,6 @@
 #ifndef GAME_H
 #define GAME_H
 
-#include <ncurses.h>
 #include <string>
 #include <vector>
 #include <memory>
@@ -9,12 +8,26 @@
 
 #include "snake.h"
 #include "map.h"
+#include "renderer.h"
+#include "pacer.h"
+#include "profiler.h"
+#include "telemetry.h"
+#include "mcts.h"
+#include "deepening.h"
+#include "world.h"
+#include "net_client.h"
+#include "lockstep.h"
+#include "rng.h"
+#include "camera.h"
+#include "minimap.h"
 
 
 class Game
 {
 public:
     Game();
+    // Draw through the given backend instead of curses
+    explicit Game(std::unique_ptr<Renderer> renderer);
     ~Game();
     
 		void createInformationBoard();
@@ -37,12 +50,21 @@ public:
     
 		void initializeGame();
     void runGame();
+    // One simulation tick without input, drawing or sleeping.
+    // Returns false when the snake crashed.
+    bool stepGame();
     void renderPoints() const;
     void renderDifficulty() const;
+    void renderDroppedFrames() const;
+    // Per phase p50/p99 and ticks/s in place of the leader board
+    void renderProfile() const;
+    void renderAutopilot() const;
     
 		void createRamdonFood();
     void renderFood() const;
     void renderSnake() const;
+    // Cheap update for ticks the pacer skips: new head and food only
+    void renderHeadAndFood() const;
     void controlSnake() ; // CD：删去了const
     
 		void startGame();
@@ -53,14 +75,40 @@ public:
     void togglePause();  // 添加暂停/恢复方法
     bool isGamePaused() const;  // 获取当前状态
 
-    enum class GameMode { CLASSIC, ENDLESS, OPTIONS };
+    enum class GameMode { CLASSIC, ENDLESS, PARTY, ARENA, OPTIONS, QUIT };
     void showMainMenu();
     void runClassicMode();
     void runEndlessMode();
     void showOptions();
 
+    // Party mode: several humans and bots share one board, see world.h
+    void runPartyMode();
+    void initializeParty();
+    void runParty();
+    void controlParty();
+    void renderParty() const;
+    // One player against hundreds of bots on a board of up to 10k x 10k
+    // cells, the view follows the player's snake
+    void runArenaMode();
+    // Thin client of snake-server: keys go to the server and the board
+    // shows its replica. Spectators only watch. False when the server
+    // could not be reached.
+    bool runOnlineMode(const std::string& host, int port, bool spectate);
+    // Two peers on one board, both simulating it, see lockstep.h
+    void runLockstepMode(Lockstep& lockstep);
+
     //void renderMap() const;
     void selectMap();
+    // Food, random maps and map layouts all come from this seed, so the
+    // same seed and keys replay the same game
+    void setSeed(uint64_t seed);
+
+    // Classic games log their events to path, see telemetry.h
+    bool startTelemetry(const std::string& path);
+
+    // Board windows sit in the surface stack under the menus
+    void showBoards() const;
+    void hideBoards() const;
 
     
 
@@ -72,13 +120,26 @@ private:
       QUIT
     };
     GameExitReason mExitReason;
+    // Shows the pause menu, false when the player left the game
+    bool resumeFromPause();
+    void initializeColors();
     int mScreenWidth;
     int mScreenHeight;
     int mGameBoardWidth;
     int mGameBoardHeight;
     const int mInformationHeight = 6;
     const int mInstructionWidth = 18;
-    std::vector<WINDOW *> mWindows;
+    // Declared before the surfaces so that it outlives them
+    std::unique_ptr<Renderer> mRenderer;
+    std::vector<std::unique_ptr<Surface>> mWindows;
+    // Menus are created once and reused, showing and hiding them
+    // only repaints the cells they cover
+    std::unique_ptr<Surface> mMainMenu;
+    std::unique_ptr<Surface> mMapMenu;
+    std::unique_ptr<Surface> mOptionsMenu;
+    std::unique_ptr<Surface> mPauseMenu;
+    std::unique_ptr<Surface> mRestartMenu;
+    void createMenus();
     // Snake information
     int mInitialSnakeLength = 2;
     const char mSnakeSymbol = '@';
@@ -86,8 +147,33 @@ private:
     // Food information
     SnakeBody mFood;
     const char mFoodSymbol = '#';
+    // The cell the tail left on the last tick, unset when the snake grew
+    SnakeBody mVacated;
+    bool mHasVacated = false;
     int mPoints = 0;
     int mDifficulty = 0;
+    uint64_t mSeed;
+    Rng mRng;
+    // Drops full frames while the terminal cannot keep up
+    FramePacer mPacer;
+    // Phase timings of classic ticks, shown while mShowProfile is set
+    TickProfiler mProfiler;
+    bool mShowProfile = false;
+    // Balancing events of classic games, off unless started
+    Telemetry mTelemetry;
+    // Ticks of the current classic game
+    uint32_t mTick = 0;
+    // B hands the classic snake to a planner, and pressing it again
+    // switches to the next planner and then back to the keys. The tick
+    // cancels the planner's token once this share of it has gone,
+    // leaving the rest for drawing.
+    void steerAutopilot(std::chrono::steady_clock::time_point deadline);
+    static const int kAutopilotShare = 50;
+    MctsPlanner mPlanner;
+    DeepeningPlanner mDeepening;
+    AnytimePlanner* mAutopilot = nullptr;
+    CancelToken mPlanToken;
+    ClassicState mPlanState;
     // int mDelay;
     const std::string mRecordBoardFilePath = "record.dat";
     std::vector<int> mLeaderBoard;
@@ -101,6 +187,33 @@ private:
       &mSelectedDelay,
       &mColorTheme
     };
+    // Party mode
+    std::unique_ptr<World> mPartyWorld;
+    std::unique_ptr<NetClient> mNetClient;
+    Lockstep* mLockstep = nullptr;
+    // Latest key of this tick, handed to the lockstep peer once per tick
+    int mLockstepInput = -1;
+    // The board party drawing reads, local or the server replica
+    const World* partyWorld() const;
+    void steerParty(int id, Direction direction);
+    // Rounds of party or arena play until the player leaves
+    void runPartyRounds();
+    // Snake steered from this terminal, -1 for spectators
+    int partySelf() const;
+    // The camera follows the local snake on boards larger than the
+    // window, which also get a minimap instead of the leader board
+    void resetPartyView();
+    void updatePartyView();
+    void renderMinimap() const;
+    Camera mCamera;
+    Minimap mMinimap;
+    bool mShowMinimap = false;
+    int mPartySnakes = 8;
+    int mPartyPlayers = 1;
+    // Arena side in hundreds of cells
+    int mArenaSize = 10;
+    int mArenaBots = 200;
+    const int mMaxArenaSide = 10000;
     int mSelectedDelay = 150;
     int mBaseDelay;
     int mColorTheme = 1;
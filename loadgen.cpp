@@ -0,0 +1,676 @@
+// Load generator for snake-server: opens many player connections, each
+// steering its snake every few ticks, and reports how the server keeps
+// up as JSON. Server side tick times come from STATS requests; round
+// trips, the gaps between deltas and the bytes moved are measured here.
+//
+//   snake-loadgen [--host H] [--port P] [--games N] [--bots N]
+//                 [--step N] [--seconds S] [--turn-every K]
+//                 [--script KEYS] [--seed S] [--threads N]
+//
+// --games N spreads the bots over servers on ports P .. P+N-1. With
+// --step N the bots are added N at a time, one JSON line per stage, and
+// the run stops at the first stage where ticks start a whole tick late.
+// --script takes wasd keys that every bot cycles through, otherwise the
+// turns are random. The bots are split over --threads epoll loops, one
+// per core by default.
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "net.h"
+#include "protocol.h"
+#include "rng.h"
+
+namespace
+{
+    struct Options
+    {
+        std::string host = "127.0.0.1";
+        int port = 7777;
+        int games = 1;
+        int bots = 100;
+        int step = 0;
+        int seconds = 10;
+        int turnEvery = 1;
+        std::string script;
+        unsigned seed = 1;
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; i ++)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--host" && hasValue) options.host = argv[++ i];
+            else if (arg == "--port" && hasValue) options.port = std::atoi(argv[++ i]);
+            else if (arg == "--games" && hasValue) options.games = std::max(1, std::atoi(argv[++ i]));
+            else if (arg == "--bots" && hasValue) options.bots = std::max(1, std::atoi(argv[++ i]));
+            else if (arg == "--step" && hasValue) options.step = std::atoi(argv[++ i]);
+            else if (arg == "--seconds" && hasValue) options.seconds = std::max(1, std::atoi(argv[++ i]));
+            else if (arg == "--turn-every" && hasValue) options.turnEvery = std::max(1, std::atoi(argv[++ i]));
+            else if (arg == "--script" && hasValue) options.script = argv[++ i];
+            else if (arg == "--seed" && hasValue) options.seed = std::atoi(argv[++ i]);
+            else if (arg == "--threads" && hasValue) options.threads = std::max(1, std::atoi(argv[++ i]));
+            else
+            {
+                std::cerr << "usage: " << argv[0]
+                          << " [--host H] [--port P] [--games N] [--bots N] [--step N] [--seconds S]"
+                          << " [--turn-every K] [--script KEYS] [--seed S] [--threads N]" << std::endl;
+                std::exit(1);
+            }
+        }
+        return options;
+    }
+
+    // Connects in flight at once, more would only overflow the backlog
+    const int kMaxConnecting = 256;
+    // Every bot pings this often
+    const int kPingMillis = 1000;
+    // Time allowed to get every bot of a stage on the board
+    const int kJoinMillis = 20000;
+    // A stage slips once more than this share of ticks starts a tick late
+    const double kSlipRatio = 0.01;
+
+    volatile std::sig_atomic_t gStop = 0;
+
+    void onSignal(int)
+    {
+        gStop = 1;
+    }
+
+    uint32_t percentile(std::vector<uint32_t> values, double p)
+    {
+        if (values.empty())
+        {
+            return 0;
+        }
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+    }
+
+    std::string percentiles(const std::vector<uint32_t>& values)
+    {
+        uint32_t max = values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+        return "{\"p50\":" + std::to_string(percentile(values, 0.5))
+               + ",\"p99\":" + std::to_string(percentile(values, 0.99))
+               + ",\"max\":" + std::to_string(max) + "}";
+    }
+
+    bool toDirection(char key, Direction& direction)
+    {
+        switch (key)
+        {
+            case 'w': direction = Direction::Up; return true;
+            case 's': direction = Direction::Down; return true;
+            case 'a': direction = Direction::Left; return true;
+            case 'd': direction = Direction::Right; return true;
+            default: return false;
+        }
+    }
+
+    struct Bot
+    {
+        uint32_t index;
+        int fd;
+        bool connected;
+        bool joined;
+        bool closed;
+        FrameReader reader;
+        size_t scriptPos;
+        bool hasDelta;
+        std::chrono::steady_clock::time_point lastDelta;
+    };
+
+    // What the bots of one worker measured since the last take()
+    struct Samples
+    {
+        std::vector<uint32_t> roundTrips;
+        std::vector<uint32_t> gaps;
+        uint64_t bytesReceived = 0;
+        uint64_t bytesSent = 0;
+        uint64_t droppedSends = 0;
+        int disconnects = 0;
+    };
+
+    // One thread with its own epoll set and bots. The main thread only
+    // sets how many bots it should keep on the board and takes samples.
+    class Worker
+    {
+    public:
+        Worker(const Options& options, int index, int count, std::chrono::steady_clock::time_point start)
+            : mOptions(options), mIndex(index), mCount(count), mEpoll(epoll_create1(0)),
+              mRng(options.seed + index), mStart(start), mTarget(0), mJoined(0), mTickMillis(0),
+              mDisconnects(0), mStop(false), mConnecting(0), mAlive(0), mNextPing(0)
+        {
+            for (char key : options.script)
+            {
+                Direction direction;
+                if (toDirection(key, direction))
+                {
+                    this->mScript.push_back(direction);
+                }
+            }
+        }
+
+        ~Worker()
+        {
+            this->stop();
+            for (auto& bot : this->mBots)
+            {
+                if (!bot->closed)
+                {
+                    close(bot->fd);
+                }
+            }
+            close(this->mEpoll);
+        }
+
+        void start()
+        {
+            this->mThread = std::thread(&Worker::run, this);
+        }
+
+        void stop()
+        {
+            this->mStop = true;
+            if (this->mThread.joinable())
+            {
+                this->mThread.join();
+            }
+        }
+
+        void setTarget(int bots)
+        {
+            this->mTarget = bots;
+        }
+
+        int getJoined() const
+        {
+            return this->mJoined;
+        }
+
+        int getTickMillis() const
+        {
+            return this->mTickMillis;
+        }
+
+        Samples take()
+        {
+            std::lock_guard<std::mutex> lock(this->mMutex);
+            Samples samples = std::move(this->mSamples);
+            this->mSamples = Samples();
+            samples.disconnects = this->mDisconnects.exchange(0);
+            return samples;
+        }
+
+    private:
+        void run()
+        {
+            auto lastPing = std::chrono::steady_clock::now();
+            while (!this->mStop)
+            {
+                // Bots that got dropped are replaced too
+                while (this->mConnecting < kMaxConnecting && this->mAlive < this->mTarget && this->startBot())
+                {
+                }
+                this->pump(5);
+                // Spread the pings evenly instead of bursting every second
+                auto now = std::chrono::steady_clock::now();
+                long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastPing).count();
+                long pings = elapsed * this->mBots.size() / kPingMillis;
+                if (pings > 0)
+                {
+                    this->ping(pings);
+                    lastPing = now;
+                }
+            }
+        }
+
+        bool startBot()
+        {
+            // Bots are dealt to the games across workers, like cards
+            int game = (this->mBots.size() * this->mCount + this->mIndex) % this->mOptions.games;
+            int fd = startConnectTcp(this->mOptions.host, this->mOptions.port + game);
+            if (fd < 0)
+            {
+                return false;
+            }
+            epoll_event event = {};
+            event.events = EPOLLOUT;
+            event.data.u32 = this->mBots.size();
+            if (epoll_ctl(this->mEpoll, EPOLL_CTL_ADD, fd, &event) != 0)
+            {
+                close(fd);
+                return false;
+            }
+            this->mBots.emplace_back(new Bot{static_cast<uint32_t>(this->mBots.size()), fd, false, false, false,
+                                             FrameReader(), 0, false, std::chrono::steady_clock::time_point()});
+            this->mConnecting ++;
+            this->mAlive ++;
+            return true;
+        }
+
+        void ping(long count)
+        {
+            // Microseconds since start, echoed back unchanged
+            uint32_t stamp = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - this->mStart).count();
+            std::string message = encodePing(MessageType::PING, stamp);
+            for (long i = 0; i < count && !this->mBots.empty(); i ++)
+            {
+                Bot& bot = *this->mBots[this->mNextPing];
+                this->mNextPing = (this->mNextPing + 1) % this->mBots.size();
+                if (bot.joined && !bot.closed)
+                {
+                    this->send(bot, message);
+                }
+            }
+        }
+
+        void pump(int timeoutMillis)
+        {
+            epoll_event events[256];
+            int count = epoll_wait(this->mEpoll, events, 256, timeoutMillis);
+            for (int i = 0; i < count; i ++)
+            {
+                Bot& bot = *this->mBots[events[i].data.u32];
+                if (bot.closed)
+                {
+                    continue;
+                }
+                if (!bot.connected)
+                {
+                    this->finishConnect(bot);
+                }
+                else
+                {
+                    this->receive(bot);
+                }
+            }
+        }
+
+        void finishConnect(Bot& bot)
+        {
+            this->mConnecting --;
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (getsockopt(bot.fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0)
+            {
+                this->closeBot(bot);
+                return;
+            }
+            bot.connected = true;
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.u32 = bot.index;
+            epoll_ctl(this->mEpoll, EPOLL_CTL_MOD, bot.fd, &event);
+            this->send(bot, encodeHello());
+        }
+
+        void receive(Bot& bot)
+        {
+            char buffer[16384];
+            ssize_t n;
+            uint64_t received = 0;
+            while ((n = recv(bot.fd, buffer, sizeof(buffer), 0)) > 0)
+            {
+                received += n;
+                bot.reader.feed(buffer, n);
+            }
+            {
+                std::lock_guard<std::mutex> lock(this->mMutex);
+                this->mSamples.bytesReceived += received;
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EINTR))
+            {
+                this->closeBot(bot);
+                return;
+            }
+            std::string payload;
+            while (!bot.closed && bot.reader.next(payload))
+            {
+                this->handle(bot, payload);
+            }
+            if (!bot.closed && bot.reader.isBroken())
+            {
+                this->closeBot(bot);
+            }
+        }
+
+        void handle(Bot& bot, const std::string& payload)
+        {
+            auto now = std::chrono::steady_clock::now();
+            switch (messageType(payload))
+            {
+                case MessageType::WELCOME:
+                {
+                    Welcome welcome;
+                    if (decodeWelcome(payload, welcome) && !bot.joined)
+                    {
+                        bot.joined = true;
+                        this->mJoined ++;
+                        this->mTickMillis = welcome.tickMillis;
+                    }
+                    break;
+                }
+                case MessageType::DELTA:
+                {
+                    // The bots steer blind, so the events are not needed
+                    uint32_t tick;
+                    if (!decodeDeltaTick(payload, tick))
+                    {
+                        this->closeBot(bot);
+                        return;
+                    }
+                    if (bot.hasDelta)
+                    {
+                        std::lock_guard<std::mutex> lock(this->mMutex);
+                        this->mSamples.gaps.push_back(
+                            std::chrono::duration_cast<std::chrono::microseconds>(now - bot.lastDelta).count());
+                    }
+                    bot.hasDelta = true;
+                    bot.lastDelta = now;
+                    // Bots take turns on different ticks, like players do
+                    if ((tick + bot.index) % this->mOptions.turnEvery == 0)
+                    {
+                        this->send(bot, encodeInput(this->nextDirection(bot), tick + 1));
+                    }
+                    break;
+                }
+                case MessageType::PONG:
+                {
+                    uint32_t stamp;
+                    if (decodePing(payload, stamp))
+                    {
+                        uint32_t received = std::chrono::duration_cast<std::chrono::microseconds>(now - this->mStart).count();
+                        std::lock_guard<std::mutex> lock(this->mMutex);
+                        this->mSamples.roundTrips.push_back(received - stamp);
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+
+        Direction nextDirection(Bot& bot)
+        {
+            if (this->mScript.empty())
+            {
+                return static_cast<Direction>(this->mRng.nextInt(4));
+            }
+            return this->mScript[bot.scriptPos ++ % this->mScript.size()];
+        }
+
+        void send(Bot& bot, const std::string& message)
+        {
+            ssize_t n = ::send(bot.fd, message.data(), message.size(), MSG_NOSIGNAL);
+            std::lock_guard<std::mutex> lock(this->mMutex);
+            if (n == static_cast<ssize_t>(message.size()))
+            {
+                this->mSamples.bytesSent += n;
+                return;
+            }
+            this->mSamples.droppedSends ++;
+            // Part of a message would garble the rest of the stream
+            if (n > 0 || (errno != EAGAIN && errno != EINTR))
+            {
+                this->closeBot(bot);
+            }
+        }
+
+        // Takes no lock, send() calls it while holding mMutex
+        void closeBot(Bot& bot)
+        {
+            if (bot.closed)
+            {
+                return;
+            }
+            if (!bot.connected)
+            {
+                this->mConnecting --;
+            }
+            if (bot.joined)
+            {
+                this->mJoined --;
+            }
+            bot.closed = true;
+            this->mAlive --;
+            this->mDisconnects ++;
+            close(bot.fd);
+        }
+
+        const Options& mOptions;
+        int mIndex;
+        int mCount;
+        int mEpoll;
+        Rng mRng;
+        std::chrono::steady_clock::time_point mStart;
+        std::vector<Direction> mScript;
+        std::thread mThread;
+        std::atomic<int> mTarget;
+        std::atomic<int> mJoined;
+        std::atomic<int> mTickMillis;
+        std::atomic<int> mDisconnects;
+        std::atomic<bool> mStop;
+        // Only touched by the worker thread
+        std::vector<std::unique_ptr<Bot>> mBots;
+        int mConnecting;
+        int mAlive;
+        size_t mNextPing;
+        std::mutex mMutex;
+        Samples mSamples;
+    };
+
+    class LoadGenerator
+    {
+    public:
+        explicit LoadGenerator(const Options& options) : mOptions(options), mSlipping(false)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < options.threads; i ++)
+            {
+                this->mWorkers.emplace_back(new Worker(this->mOptions, i, options.threads, start));
+                this->mWorkers.back()->start();
+            }
+        }
+
+        int run()
+        {
+            int step = this->mOptions.step > 0 ? this->mOptions.step : this->mOptions.bots;
+            for (int target = step; !gStop; target = std::min(this->mOptions.bots, target + step))
+            {
+                if (!this->join(target))
+                {
+                    std::cerr << "only " << this->getJoined() << " of " << target << " bots joined" << std::endl;
+                    return 1;
+                }
+                if (!this->measure(target))
+                {
+                    std::cerr << "no stats from the server" << std::endl;
+                    return 1;
+                }
+                if (this->mSlipping || target >= this->mOptions.bots)
+                {
+                    break;
+                }
+            }
+            return 0;
+        }
+
+    private:
+        int getJoined() const
+        {
+            int joined = 0;
+            for (auto& worker : this->mWorkers)
+            {
+                joined += worker->getJoined();
+            }
+            return joined;
+        }
+
+        // Waits until target bots are on the board
+        bool join(int target)
+        {
+            int threads = this->mWorkers.size();
+            for (int i = 0; i < threads; i ++)
+            {
+                this->mWorkers[i]->setTarget(target / threads + (i < target % threads ? 1 : 0));
+            }
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kJoinMillis);
+            while (!gStop && this->getJoined() < target && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return this->getJoined() >= target;
+        }
+
+        // Clears the server's tick times, runs the stage and prints it
+        bool measure(int target)
+        {
+            std::vector<ServerStats> stats;
+            if (!this->collectStats(stats))
+            {
+                return false;
+            }
+            for (auto& worker : this->mWorkers)
+            {
+                worker->take();
+            }
+            auto start = std::chrono::steady_clock::now();
+            auto end = start + std::chrono::seconds(this->mOptions.seconds);
+            while (!gStop && std::chrono::steady_clock::now() < end)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            Samples total;
+            for (auto& worker : this->mWorkers)
+            {
+                Samples samples = worker->take();
+                total.roundTrips.insert(total.roundTrips.end(), samples.roundTrips.begin(), samples.roundTrips.end());
+                total.gaps.insert(total.gaps.end(), samples.gaps.begin(), samples.gaps.end());
+                total.bytesReceived += samples.bytesReceived;
+                total.bytesSent += samples.bytesSent;
+                total.droppedSends += samples.droppedSends;
+                total.disconnects += samples.disconnects;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (!this->collectStats(stats))
+            {
+                return false;
+            }
+
+            ServerStats server = {};
+            for (const ServerStats& game : stats)
+            {
+                server.ticks += game.ticks;
+                server.tickMicrosP50 = std::max(server.tickMicrosP50, game.tickMicrosP50);
+                server.tickMicrosP99 = std::max(server.tickMicrosP99, game.tickMicrosP99);
+                server.tickMicrosMax = std::max(server.tickMicrosMax, game.tickMicrosMax);
+                server.lateMicrosP99 = std::max(server.lateMicrosP99, game.lateMicrosP99);
+                server.lateTicks += game.lateTicks;
+            }
+            this->mSlipping = server.lateTicks > kSlipRatio * server.ticks;
+            int joined = this->getJoined();
+            std::cout << "{\"bots\":" << target
+                      << ",\"games\":" << this->mOptions.games
+                      << ",\"threads\":" << this->mOptions.threads
+                      << ",\"joined\":" << joined
+                      << ",\"disconnects\":" << total.disconnects
+                      << ",\"seconds\":" << seconds
+                      << ",\"tickMillis\":" << this->mWorkers.front()->getTickMillis()
+                      << ",\"serverTicks\":" << server.ticks
+                      << ",\"serverTickMicros\":{\"p50\":" << server.tickMicrosP50
+                      << ",\"p99\":" << server.tickMicrosP99
+                      << ",\"max\":" << server.tickMicrosMax << "}"
+                      << ",\"serverLateMicrosP99\":" << server.lateMicrosP99
+                      << ",\"serverLateTicks\":" << server.lateTicks
+                      << ",\"roundTripMicros\":" << percentiles(total.roundTrips)
+                      << ",\"tickGapMicros\":" << percentiles(total.gaps)
+                      << ",\"rxBytesPerSec\":" << static_cast<uint64_t>(total.bytesReceived / seconds)
+                      << ",\"txBytesPerSec\":" << static_cast<uint64_t>(total.bytesSent / seconds)
+                      << ",\"rxBytesPerClientPerSec\":" << static_cast<uint64_t>(total.bytesReceived / seconds / std::max(1, joined))
+                      << ",\"droppedSends\":" << total.droppedSends
+                      << ",\"slipping\":" << (this->mSlipping ? "true" : "false") << "}" << std::endl;
+            return true;
+        }
+
+        // Asks every server over a connection of its own, so the reply
+        // does not queue behind ticks
+        bool collectStats(std::vector<ServerStats>& stats)
+        {
+            stats.clear();
+            for (int game = 0; game < this->mOptions.games; game ++)
+            {
+                int fd = connectTcp(this->mOptions.host, this->mOptions.port + game);
+                if (fd < 0)
+                {
+                    return false;
+                }
+                std::string request = encodeStatsRequest();
+                ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+                FrameReader reader;
+                std::string payload;
+                ServerStats reply;
+                bool received = false;
+                while (!received)
+                {
+                    pollfd poller = {fd, POLLIN, 0};
+                    char buffer[256];
+                    ssize_t n = poll(&poller, 1, 2000) > 0 ? recv(fd, buffer, sizeof(buffer), 0) : -1;
+                    if (n <= 0)
+                    {
+                        break;
+                    }
+                    reader.feed(buffer, n);
+                    received = reader.next(payload) && decodeServerStats(payload, reply);
+                }
+                close(fd);
+                if (!received)
+                {
+                    return false;
+                }
+                stats.push_back(reply);
+            }
+            return true;
+        }
+
+        const Options& mOptions;
+        std::vector<std::unique_ptr<Worker>> mWorkers;
+        bool mSlipping;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    Options options = parseOptions(argc, argv);
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max)
+    {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+    LoadGenerator generator(options);
+    return generator.run();
+}
@@ -0,0 +1,239 @@
+#include <chrono>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "lockstep.h"
+#include "net.h"
+
+namespace
+{
+    // A peer that sends nothing for this long is treated as gone, this
+    // also covers the other player sitting in the pause menu
+    const int kPeerTimeoutMillis = 30000;
+}
+
+Lockstep::Lockstep()
+    : mSocket(-1), mLocalPlayer(0), mSetup(), mTick(0), mDesyncTick(-1),
+      mBytesSent(0), mStallMillis(0)
+{
+}
+
+Lockstep::~Lockstep()
+{
+    if (this->mSocket >= 0)
+    {
+        close(this->mSocket);
+    }
+}
+
+bool Lockstep::host(const std::string& address, int port, const LockstepSetup& setup, int timeoutMillis)
+{
+    int listener = listenTcp(address, port);
+    if (listener < 0)
+    {
+        return false;
+    }
+    pollfd fd = {listener, POLLIN, 0};
+    if (poll(&fd, 1, timeoutMillis) > 0)
+    {
+        // Accepted sockets do not inherit O_NONBLOCK
+        this->mSocket = accept(listener, nullptr, nullptr);
+    }
+    close(listener);
+    if (this->mSocket < 0)
+    {
+        return false;
+    }
+    setNoDelay(this->mSocket);
+    this->mSetup = setup;
+    this->mLocalPlayer = 0;
+    this->send(encodeSetup(setup));
+    this->start();
+    return true;
+}
+
+bool Lockstep::join(const std::string& address, int port, int timeoutMillis)
+{
+    this->mSocket = connectTcp(address, port);
+    if (this->mSocket < 0)
+    {
+        return false;
+    }
+    this->mLocalPlayer = 1;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+    std::string payload;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        if (!this->pump(10))
+        {
+            return false;
+        }
+        if (this->mReader.next(payload))
+        {
+            if (!decodeSetup(payload, this->mSetup))
+            {
+                return false;
+            }
+            this->start();
+            return true;
+        }
+    }
+    return false;
+}
+
+void Lockstep::start()
+{
+    if (this->mSetup.hashInterval < 1)
+    {
+        this->mSetup.hashInterval = 1;
+    }
+    // Nobody pressed anything before the game started, which is also what
+    // gives the inputs of later ticks time to travel
+    for (int i = 0; i < this->mSetup.inputDelay; i ++)
+    {
+        this->submit(-1);
+    }
+}
+
+void Lockstep::send(const std::string& message)
+{
+    ssize_t n = ::send(this->mSocket, message.data(), message.size(), MSG_NOSIGNAL);
+    if (n > 0)
+    {
+        this->mBytesSent += n;
+    }
+}
+
+bool Lockstep::pump(int timeoutMillis)
+{
+    // Nothing more can be read once the framing is lost
+    if (this->mReader.isBroken())
+    {
+        return false;
+    }
+    pollfd fd = {this->mSocket, POLLIN, 0};
+    if (poll(&fd, 1, timeoutMillis) <= 0)
+    {
+        return true;
+    }
+    char buffer[4096];
+    ssize_t n = recv(this->mSocket, buffer, sizeof(buffer), 0);
+    if (n <= 0)
+    {
+        return false;
+    }
+    this->mReader.feed(buffer, n);
+    return true;
+}
+
+void Lockstep::submit(int input)
+{
+    this->mLocalInputs.push_back(input);
+    this->send(encodeTickInput(input));
+}
+
+bool Lockstep::nextInputs(int inputs[2])
+{
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::milliseconds(kPeerTimeoutMillis);
+    std::string payload;
+    while (true)
+    {
+        while (this->mRemoteInputs.empty() && this->mReader.next(payload))
+        {
+            int input;
+            uint32_t tick;
+            uint64_t hash;
+            if (decodeTickInput(payload, input))
+            {
+                this->mRemoteInputs.push_back(input);
+            }
+            else if (decodeStateHash(payload, tick, hash))
+            {
+                this->mRemoteHashes[tick] = hash;
+                this->compareHash(tick);
+            }
+            else
+            {
+                return false;
+            }
+        }
+        if (!this->mRemoteInputs.empty())
+        {
+            break;
+        }
+        if (std::chrono::steady_clock::now() > deadline || !this->pump(10))
+        {
+            return false;
+        }
+    }
+    this->mStallMillis += std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    inputs[this->mLocalPlayer] = this->mLocalInputs.front();
+    inputs[1 - this->mLocalPlayer] = this->mRemoteInputs.front();
+    this->mLocalInputs.pop_front();
+    this->mRemoteInputs.pop_front();
+    this->mTick ++;
+    return true;
+}
+
+void Lockstep::checkState(const World& world)
+{
+    uint32_t tick = world.getTick();
+    if (tick % this->mSetup.hashInterval != 0)
+    {
+        return;
+    }
+    uint64_t hash = world.stateHash();
+    this->mLocalHashes[tick] = hash;
+    this->send(encodeStateHash(tick, hash));
+    this->compareHash(tick);
+}
+
+void Lockstep::compareHash(uint32_t tick)
+{
+    auto local = this->mLocalHashes.find(tick);
+    auto remote = this->mRemoteHashes.find(tick);
+    if (local == this->mLocalHashes.end() || remote == this->mRemoteHashes.end())
+    {
+        return;
+    }
+    if (local->second != remote->second && this->mDesyncTick < 0)
+    {
+        this->mDesyncTick = tick;
+    }
+    this->mLocalHashes.erase(local);
+    this->mRemoteHashes.erase(remote);
+}
+
+const LockstepSetup& Lockstep::getSetup() const
+{
+    return this->mSetup;
+}
+
+int Lockstep::getLocalPlayer() const
+{
+    return this->mLocalPlayer;
+}
+
+int64_t Lockstep::getDesyncTick() const
+{
+    return this->mDesyncTick;
+}
+
+uint32_t Lockstep::getTick() const
+{
+    return this->mTick;
+}
+
+uint64_t Lockstep::getBytesSent() const
+{
+    return this->mBytesSent;
+}
+
+long Lockstep::getStallMillis() const
+{
+    return this->mStallMillis;
+}
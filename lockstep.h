@@ -0,0 +1,70 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+
+#include "protocol.h"
+#include "world.h"
+
+// Two peers running the same World without a server. Only inputs cross
+// the wire: every tick each peer sends what its player pressed for the
+// tick inputDelay ticks ahead, and a tick runs once both inputs are in.
+// The simulation is deterministic from the setup seed, so both boards
+// stay equal. Every hashInterval ticks the peers swap World::stateHash()
+// and a difference is reported as a desync.
+class Lockstep
+{
+public:
+    Lockstep();
+    ~Lockstep();
+
+    // Waits for the other peer and hands it the setup. The host is player 0.
+    bool host(const std::string& address, int port, const LockstepSetup& setup, int timeoutMillis);
+    // Connects to a host and takes its setup. The joining peer is player 1.
+    bool join(const std::string& address, int port, int timeoutMillis);
+
+    const LockstepSetup& getSetup() const;
+    int getLocalPlayer() const;
+
+    // This peer's input (a Direction or -1) for the tick inputDelay ahead
+    void submit(int input);
+    // Blocks until both inputs of the next tick are known, indexed by
+    // player. False when the peer left or stayed silent too long.
+    bool nextInputs(int inputs[2]);
+    // Call after every step, hashes are swapped every hashInterval ticks
+    void checkState(const World& world);
+
+    // First tick whose hashes differed, -1 while in sync
+    int64_t getDesyncTick() const;
+    uint32_t getTick() const;
+    uint64_t getBytesSent() const;
+    // Time spent waiting for the peer's inputs
+    long getStallMillis() const;
+
+private:
+    void start();
+    void send(const std::string& message);
+    // Reads whatever arrives within the timeout, false when the peer is
+    // gone or its stream cannot be framed any more
+    bool pump(int timeoutMillis);
+    void compareHash(uint32_t tick);
+
+    int mSocket;
+    int mLocalPlayer;
+    LockstepSetup mSetup;
+    FrameReader mReader;
+    std::deque<int> mLocalInputs;
+    std::deque<int> mRemoteInputs;
+    // Hashes waiting for the other side's value of the same tick
+    std::map<uint32_t, uint64_t> mLocalHashes;
+    std::map<uint32_t, uint64_t> mRemoteHashes;
+    uint32_t mTick;
+    int64_t mDesyncTick;
+    uint64_t mBytesSent;
+    long mStallMillis;
+};
+
+#endif
@@ -1,7 +1,178 @@
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
 #include "game.h"
+#include "ansi_renderer.h"
+#include "lockstep.h"
+#include "net.h"
+#include "trace.h"
+
+// --ansi (or SNAKE_RENDERER=ansi) draws with raw escape sequences
+// instead of curses, see ansi_renderer.h
+static bool useAnsiRenderer(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i ++)
+    {
+        if (std::strcmp(argv[i], "--ansi") == 0)
+        {
+            return true;
+        }
+    }
+    const char* renderer = std::getenv("SNAKE_RENDERER");
+    return renderer != nullptr && std::strcmp(renderer, "ansi") == 0;
+}
+
+// Value following the given flag, nullptr when it is not there
+static const char* optionValue(int argc, char** argv, const char* name)
+{
+    for (int i = 1; i + 1 < argc; i ++)
+    {
+        if (std::strcmp(argv[i], name) == 0)
+        {
+            return argv[i + 1];
+        }
+    }
+    return nullptr;
+}
+
+static int intOption(int argc, char** argv, const char* name, int fallback)
+{
+    const char* value = optionValue(argc, argv, name);
+    return value != nullptr ? std::atoi(value) : fallback;
+}
+
+// --host-lockstep port waits for a peer, --join-lockstep [host:]port joins
+// one. The host also decides --seed, --map, --snakes, --tick,
+// --input-delay and --hash-every for both.
+static bool connectLockstep(int argc, char** argv, Lockstep& lockstep)
+{
+    const char* hostPort = optionValue(argc, argv, "--host-lockstep");
+    const char* joinAddress = optionValue(argc, argv, "--join-lockstep");
+    std::string host;
+    int port = 0;
+    if (hostPort != nullptr)
+    {
+        // Same board as this terminal would give the local game
+        winsize size;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_col == 0)
+        {
+            size.ws_col = 80;
+            size.ws_row = 24;
+        }
+        LockstepSetup setup;
+        setup.seed = intOption(argc, argv, "--seed", std::time(nullptr));
+        setup.width = size.ws_col - 18;
+        setup.height = size.ws_row - 6;
+        setup.map = intOption(argc, argv, "--map", 0);
+        setup.snakes = intOption(argc, argv, "--snakes", 2);
+        setup.length = 2;
+        setup.tickMillis = intOption(argc, argv, "--tick", 150);
+        setup.inputDelay = intOption(argc, argv, "--input-delay", 3);
+        setup.hashInterval = intOption(argc, argv, "--hash-every", 30);
+        port = std::atoi(hostPort);
+        std::cerr << "waiting for a peer on port " << port << std::endl;
+        return lockstep.host("0.0.0.0", port, setup, 120000);
+    }
+    if (!parseAddress(joinAddress, host, port))
+    {
+        return false;
+    }
+    return lockstep.join(host, port, 5000);
+}
+
+static std::unique_ptr<Game> createGame(int argc, char** argv)
+{
+    std::unique_ptr<Game> game;
+    if (useAnsiRenderer(argc, argv))
+    {
+        game.reset(new Game(std::unique_ptr<Renderer>(new AnsiRenderer())));
+    }
+    else
+    {
+        game.reset(new Game());
+    }
+    // --trace file (or SNAKE_TRACE=file) records a Chrome trace, started
+    // once curses has set up its own signal handling
+    const char* tracePath = optionValue(argc, argv, "--trace");
+    if (tracePath == nullptr)
+    {
+        tracePath = std::getenv("SNAKE_TRACE");
+    }
+    if (tracePath != nullptr)
+    {
+        Tracer::enable(tracePath);
+    }
+    // --telemetry file (or SNAKE_TELEMETRY=file) logs game events
+    const char* telemetryPath = optionValue(argc, argv, "--telemetry");
+    if (telemetryPath == nullptr)
+    {
+        telemetryPath = std::getenv("SNAKE_TELEMETRY");
+    }
+    if (telemetryPath != nullptr && !game->startTelemetry(telemetryPath))
+    {
+        std::cerr << "cannot write telemetry to " << telemetryPath << std::endl;
+    }
+    return game;
+}
 
 int main(int argc, char** argv)
 {
-    Game game;
-    game.startGame();
+    // --connect [host:]port plays on a snake-server instead of locally,
+    // --watch [host:]port only spectates
+    const char* address = optionValue(argc, argv, "--connect");
+    bool spectate = address == nullptr && (address = optionValue(argc, argv, "--watch")) != nullptr;
+    std::string host;
+    int port = 0;
+    if (address != nullptr && !parseAddress(address, host, port))
+    {
+        std::cerr << "bad server address: " << address << std::endl;
+        return 1;
+    }
+
+    if (optionValue(argc, argv, "--host-lockstep") != nullptr || optionValue(argc, argv, "--join-lockstep") != nullptr)
+    {
+        Lockstep lockstep;
+        if (!connectLockstep(argc, argv, lockstep))
+        {
+            std::cerr << "no lockstep peer" << std::endl;
+            return 1;
+        }
+        createGame(argc, argv)->runLockstepMode(lockstep);
+        // The terminal is restored once the game is gone
+        uint32_t ticks = std::max<uint32_t>(1, lockstep.getTick());
+        std::cerr << "lockstep: " << lockstep.getTick() << " ticks, "
+                  << static_cast<double>(lockstep.getBytesSent()) / ticks << " bytes/tick sent, "
+                  << lockstep.getStallMillis() << " ms waiting for the peer" << std::endl;
+        if (lockstep.getDesyncTick() >= 0)
+        {
+            std::cerr << "desync detected at tick " << lockstep.getDesyncTick() << std::endl;
+            return 2;
+        }
+        return 0;
+    }
+
+    bool connected = true;
+    {
+        std::unique_ptr<Game> game = createGame(argc, argv);
+        if (address == nullptr)
+        {
+            game->startGame();
+        }
+        else
+        {
+            connected = game->runOnlineMode(host, port, spectate);
+        }
+    }
+    // The terminal is restored once the game is gone
+    if (!connected)
+    {
+        std::cerr << "cannot reach snake-server at " << host << ":" << port << std::endl;
+        return 1;
+    }
 }
@@ -1,7 +1,10 @@
+#include <fstream>
 #include <set>
 #include <utility>
 
 #include "map.h"
+#include "distance_table.h"
+#include "rng.h"
 
 GameMap::GameMap(std::string name, const std::vector<Obstacle>& obstacles)
     : mName(std::move(name)), mObstacles(obstacles) {}
@@ -14,8 +17,18 @@ const std::vector<Obstacle>& GameMap::getObstacles() const {
     return mObstacles;
 }
 
-std::vector<GameMap> GameMap::getDefaultMaps(int boardX, int boardY) {
+const DistanceTable& GameMap::getDistances(int boardX, int boardY) const {
+    if (!mDistances || mDistances->getWidth() != boardX || mDistances->getHeight() != boardY) {
+        std::shared_ptr<DistanceTable> distances(new DistanceTable());
+        distances->build(boardX, boardY, mObstacles);
+        mDistances = distances;
+    }
+    return *mDistances;
+}
+
+std::vector<GameMap> GameMap::getDefaultMaps(int boardX, int boardY, uint64_t seed) {
     std::vector<GameMap> maps;
+    Rng rng(seed);
 
     // 地图1：空地
     maps.emplace_back("Empty Field", std::vector<Obstacle>{});
@@ -45,8 +58,8 @@ std::vector<GameMap> GameMap::getDefaultMaps(int boardX, int boardY) {
 
     int crossCount = 0;
     while (crossCount < 6) {
-        int cx = rand() % (boardX - 4) + 3; // 保证左右不会越界
-        int cy = rand() % (boardY - 4) + 2;
+        int cx = rng.nextInt(boardX - 4) + 3; // 保证左右不会越界
+        int cy = rng.nextInt(boardY - 4) + 2;
 
         if (isInSpawnArea(cx, cy)) continue;
         if (usedCenters.count({cx, cy})) continue;
@@ -73,3 +86,21 @@ std::vector<GameMap> GameMap::getDefaultMaps(int boardX, int boardY) {
     return maps;
 }
 
+bool GameMap::loadFile(const std::string& path, GameMap& map) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        return false;
+    }
+    std::vector<Obstacle> obstacles;
+    std::string line;
+    for (int y = 0; std::getline(in, line); ++y) {
+        for (int x = 0; x < line.size(); ++x) {
+            if (line[x] == '#') {
+                obstacles.push_back({x, y});
+            }
+        }
+    }
+    size_t slash = path.find_last_of('/');
+    map = GameMap(slash == std::string::npos ? path : path.substr(slash + 1), obstacles);
+    return true;
+}
@@ -1,6 +1,8 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -8,19 +10,31 @@ struct Obstacle {
     int x, y;
 };
 
+class DistanceTable;
+
 class GameMap {
 public:
     GameMap(std::string name, const std::vector<Obstacle>& obstacles);
     GameMap() = default;
     const std::string& getName() const;
     const std::vector<Obstacle>& getObstacles() const;
+    // Distances around the obstacles on a board of this size, see
+    // distance_table.h. Built the first time it is asked for, after that
+    // copies of the map share it. Ask for it on one thread only.
+    const DistanceTable& getDistances(int boardX, int boardY) const;
 
     // 静态方法：提供一些预设地图
-    static std::vector<GameMap> getDefaultMaps(int boardX, int boardY);
+    // Random layouts come from the seed, so every peer builds the same maps
+    static std::vector<GameMap> getDefaultMaps(int boardX, int boardY, uint64_t seed);
+    // A map drawn as text, one line per board row from the top border
+    // down, '#' for an obstacle and anything else for a free cell. It is
+    // named after the file. False when the file cannot be read.
+    static bool loadFile(const std::string& path, GameMap& map);
 
 private:
     std::string mName;
     std::vector<Obstacle> mObstacles;
+    mutable std::shared_ptr<DistanceTable> mDistances;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "mcts.h"
+
+namespace
+{
+    const int kMaxNodes = 1 << 15;
+    // Rollouts after which a search counts as finished
+    const long kTargetRollouts = 20000;
+    // Moves simulated past the tree with the quick policy
+    const int kRolloutDepth = 30;
+    const double kDiscount = 0.95;
+    const double kExploration = 1.0;
+    // Value a thread assumes for a node it is still simulating
+    const double kVirtualLoss = 1.0;
+    // Share of rollout moves that head for the food, the rest are random
+    const int kGreedyPercent = 75;
+    // Rollouts run from one leaf state before its mean is simply reused
+    const int kLeafSamples = 4;
+
+    Direction turnLeft(Direction direction)
+    {
+        switch (direction) {
+            case Direction::Up:    return Direction::Left;
+            case Direction::Left:  return Direction::Down;
+            case Direction::Down:  return Direction::Right;
+            case Direction::Right: return Direction::Up;
+        }
+        return direction;
+    }
+
+    Direction turnRight(Direction direction)
+    {
+        switch (direction) {
+            case Direction::Up:    return Direction::Right;
+            case Direction::Right: return Direction::Down;
+            case Direction::Down:  return Direction::Left;
+            case Direction::Left:  return Direction::Up;
+        }
+        return direction;
+    }
+}
+
+MctsPlanner::MctsPlanner(int threads)
+    : mRoot(nullptr), mToken(nullptr), mRollouts(0), mRolloutsPerSecond(0), mGeneration(0), mPending(0), mStopping(false)
+{
+    if (threads <= 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // Two threads per tree, one tree alone when there is only one thread
+    this->mTrees = std::vector<Tree>((threads + 1) / 2);
+    for (Tree& tree : this->mTrees)
+    {
+        tree.nodes.resize(kMaxNodes);
+        tree.used = 0;
+    }
+    this->mWorkers = std::vector<Worker>(threads);
+    for (int i = 0; i < threads; i ++)
+    {
+        this->mWorkers[i].rng.seed(mixBits(i + 1));
+    }
+    // Worker 0 is whoever calls plan()
+    for (int i = 1; i < threads; i ++)
+    {
+        this->mWorkers[i].thread = std::thread(&MctsPlanner::work, this, i);
+    }
+}
+
+MctsPlanner::~MctsPlanner()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mStopping = true;
+    }
+    this->mStart.notify_all();
+    for (Worker& worker : this->mWorkers)
+    {
+        if (worker.thread.joinable())
+        {
+            worker.thread.join();
+        }
+    }
+}
+
+Direction MctsPlanner::search(const ClassicState& root, const CancelToken& token, bool& truncated)
+{
+    auto start = std::chrono::steady_clock::now();
+    this->mRoot = &root;
+    this->mToken = &token;
+    this->mRollouts = 0;
+    this->mTable.age();
+    for (Tree& tree : this->mTrees)
+    {
+        tree.nodes[0] = Node{-1, {-1, -1, -1}, root.getDirection(), 0, 0, 0.0, false};
+        tree.used = 1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mPending = this->mWorkers.size() - 1;
+        this->mGeneration ++;
+    }
+    this->mStart.notify_all();
+    this->searchTree(0);
+    {
+        std::unique_lock<std::mutex> lock(this->mMutex);
+        this->mFinished.wait(lock, [this] { return this->mPending == 0; });
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (seconds > 0)
+    {
+        double rate = this->mRollouts / seconds;
+        this->mRolloutsPerSecond = this->mRolloutsPerSecond == 0 ? rate : 0.8 * this->mRolloutsPerSecond + 0.2 * rate;
+    }
+    truncated = this->mRollouts < kTargetRollouts;
+
+    // Children are forward, left, right in every tree
+    int visits[3] = {0, 0, 0};
+    for (const Tree& tree : this->mTrees)
+    {
+        for (int i = 0; i < 3 && tree.nodes[0].expanded; i ++)
+        {
+            visits[i] += tree.nodes[tree.nodes[0].children[i]].visits;
+        }
+    }
+    Direction moves[3] = {root.getDirection(), turnLeft(root.getDirection()), turnRight(root.getDirection())};
+    int best = std::max_element(visits, visits + 3) - visits;
+    if (visits[best] == 0)
+    {
+        // No time for a single rollout, fall back to the quick policy
+        return choosePolicyMove(root, this->mWorkers[0].rng, true);
+    }
+    return moves[best];
+}
+
+void MctsPlanner::work(int index)
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->mMutex);
+            this->mStart.wait(lock, [&] { return this->mStopping || this->mGeneration != seen; });
+            if (this->mStopping)
+            {
+                return;
+            }
+            seen = this->mGeneration;
+        }
+        this->searchTree(index);
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        if (-- this->mPending == 0)
+        {
+            this->mFinished.notify_one();
+        }
+    }
+}
+
+void MctsPlanner::searchTree(int index)
+{
+    Tree& tree = this->mTrees[index / 2];
+    Worker& worker = this->mWorkers[index];
+    while (!this->mToken->isCancelled() && this->mRollouts.load(std::memory_order_relaxed) < kTargetRollouts)
+    {
+        this->iterate(tree, worker);
+        this->mRollouts.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void MctsPlanner::iterate(Tree& tree, Worker& worker)
+{
+    ClassicState& state = worker.scratch;
+    state.copyFrom(*this->mRoot);
+    double value = 0;
+    double discount = 1;
+
+    // Walk down under the tree's lock, the state follows along
+    std::unique_lock<std::mutex> lock(tree.mutex);
+    int node = 0;
+    while (true)
+    {
+        Node& current = tree.nodes[node];
+        if (!current.expanded)
+        {
+            if ((current.visits == 0 && node != 0) || tree.used + 3 > kMaxNodes)
+            {
+                break;
+            }
+            this->expand(tree, node, state.getDirection());
+        }
+        int child = this->select(tree, node);
+        tree.nodes[child].virtualLoss ++;
+        node = child;
+        value += discount * state.step(tree.nodes[child].move, worker.rng);
+        discount *= kDiscount;
+        if (!state.isAlive())
+        {
+            break;
+        }
+    }
+    lock.unlock();
+
+    if (state.isAlive())
+    {
+        value += discount * this->evaluate(state, worker.rng);
+    }
+
+    lock.lock();
+    for (int i = node; i >= 0; i = tree.nodes[i].parent)
+    {
+        Node& visited = tree.nodes[i];
+        visited.visits ++;
+        visited.value += value;
+        if (i != 0)
+        {
+            visited.virtualLoss --;
+        }
+    }
+}
+
+void MctsPlanner::expand(Tree& tree, int node, Direction direction)
+{
+    Direction moves[3] = {direction, turnLeft(direction), turnRight(direction)};
+    for (int i = 0; i < 3; i ++)
+    {
+        int child = tree.used ++;
+        tree.nodes[child] = Node{node, {-1, -1, -1}, moves[i], 0, 0, 0.0, false};
+        tree.nodes[node].children[i] = child;
+    }
+    tree.nodes[node].expanded = true;
+}
+
+int MctsPlanner::select(Tree& tree, int node) const
+{
+    const Node& parent = tree.nodes[node];
+    int total = 0;
+    for (int child : parent.children)
+    {
+        const Node& candidate = tree.nodes[child];
+        // Untried moves first, including ones another thread just took
+        if (candidate.visits + candidate.virtualLoss == 0)
+        {
+            return child;
+        }
+        total += candidate.visits + candidate.virtualLoss;
+    }
+    int best = parent.children[0];
+    double bestScore = -1e300;
+    for (int child : parent.children)
+    {
+        const Node& candidate = tree.nodes[child];
+        double n = candidate.visits + candidate.virtualLoss;
+        double score = (candidate.value - kVirtualLoss * candidate.virtualLoss) / n
+                       + kExploration * std::sqrt(std::log(static_cast<double>(total)) / n);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            best = child;
+        }
+    }
+    return best;
+}
+
+double MctsPlanner::rollout(ClassicState& state, Rng& rng, int depth) const
+{
+    double value = 0;
+    double discount = 1;
+    for (int i = 0; i < depth && state.isAlive(); i ++)
+    {
+        Direction move = choosePolicyMove(state, rng, rng.nextInt(100) < kGreedyPercent);
+        value += discount * state.step(move, rng);
+        discount *= kDiscount;
+    }
+    return value;
+}
+
+double MctsPlanner::evaluate(ClassicState& state, Rng& rng)
+{
+    uint64_t hash = state.getHash();
+    TranspositionTable::Entry entry;
+    bool known = this->mTable.probe(hash, entry);
+    if (known && entry.depth >= kLeafSamples)
+    {
+        return entry.value;
+    }
+    Direction direction = state.getDirection();
+    double value = this->rollout(state, rng, kRolloutDepth);
+    int samples = 1;
+    if (known)
+    {
+        // Two threads adding a sample at once keep one of them, which
+        // only costs that sample
+        value = (entry.value * entry.depth + value) / (entry.depth + 1);
+        samples = entry.depth + 1;
+    }
+    this->mTable.store(hash, samples, value, direction);
+    return value;
+}
+
+Direction MctsPlanner::choosePolicyMove(const ClassicState& state, Rng& rng, bool greedy)
+{
+    Direction forward = state.getDirection();
+    Direction moves[3] = {forward, turnLeft(forward), turnRight(forward)};
+    Direction safe[3];
+    int count = 0;
+    Direction best = forward;
+    int bestDistance = -1;
+    for (Direction move : moves)
+    {
+        int cell = state.nextCell(move);
+        if (!state.isFree(cell))
+        {
+            continue;
+        }
+        safe[count ++] = move;
+        int distance = state.foodDistance(cell);
+        if (bestDistance < 0 || (distance >= 0 && distance < bestDistance))
+        {
+            bestDistance = distance;
+            best = move;
+        }
+    }
+    if (count == 0)
+    {
+        return forward;
+    }
+    return greedy ? best : safe[rng.nextInt(count)];
+}
+
+double MctsPlanner::getRolloutsPerSecond() const
+{
+    return this->mRolloutsPerSecond;
+}
+
+int MctsPlanner::getThreads() const
+{
+    return this->mWorkers.size();
+}
+
+const TranspositionTable& MctsPlanner::getTable() const
+{
+    return this->mTable;
+}
+
+const char* MctsPlanner::getName() const
+{
+    return "MCTS";
+}
+
+std::string MctsPlanner::describe() const
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.1fk r/s", this->mRolloutsPerSecond / 1000);
+    return text;
+}
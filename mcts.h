@@ -0,0 +1,105 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "anytime.h"
+#include "classic_state.h"
+#include "rng.h"
+#include "transposition.h"
+
+// Monte Carlo tree search autopilot for the classic game.
+//
+// Searches run on a pool of threads until the token is cancelled or the
+// trees hold enough rollouts that more would rarely change the move.
+// Threads are paired up on trees (root parallelism across trees). Threads
+// sharing a tree add a virtual loss to the nodes they pass through, so
+// their partner picks another line while the first rollout is still
+// running. The tree is open loop: nodes are moves, and where food
+// reappears is drawn anew in every simulation. When time is up the root
+// moves' visits are added across trees and the most visited move wins.
+//
+// All threads share one transposition table of leaf values. A state that
+// trees or threads reach again takes the mean of the rollouts already
+// run from it, and only the first few visits run one of their own. The
+// entry's depth holds how many rollouts the mean is over.
+class MctsPlanner : public AnytimePlanner
+{
+public:
+    // 0 threads means one per core
+    explicit MctsPlanner(int threads = 0);
+    ~MctsPlanner();
+
+    const char* getName() const;
+    std::string describe() const;
+
+    // Rollouts per second over recent plans
+    double getRolloutsPerSecond() const;
+    int getThreads() const;
+    const TranspositionTable& getTable() const;
+
+protected:
+    // Returns once cancelled, give or take one rollout
+    Direction search(const ClassicState& root, const CancelToken& token, bool& truncated);
+
+private:
+    struct Node
+    {
+        int parent;
+        int children[3];
+        Direction move;
+        int visits;
+        int virtualLoss;
+        double value;
+        bool expanded;
+    };
+
+    struct Tree
+    {
+        std::mutex mutex;
+        std::vector<Node> nodes;
+        int used;
+    };
+
+    struct Worker
+    {
+        std::thread thread;
+        Rng rng;
+        ClassicState scratch;
+    };
+
+    void work(int index);
+    void searchTree(int index);
+    // One selection, expansion, rollout and backup
+    void iterate(Tree& tree, Worker& worker);
+    int select(Tree& tree, int node) const;
+    void expand(Tree& tree, int node, Direction direction);
+    double rollout(ClassicState& state, Rng& rng, int depth) const;
+    // Value of a leaf, from the table or from one more rollout
+    double evaluate(ClassicState& state, Rng& rng);
+    static Direction choosePolicyMove(const ClassicState& state, Rng& rng, bool greedy);
+
+    std::vector<Tree> mTrees;
+    std::vector<Worker> mWorkers;
+    TranspositionTable mTable;
+    const ClassicState* mRoot;
+    const CancelToken* mToken;
+    std::atomic<long> mRollouts;
+    double mRolloutsPerSecond;
+
+    std::mutex mMutex;
+    std::condition_variable mStart;
+    std::condition_variable mFinished;
+    uint64_t mGeneration;
+    int mPending;
+    bool mStopping;
+};
+
+#endif
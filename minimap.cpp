@@ -0,0 +1,83 @@
+#include <algorithm>
+
+#include "minimap.h"
+
+Minimap::Minimap() : mWidth(0), mHeight(0), mBlockWidth(1), mBlockHeight(1)
+{
+}
+
+void Minimap::reset(const World& world, int width, int height)
+{
+    this->mWidth = std::max(1, width);
+    this->mHeight = std::max(1, height);
+    // Round up so the last column and row still cover the board's edge
+    this->mBlockWidth = std::max(1, (world.getWidth() + this->mWidth - 1) / this->mWidth);
+    this->mBlockHeight = std::max(1, (world.getHeight() + this->mHeight - 1) / this->mHeight);
+    this->mHeads.assign(this->mWidth * this->mHeight, 0);
+    this->mWalls.assign(this->mWidth * this->mHeight, 0);
+    this->mSnakeBlocks.clear();
+    for (const Obstacle& obs : world.getObstacles())
+    {
+        this->mWalls[this->blockOf(SnakeBody(obs.x, obs.y))] = 1;
+    }
+    this->update(world);
+}
+
+void Minimap::update(const World& world)
+{
+    const std::vector<WorldSnake>& snakes = world.getSnakes();
+    this->mSnakeBlocks.resize(snakes.size(), -1);
+    for (int i = 0; i < snakes.size(); i ++)
+    {
+        int block = snakes[i].alive ? this->blockOf(snakes[i].body.front()) : -1;
+        int& counted = this->mSnakeBlocks[i];
+        if (block == counted)
+        {
+            continue;
+        }
+        if (counted >= 0)
+        {
+            this->mHeads[counted] --;
+        }
+        if (block >= 0)
+        {
+            this->mHeads[block] ++;
+        }
+        counted = block;
+    }
+}
+
+int Minimap::getWidth() const
+{
+    return this->mWidth;
+}
+
+int Minimap::getHeight() const
+{
+    return this->mHeight;
+}
+
+char Minimap::getCell(int x, int y) const
+{
+    int heads = this->mHeads[y * this->mWidth + x];
+    if (heads == 0)
+    {
+        return this->mWalls[y * this->mWidth + x] ? '%' : ' ';
+    }
+    return heads == 1 ? '.' : heads < 4 ? 'o' : 'O';
+}
+
+int Minimap::toMinimapX(int boardX) const
+{
+    return std::min(this->mWidth - 1, boardX / this->mBlockWidth);
+}
+
+int Minimap::toMinimapY(int boardY) const
+{
+    return std::min(this->mHeight - 1, boardY / this->mBlockHeight);
+}
+
+int Minimap::blockOf(const SnakeBody& cell) const
+{
+    return this->toMinimapY(cell.getY()) * this->mWidth + this->toMinimapX(cell.getX());
+}
@@ -0,0 +1,46 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <vector>
+
+#include "world.h"
+
+// Downsampled overview of a World for the instruction panel. Every
+// minimap cell stands for a block of board cells and counts the snake
+// heads inside it.
+//
+// The counts are kept up to date incrementally: each update() only moves
+// snakes whose head crossed into another block, so it costs one check
+// per snake however large the board is. Obstacles never move and are
+// sampled once in reset().
+class Minimap
+{
+public:
+    Minimap();
+
+    void reset(const World& world, int width, int height);
+    void update(const World& world);
+
+    int getWidth() const;
+    int getHeight() const;
+    // ' ' for nothing, '%' for walls, then '.', 'o' and 'O' as more heads
+    // share the block
+    char getCell(int x, int y) const;
+    // Minimap cell holding the given board cell
+    int toMinimapX(int boardX) const;
+    int toMinimapY(int boardY) const;
+
+private:
+    int blockOf(const SnakeBody& cell) const;
+
+    int mWidth;
+    int mHeight;
+    int mBlockWidth;
+    int mBlockHeight;
+    std::vector<int> mHeads;
+    std::vector<char> mWalls;
+    // Block each snake's head was counted in, -1 while it is dead
+    std::vector<int> mSnakeBlocks;
+};
+
+#endif
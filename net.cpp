@@ -0,0 +1,142 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "net.h"
+
+namespace
+{
+    addrinfo* resolve(const std::string& host, int port, bool passive)
+    {
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+        addrinfo* result = nullptr;
+        std::string service = std::to_string(port);
+        if (getaddrinfo(host.c_str(), service.c_str(), &hints, &result) != 0)
+        {
+            return nullptr;
+        }
+        return result;
+    }
+}
+
+int listenTcp(const std::string& host, int port)
+{
+    addrinfo* addresses = resolve(host, port, true);
+    int fd = -1;
+    for (addrinfo* a = addresses; a != nullptr && fd < 0; a = a->ai_next)
+    {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, a->ai_addr, a->ai_addrlen) != 0 || listen(fd, SOMAXCONN) != 0
+            || !setNonBlocking(fd))
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (addresses != nullptr)
+    {
+        freeaddrinfo(addresses);
+    }
+    return fd;
+}
+
+int connectTcp(const std::string& host, int port)
+{
+    addrinfo* addresses = resolve(host, port, false);
+    int fd = -1;
+    for (addrinfo* a = addresses; a != nullptr && fd < 0; a = a->ai_next)
+    {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        if (connect(fd, a->ai_addr, a->ai_addrlen) != 0)
+        {
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        setNoDelay(fd);
+    }
+    if (addresses != nullptr)
+    {
+        freeaddrinfo(addresses);
+    }
+    return fd;
+}
+
+int startConnectTcp(const std::string& host, int port)
+{
+    addrinfo* addresses = resolve(host, port, false);
+    int fd = -1;
+    for (addrinfo* a = addresses; a != nullptr && fd < 0; a = a->ai_next)
+    {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        if (!setNonBlocking(fd)
+            || (connect(fd, a->ai_addr, a->ai_addrlen) != 0 && errno != EINPROGRESS))
+        {
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        setNoDelay(fd);
+    }
+    if (addresses != nullptr)
+    {
+        freeaddrinfo(addresses);
+    }
+    return fd;
+}
+
+bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0)
+    {
+        return false;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+void setNoDelay(int fd)
+{
+    // Ticks are tiny messages, waiting to batch them only adds latency
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+bool parseAddress(const std::string& address, std::string& host, int& port)
+{
+    size_t colon = address.rfind(':');
+    std::string portText = colon == std::string::npos ? address : address.substr(colon + 1);
+    host = colon == std::string::npos || colon == 0 ? "127.0.0.1" : address.substr(0, colon);
+    char* end = nullptr;
+    long value = std::strtol(portText.c_str(), &end, 10);
+    if (portText.empty() || *end != '\0' || value <= 0 || value > 65535)
+    {
+        return false;
+    }
+    port = value;
+    return true;
+}
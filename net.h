@@ -0,0 +1,20 @@
+#ifndef NET_H
+#define NET_H
+
+#include <string>
+
+// Thin wrappers over BSD sockets, all return -1 on failure
+
+// Listening TCP socket bound to the given address, non-blocking
+int listenTcp(const std::string& host, int port);
+// Connected TCP socket with Nagle disabled, blocking
+int connectTcp(const std::string& host, int port);
+// Non-blocking socket with Nagle disabled whose connect may still be in
+// progress, it turns writable once done (check SO_ERROR then)
+int startConnectTcp(const std::string& host, int port);
+bool setNonBlocking(int fd);
+void setNoDelay(int fd);
+// Splits "host:port", a bare port means localhost
+bool parseAddress(const std::string& address, std::string& host, int& port);
+
+#endif
@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <cmath>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "net_client.h"
+#include "net.h"
+#include "bot.h"
+
+namespace
+{
+    const int kMaxLead = 8;
+    const int kPingMillis = 500;
+}
+
+NetClient::NetClient()
+    : mSocket(-1), mSnakeId(-1), mTickMillis(100), mLead(1), mRoundTripMillis(0),
+      mStart(std::chrono::steady_clock::now()), mBytesReceived(0), mTicksReceived(0), mRollbacks(0)
+{
+}
+
+NetClient::~NetClient()
+{
+    if (this->mSocket >= 0)
+    {
+        close(this->mSocket);
+    }
+}
+
+bool NetClient::connect(const std::string& host, int port, int timeoutMillis, bool spectate)
+{
+    this->mSocket = connectTcp(host, port);
+    if (this->mSocket < 0)
+    {
+        return false;
+    }
+    this->send(spectate ? encodeWatch() : encodeHello());
+
+    // The welcome builds the replica, the keyframe fills it
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+    std::string payload;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        while (this->mReader.next(payload))
+        {
+            if (messageType(payload) == MessageType::WELCOME)
+            {
+                Welcome welcome;
+                if (!decodeWelcome(payload, welcome))
+                {
+                    return false;
+                }
+                this->mSnakeId = welcome.snakeId;
+                this->mTickMillis = std::max(1, welcome.tickMillis);
+                this->mWorld.reset(new World(welcome.width, welcome.height, welcome.obstacles, 0));
+            }
+            else if (this->mWorld && messageType(payload) == MessageType::KEYFRAME)
+            {
+                if (!decodeKeyframe(payload, *this->mWorld))
+                {
+                    return false;
+                }
+                if (this->mSnakeId >= 0)
+                {
+                    this->mPredicted.reset(new World(*this->mWorld));
+                }
+                return true;
+            }
+        }
+        if (this->mReader.isBroken())
+        {
+            return false;
+        }
+        pollfd fd = {this->mSocket, POLLIN, 0};
+        if (::poll(&fd, 1, 10) > 0 && !this->receive())
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+void NetClient::send(const std::string& message)
+{
+    ::send(this->mSocket, message.data(), message.size(), MSG_NOSIGNAL);
+}
+
+void NetClient::sendInput(Direction direction)
+{
+    if (this->mSnakeId < 0)
+    {
+        return;
+    }
+    // One turn per tick, like a snake moving one cell per tick
+    if (this->mInputs.count(this->mPredicted->getTick() + 1) > 0)
+    {
+        this->mDeferred.push_back(direction);
+        return;
+    }
+    this->applyInput(direction);
+}
+
+bool NetClient::applyInput(Direction direction)
+{
+    // A turn the prediction refuses would be refused by the server too
+    if (!this->mPredicted->turn(this->mSnakeId, direction))
+    {
+        return false;
+    }
+    uint32_t tick = this->mPredicted->getTick() + 1;
+    this->mInputs[tick] = direction;
+    this->send(encodeInput(direction, tick));
+    return true;
+}
+
+int NetClient::poll(int timeoutMillis)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (this->mSnakeId >= 0 && now - this->mLastPing > std::chrono::milliseconds(kPingMillis))
+    {
+        uint32_t stamp = std::chrono::duration_cast<std::chrono::milliseconds>(now - this->mStart).count();
+        this->send(encodePing(MessageType::PING, stamp));
+        this->mLastPing = now;
+    }
+
+    pollfd fd = {this->mSocket, POLLIN, 0};
+    if (::poll(&fd, 1, timeoutMillis) > 0 && !this->receive())
+    {
+        return -1;
+    }
+    int ticks = 0;
+    std::string payload;
+    while (this->mReader.next(payload))
+    {
+        int handled = this->handle(payload);
+        if (handled < 0)
+        {
+            return -1;
+        }
+        ticks += handled;
+    }
+    if (this->mReader.isBroken())
+    {
+        return -1;
+    }
+    if (ticks > 0 && this->mPredicted)
+    {
+        this->reconcile();
+    }
+    return ticks;
+}
+
+bool NetClient::receive()
+{
+    char buffer[4096];
+    ssize_t n = recv(this->mSocket, buffer, sizeof(buffer), 0);
+    if (n <= 0)
+    {
+        return false;
+    }
+    this->mBytesReceived += n;
+    this->mReader.feed(buffer, n);
+    return true;
+}
+
+int NetClient::handle(const std::string& payload)
+{
+    switch (messageType(payload))
+    {
+        case MessageType::DELTA:
+        {
+            uint32_t tick;
+            if (!decodeDelta(payload, *this->mWorld, tick, this->mEvents))
+            {
+                return -1;
+            }
+            for (const WorldEvent& event : this->mEvents)
+            {
+                this->mWorld->apply(event);
+            }
+            this->mWorld->setTick(tick);
+            this->mTicksReceived ++;
+            return 1;
+        }
+        case MessageType::KEYFRAME:
+            return decodeKeyframe(payload, *this->mWorld) ? 1 : -1;
+        case MessageType::PONG:
+        {
+            uint32_t stamp;
+            if (decodePing(payload, stamp))
+            {
+                auto now = std::chrono::steady_clock::now();
+                double sample = std::chrono::duration_cast<std::chrono::milliseconds>(now - this->mStart).count() - stamp;
+                this->mRoundTripMillis = this->mRoundTripMillis == 0 ? sample : 0.8 * this->mRoundTripMillis + 0.2 * sample;
+                // Inputs must reach the server before their tick, plus one
+                // tick of slack for the server's own schedule
+                int lead = static_cast<int>(std::ceil(this->mRoundTripMillis / this->mTickMillis)) + 1;
+                this->mLead = std::min(kMaxLead, std::max(1, lead));
+            }
+            return 0;
+        }
+        default:
+            return 0;
+    }
+}
+
+void NetClient::reconcile()
+{
+    uint32_t tick = this->mWorld->getTick();
+    this->mInputs.erase(this->mInputs.begin(), this->mInputs.upper_bound(tick));
+
+    // Food is not predicted, only snakes can be mispredicted
+    auto predicted = this->mPredictedHashes.find(tick);
+    bool matches = predicted != this->mPredictedHashes.end()
+                   && predicted->second == this->mWorld->snakeHash();
+    if (predicted != this->mPredictedHashes.end() && !matches)
+    {
+        this->mRollbacks ++;
+    }
+    this->mPredictedHashes.erase(this->mPredictedHashes.begin(), this->mPredictedHashes.upper_bound(tick));
+
+    uint32_t target = tick + this->mLead;
+    if (!matches || this->mPredicted->getTick() > target)
+    {
+        // Start over from the server's state, replaying our own turns
+        *this->mPredicted = *this->mWorld;
+        this->mPredictedHashes.clear();
+    }
+    else
+    {
+        // Bots steer by the food, so they chase what the server has
+        this->mPredicted->copyFood(*this->mWorld);
+    }
+    while (this->mPredicted->getTick() < target)
+    {
+        this->predictStep();
+    }
+}
+
+void NetClient::predictStep()
+{
+    World& world = *this->mPredicted;
+    auto input = this->mInputs.find(world.getTick() + 1);
+    if (input != this->mInputs.end())
+    {
+        world.turn(this->mSnakeId, input->second);
+    }
+    // Bots run the same code on the server, other players keep going
+    const std::vector<WorldSnake>& snakes = world.getSnakes();
+    for (int i = 0; i < snakes.size(); i ++)
+    {
+        if (snakes[i].alive && !snakes[i].human)
+        {
+            world.turn(i, chooseGreedyMove(world, i));
+        }
+    }
+    world.step();
+    this->mPredictedHashes[world.getTick()] = world.snakeHash();
+
+    if (!this->mDeferred.empty())
+    {
+        Direction direction = this->mDeferred.front();
+        this->mDeferred.pop_front();
+        this->applyInput(direction);
+    }
+}
+
+const World& NetClient::getWorld() const
+{
+    return this->mPredicted ? *this->mPredicted : *this->mWorld;
+}
+
+const World& NetClient::getAuthoritativeWorld() const
+{
+    return *this->mWorld;
+}
+
+int NetClient::getSnakeId() const
+{
+    return this->mSnakeId;
+}
+
+uint64_t NetClient::getBytesReceived() const
+{
+    return this->mBytesReceived;
+}
+
+uint64_t NetClient::getTicksReceived() const
+{
+    return this->mTicksReceived;
+}
+
+uint64_t NetClient::getRollbacks() const
+{
+    return this->mRollbacks;
+}
+
+int NetClient::getLead() const
+{
+    return this->mLead;
+}
+
+double NetClient::getRoundTripMillis() const
+{
+    return this->mRoundTripMillis;
+}
@@ -0,0 +1,87 @@
+#ifndef NET_CLIENT_H
+#define NET_CLIENT_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "protocol.h"
+#include "world.h"
+
+// Client side of snake-server. Keeps a replica World that only changes
+// through the deltas the server sends.
+//
+// Players also keep a predicted copy running a few ticks ahead of the
+// replica, far enough that inputs reach the server before the tick they
+// are meant for. Keys turn the predicted snake at once, so steering
+// does not wait for a round trip. Whenever the snakes of an
+// authoritative tick do not match what was predicted for it, the
+// prediction is rebuilt from the replica and the inputs still in flight
+// are replayed. Food is never predicted: the prediction spawns none and
+// takes the replica's after every tick.
+class NetClient
+{
+public:
+    NetClient();
+    ~NetClient();
+
+    // Connects, says hello and waits for the welcome and first keyframe.
+    // Spectators watch without a snake of their own.
+    bool connect(const std::string& host, int port, int timeoutMillis, bool spectate);
+    void sendInput(Direction direction);
+    // Applies whatever arrives within the timeout. Returns how many ticks
+    // were applied, -1 once the server is gone.
+    int poll(int timeoutMillis);
+
+    // What to draw: the prediction for players, the replica otherwise
+    const World& getWorld() const;
+    const World& getAuthoritativeWorld() const;
+    // -1 for spectators
+    int getSnakeId() const;
+    uint64_t getBytesReceived() const;
+    uint64_t getTicksReceived() const;
+    uint64_t getRollbacks() const;
+    // Ticks the prediction runs ahead of the replica
+    int getLead() const;
+    double getRoundTripMillis() const;
+
+private:
+    // False when the connection closed
+    bool receive();
+    // Returns 1 for a tick, 0 for anything else, -1 for garbage
+    int handle(const std::string& payload);
+    void send(const std::string& message);
+
+    // Turns the predicted snake and tells the server which tick it is for
+    bool applyInput(Direction direction);
+    // Checks the prediction against the replica's newest tick, then runs
+    // it forward to lead ticks ahead
+    void reconcile();
+    void predictStep();
+
+    int mSocket;
+    FrameReader mReader;
+    std::unique_ptr<World> mWorld;
+    std::unique_ptr<World> mPredicted;
+    int mSnakeId;
+    int mTickMillis;
+    std::vector<WorldEvent> mEvents;
+    // Our own turns by the tick they take effect, until the server has them
+    std::map<uint32_t, Direction> mInputs;
+    // Second key within one tick, sent for the tick after
+    std::deque<Direction> mDeferred;
+    std::map<uint32_t, uint64_t> mPredictedHashes;
+    int mLead;
+    double mRoundTripMillis;
+    std::chrono::steady_clock::time_point mStart;
+    std::chrono::steady_clock::time_point mLastPing;
+    uint64_t mBytesReceived;
+    uint64_t mTicksReceived;
+    uint64_t mRollbacks;
+};
+
+#endif
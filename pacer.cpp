@@ -0,0 +1,74 @@
+#include <algorithm>
+
+#include "pacer.h"
+
+namespace
+{
+    // Draw at least every 8th tick however slow the terminal is
+    const int kMaxInterval = 8;
+    // Smooth frames needed before the frame rate goes back up
+    const int kRecoverFrames = 4;
+    // A present() taking more than this share of a tick counts as a stall
+    const int kStallDivisor = 4;
+}
+
+FramePacer::FramePacer()
+{
+    this->reset();
+}
+
+void FramePacer::reset()
+{
+    this->mInterval = 1;
+    this->mCountdown = 0;
+    this->mHealthyFrames = 0;
+    this->mDropped = 0;
+    this->mLastWouldBlock = -1;
+    this->mLastCoalesced = -1;
+}
+
+bool FramePacer::beginTick()
+{
+    if (-- this->mCountdown > 0)
+    {
+        this->mDropped ++;
+        return false;
+    }
+    this->mCountdown = this->mInterval;
+    return true;
+}
+
+void FramePacer::endFrame(const RenderStats& stats, int tickMillis)
+{
+    // The first frame after a reset only records where the counters are
+    bool first = this->mLastWouldBlock < 0;
+    long refused = first ? 0 : stats.wouldBlock - this->mLastWouldBlock;
+    long coalesced = first ? 0 : stats.coalesced - this->mLastCoalesced;
+    this->mLastWouldBlock = stats.wouldBlock;
+    this->mLastCoalesced = stats.coalesced;
+    // Frames the backend swallowed never reached the screen either
+    this->mDropped += coalesced;
+
+    bool stalled = stats.stallMicros * kStallDivisor > tickMillis * 1000L;
+    if (stalled || refused > 0 || coalesced > 0)
+    {
+        this->mInterval = std::min(this->mInterval * 2, kMaxInterval);
+        this->mCountdown = this->mInterval;
+        this->mHealthyFrames = 0;
+    }
+    else if (this->mInterval > 1 && ++ this->mHealthyFrames >= kRecoverFrames)
+    {
+        this->mInterval /= 2;
+        this->mHealthyFrames = 0;
+    }
+}
+
+long FramePacer::getDroppedFrames() const
+{
+    return this->mDropped;
+}
+
+int FramePacer::getFrameInterval() const
+{
+    return this->mInterval;
+}
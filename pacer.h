@@ -0,0 +1,33 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include "renderer.h"
+
+// Decides which simulation ticks get a full frame. While the terminal
+// keeps up every tick is drawn. When presenting stalls or the backend
+// reports refused/coalesced output, full frames are spread further
+// apart and the ticks in between only draw the head and the food.
+class FramePacer
+{
+public:
+    FramePacer();
+    void reset();
+
+    // Called once per tick, true when this tick should draw a full frame
+    bool beginTick();
+    // Called after a full frame was presented
+    void endFrame(const RenderStats& stats, int tickMillis);
+
+    long getDroppedFrames() const;
+    int getFrameInterval() const;
+
+private:
+    int mInterval;
+    int mCountdown;
+    int mHealthyFrames;
+    long mDropped;
+    long mLastWouldBlock;
+    long mLastCoalesced;
+};
+
+#endif
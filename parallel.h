@@ -0,0 +1,35 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Runs job(i) for every i in [0, count) on up to threads threads, the
+// caller's included. Jobs are handed out one at a time, so games of
+// different lengths even out. Which thread runs a job is left to chance,
+// so jobs should only write to their own slot of the results.
+template <typename Job>
+void runParallel(int count, int threads, const Job& job)
+{
+    std::atomic<int> next(0);
+    auto work = [&]() {
+        for (int i = next ++; i < count; i = next ++)
+        {
+            job(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < std::min(threads, count); i ++)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cstring>
+
+#include "profiler.h"
+
+namespace
+{
+    const int kWindowMillis = 1000;
+}
+
+TickProfiler::TickProfiler()
+{
+    this->reset();
+}
+
+void TickProfiler::reset()
+{
+    std::memset(this->mPublished, 0, sizeof(this->mPublished));
+    this->mTicksPerSecond = 0;
+    this->restart();
+}
+
+void TickProfiler::restart()
+{
+    std::memset(this->mCounts, 0, sizeof(this->mCounts));
+    this->mTicks = 0;
+    this->mWindowStart = std::chrono::steady_clock::now();
+}
+
+void TickProfiler::record(Phase phase, std::chrono::steady_clock::duration elapsed)
+{
+    long micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    this->mCounts[phase][bucketOf(micros)] ++;
+}
+
+void TickProfiler::endTick()
+{
+    this->mTicks ++;
+    auto now = std::chrono::steady_clock::now();
+    auto window = now - this->mWindowStart;
+    if (window < std::chrono::milliseconds(kWindowMillis))
+    {
+        return;
+    }
+    std::memcpy(this->mPublished, this->mCounts, sizeof(this->mCounts));
+    this->mTicksPerSecond = this->mTicks / std::chrono::duration<double>(window).count();
+    this->restart();
+}
+
+long TickProfiler::getPercentile(Phase phase, int percent) const
+{
+    const uint32_t* counts = this->mPublished[phase];
+    long total = 0;
+    for (int i = 0; i < kBuckets; i ++)
+    {
+        total += counts[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+    // Rank of the sample that has the given share of samples at or below it
+    long rank = std::max(1L, (total * percent + 99) / 100);
+    long seen = 0;
+    for (int i = 0; i < kBuckets; i ++)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            return bucketLimit(i);
+        }
+    }
+    return bucketLimit(kBuckets - 1);
+}
+
+double TickProfiler::getTicksPerSecond() const
+{
+    return this->mTicksPerSecond;
+}
+
+const char* TickProfiler::getPhaseName(Phase phase)
+{
+    static const char* names[PHASES] = {"input", "coll", "food", "draw", "refr", "sleep"};
+    return names[phase];
+}
+
+int TickProfiler::bucketOf(long micros)
+{
+    if (micros < 4)
+    {
+        return std::max(0L, micros);
+    }
+    // The top bit picks the power of two, the two bits below it the
+    // quarter within it
+    int top = 63 - __builtin_clzl(micros);
+    int bucket = (top - 1) * 4 + ((micros >> (top - 2)) & 3);
+    return std::min(bucket, kBuckets - 1);
+}
+
+long TickProfiler::bucketLimit(int bucket)
+{
+    if (bucket < 4)
+    {
+        return bucket;
+    }
+    int top = bucket / 4 + 1;
+    long low = static_cast<long>(4 + bucket % 4) << (top - 2);
+    return low + (1L << (top - 2)) - 1;
+}
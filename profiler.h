@@ -0,0 +1,44 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+
+// Where the time of a classic game tick goes. Every phase fills a fixed
+// histogram with log-linear buckets (four per power of two, so any
+// reading is within a quarter of the real value). Once a second the
+// histograms are published and start over, the HUD shows the last
+// published second.
+class TickProfiler
+{
+public:
+    enum Phase { INPUT, COLLISION, FOOD, RENDER, PRESENT, SLEEP, PHASES };
+
+    TickProfiler();
+    // Forgets everything, published seconds included
+    void reset();
+    // Starts a new second without publishing the current one, for when
+    // the game was paused
+    void restart();
+
+    void record(Phase phase, std::chrono::steady_clock::duration elapsed);
+    void endTick();
+
+    // Microseconds, 0 before the first second was published
+    long getPercentile(Phase phase, int percent) const;
+    double getTicksPerSecond() const;
+    static const char* getPhaseName(Phase phase);
+
+private:
+    static const int kBuckets = 92;
+    static int bucketOf(long micros);
+    static long bucketLimit(int bucket);
+
+    uint32_t mCounts[PHASES][kBuckets];
+    uint32_t mPublished[PHASES][kBuckets];
+    int mTicks;
+    double mTicksPerSecond;
+    std::chrono::steady_clock::time_point mWindowStart;
+};
+
+#endif
@@ -0,0 +1,577 @@
+#include "protocol.h"
+
+namespace
+{
+    // The longest varint of a uint32 length
+    const int kMaxPrefix = 5;
+
+    // Room for the length prefix, filled in by finish()
+    std::string begin(MessageType type)
+    {
+        std::string message(kMaxPrefix, '\0');
+        message.push_back(static_cast<char>(type));
+        return message;
+    }
+
+    // Writes the length just in front of the payload and drops the room
+    // it did not need
+    std::string finish(std::string& message)
+    {
+        size_t length = message.size() - kMaxPrefix;
+        char prefix[kMaxPrefix];
+        int size = 0;
+        do
+        {
+            prefix[size ++] = static_cast<char>((length & 0x7f) | (length >= 0x80 ? 0x80 : 0));
+            length >>= 7;
+        }
+        while (length > 0 && size < kMaxPrefix);
+        message.replace(0, kMaxPrefix, prefix, size);
+        return message;
+    }
+
+    void putVarint(std::string& out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    // Reads a payload front to back, any overrun makes it invalid
+    class Cursor
+    {
+    public:
+        explicit Cursor(const std::string& payload) : mData(payload), mPos(1), mValid(true) {}
+
+        uint8_t byte()
+        {
+            if (this->mPos >= this->mData.size())
+            {
+                this->mValid = false;
+                return 0;
+            }
+            return static_cast<uint8_t>(this->mData[this->mPos ++]);
+        }
+
+        uint32_t varint()
+        {
+            uint32_t value = 0;
+            for (int shift = 0; shift < 35 && this->mValid; shift += 7)
+            {
+                uint8_t b = this->byte();
+                value |= static_cast<uint32_t>(b & 0x7f) << shift;
+                if (!(b & 0x80))
+                {
+                    return value;
+                }
+            }
+            this->mValid = false;
+            return 0;
+        }
+
+        // A position on the board, anything off it marks the payload bad
+        int coordinate(int limit)
+        {
+            uint32_t value = this->varint();
+            if (value >= static_cast<uint32_t>(limit))
+            {
+                this->mValid = false;
+                return 0;
+            }
+            return static_cast<int>(value);
+        }
+
+        bool done() const { return this->mPos >= this->mData.size(); }
+        bool valid() const { return this->mValid; }
+
+    private:
+        const std::string& mData;
+        size_t mPos;
+        bool mValid;
+    };
+
+    // Direction from one body segment to the next, keyframes store bodies
+    // as a head plus two bits per segment
+    int stepDirection(const World& world, const SnakeBody& from, const SnakeBody& to)
+    {
+        for (int d = 0; d < 4; d ++)
+        {
+            SnakeBody next = world.nextHead(from, static_cast<Direction>(d));
+            if (next.getX() == to.getX() && next.getY() == to.getY())
+            {
+                return d;
+            }
+        }
+        return 0;
+    }
+}
+
+std::string encodeHello()
+{
+    std::string message = begin(MessageType::HELLO);
+    return finish(message);
+}
+
+std::string encodeWatch()
+{
+    std::string message = begin(MessageType::WATCH);
+    return finish(message);
+}
+
+std::string encodeInput(Direction direction, uint32_t tick)
+{
+    std::string message = begin(MessageType::INPUT);
+    message.push_back(static_cast<char>(direction));
+    putVarint(message, tick);
+    return finish(message);
+}
+
+std::string encodeWelcome(const World& world, int snakeId, int tickMillis)
+{
+    std::string message = begin(MessageType::WELCOME);
+    // Shifted by one so that spectators fit in a varint
+    putVarint(message, snakeId + 1);
+    putVarint(message, world.getWidth());
+    putVarint(message, world.getHeight());
+    putVarint(message, tickMillis);
+    putVarint(message, world.getObstacles().size());
+    for (const Obstacle& obs : world.getObstacles())
+    {
+        putVarint(message, obs.x);
+        putVarint(message, obs.y);
+    }
+    return finish(message);
+}
+
+std::string encodeKeyframe(const World& world)
+{
+    std::string message = begin(MessageType::KEYFRAME);
+    putVarint(message, world.getTick());
+    const std::vector<WorldSnake>& snakes = world.getSnakes();
+    putVarint(message, snakes.size());
+    for (const WorldSnake& snake : snakes)
+    {
+        int flags = (snake.alive ? 1 : 0) | (snake.human ? 2 : 0)
+                    | static_cast<int>(snake.direction) << 2
+                    | static_cast<int>(snake.movedDirection) << 4;
+        message.push_back(static_cast<char>(flags));
+        putVarint(message, snake.score);
+        if (!snake.alive)
+        {
+            continue;
+        }
+        putVarint(message, snake.body.size());
+        putVarint(message, snake.body.front().getX());
+        putVarint(message, snake.body.front().getY());
+        uint8_t packed = 0;
+        for (int i = 1; i < snake.body.size(); i ++)
+        {
+            int shift = ((i - 1) % 4) * 2;
+            packed |= stepDirection(world, snake.body[i - 1], snake.body[i]) << shift;
+            if (shift == 6 || i == snake.body.size() - 1)
+            {
+                message.push_back(static_cast<char>(packed));
+                packed = 0;
+            }
+        }
+    }
+    putVarint(message, world.getFoods().size());
+    for (const SnakeBody& food : world.getFoods())
+    {
+        putVarint(message, food.getX());
+        putVarint(message, food.getY());
+    }
+    return finish(message);
+}
+
+std::string encodeDelta(uint32_t tick, const std::vector<WorldEvent>& events)
+{
+    std::string message = begin(MessageType::DELTA);
+    putVarint(message, tick);
+    for (const WorldEvent& event : events)
+    {
+        // Event type in the high nibble, a small argument in the low one
+        int type = static_cast<int>(event.type);
+        switch (event.type)
+        {
+            // Moves only carry the direction, the replica knows the old
+            // head. The low nibble holds the direction or death cause.
+            case WorldEvent::Type::MOVE:
+            case WorldEvent::Type::GROW:
+            case WorldEvent::Type::DIE:
+                message.push_back(static_cast<char>(type << 4 | event.value));
+                putVarint(message, event.id);
+                break;
+            case WorldEvent::Type::SPAWN:
+                message.push_back(static_cast<char>(type << 4 | (event.human ? 1 : 0)));
+                putVarint(message, event.id);
+                putVarint(message, event.x);
+                putVarint(message, event.y);
+                putVarint(message, event.value);
+                break;
+            case WorldEvent::Type::FOOD:
+                message.push_back(static_cast<char>(type << 4));
+                putVarint(message, event.x);
+                putVarint(message, event.y);
+                break;
+        }
+    }
+    return finish(message);
+}
+
+std::string encodeSetup(const LockstepSetup& setup)
+{
+    std::string message = begin(MessageType::SETUP);
+    putVarint(message, static_cast<uint32_t>(setup.seed));
+    putVarint(message, static_cast<uint32_t>(setup.seed >> 32));
+    putVarint(message, setup.width);
+    putVarint(message, setup.height);
+    putVarint(message, setup.map);
+    putVarint(message, setup.snakes);
+    putVarint(message, setup.length);
+    putVarint(message, setup.tickMillis);
+    putVarint(message, setup.inputDelay);
+    putVarint(message, setup.hashInterval);
+    return finish(message);
+}
+
+std::string encodeStatsRequest()
+{
+    std::string message = begin(MessageType::STATS);
+    return finish(message);
+}
+
+std::string encodeServerStats(const ServerStats& stats)
+{
+    std::string message = begin(MessageType::STATS);
+    putVarint(message, stats.ticks);
+    putVarint(message, stats.clients);
+    putVarint(message, stats.tickMicrosP50);
+    putVarint(message, stats.tickMicrosP99);
+    putVarint(message, stats.tickMicrosMax);
+    putVarint(message, stats.lateMicrosP99);
+    putVarint(message, stats.lateTicks);
+    return finish(message);
+}
+
+std::string encodeTickInput(int input)
+{
+    std::string message = begin(MessageType::TICK_INPUT);
+    message.push_back(static_cast<char>(input < 0 ? 0xff : input));
+    return finish(message);
+}
+
+std::string encodeStateHash(uint32_t tick, uint64_t hash)
+{
+    std::string message = begin(MessageType::STATE_HASH);
+    putVarint(message, tick);
+    for (int i = 0; i < 8; i ++)
+    {
+        message.push_back(static_cast<char>((hash >> (i * 8)) & 0xff));
+    }
+    return finish(message);
+}
+
+std::string encodePing(MessageType type, uint32_t stamp)
+{
+    std::string message = begin(type);
+    putVarint(message, stamp);
+    return finish(message);
+}
+
+MessageType messageType(const std::string& payload)
+{
+    // An empty payload is no message at all, 0 matches none of the types
+    return payload.empty() ? static_cast<MessageType>(0) : static_cast<MessageType>(payload[0]);
+}
+
+bool decodeInput(const std::string& payload, Direction& direction, uint32_t& tick)
+{
+    if (messageType(payload) != MessageType::INPUT)
+    {
+        return false;
+    }
+    Cursor cursor(payload);
+    int value = cursor.byte();
+    tick = cursor.varint();
+    if (!cursor.valid() || value > 3)
+    {
+        return false;
+    }
+    direction = static_cast<Direction>(value);
+    return true;
+}
+
+bool decodeWelcome(const std::string& payload, Welcome& welcome)
+{
+    if (messageType(payload) != MessageType::WELCOME)
+    {
+        return false;
+    }
+    Cursor cursor(payload);
+    welcome.snakeId = static_cast<int>(cursor.varint()) - 1;
+    welcome.width = cursor.varint();
+    welcome.height = cursor.varint();
+    welcome.tickMillis = cursor.varint();
+    int count = cursor.varint();
+    welcome.obstacles.clear();
+    for (int i = 0; i < count && cursor.valid(); i ++)
+    {
+        Obstacle obs;
+        obs.x = cursor.varint();
+        obs.y = cursor.varint();
+        welcome.obstacles.push_back(obs);
+    }
+    return cursor.valid();
+}
+
+bool decodeKeyframe(const std::string& payload, World& world)
+{
+    if (messageType(payload) != MessageType::KEYFRAME)
+    {
+        return false;
+    }
+    Cursor cursor(payload);
+    uint32_t tick = cursor.varint();
+    int count = cursor.varint();
+    world.clearState();
+    for (int id = 0; id < count && cursor.valid(); id ++)
+    {
+        int flags = cursor.byte();
+        WorldSnake snake;
+        snake.alive = flags & 1;
+        snake.human = flags & 2;
+        snake.direction = static_cast<Direction>((flags >> 2) & 3);
+        snake.movedDirection = static_cast<Direction>((flags >> 4) & 3);
+        snake.score = cursor.varint();
+        snake.cause = DeathCause::NONE;
+        if (snake.alive)
+        {
+            int length = cursor.varint();
+            int x = cursor.coordinate(world.getWidth());
+            int y = cursor.coordinate(world.getHeight());
+            snake.body.push_back(SnakeBody(x, y));
+            uint8_t packed = 0;
+            for (int i = 1; i < length && cursor.valid(); i ++)
+            {
+                int shift = ((i - 1) % 4) * 2;
+                if (shift == 0)
+                {
+                    packed = cursor.byte();
+                }
+                Direction step = static_cast<Direction>((packed >> shift) & 3);
+                snake.body.push_back(world.nextHead(snake.body.back(), step));
+            }
+        }
+        if (cursor.valid())
+        {
+            world.restoreSnake(id, snake);
+        }
+    }
+    int foods = cursor.varint();
+    for (int i = 0; i < foods && cursor.valid(); i ++)
+    {
+        int x = cursor.coordinate(world.getWidth());
+        int y = cursor.coordinate(world.getHeight());
+        world.restoreFood(SnakeBody(x, y));
+    }
+    world.setTick(tick);
+    return cursor.valid();
+}
+
+bool decodeDelta(const std::string& payload, const World& world, uint32_t& tick, std::vector<WorldEvent>& events)
+{
+    if (messageType(payload) != MessageType::DELTA)
+    {
+        return false;
+    }
+    Cursor cursor(payload);
+    tick = cursor.varint();
+    events.clear();
+    while (!cursor.done() && cursor.valid())
+    {
+        uint8_t head = cursor.byte();
+        WorldEvent event = {static_cast<WorldEvent::Type>(head >> 4), -1, 0, 0, head & 0x0f, false};
+        switch (event.type)
+        {
+            case WorldEvent::Type::MOVE:
+            case WorldEvent::Type::GROW:
+            case WorldEvent::Type::DIE:
+                event.id = cursor.varint();
+                break;
+            case WorldEvent::Type::SPAWN:
+                event.human = event.value & 1;
+                event.id = cursor.varint();
+                event.x = cursor.coordinate(world.getWidth());
+                event.y = cursor.coordinate(world.getHeight());
+                event.value = cursor.varint();
+                break;
+            case WorldEvent::Type::FOOD:
+                event.x = cursor.coordinate(world.getWidth());
+                event.y = cursor.coordinate(world.getHeight());
+                break;
+            default:
+                return false;
+        }
+        events.push_back(event);
+    }
+    return cursor.valid();
+}
+
+bool decodeDeltaTick(const std::string& payload, uint32_t& tick)
+{
+    if (messageType(payload) != MessageType::DELTA)
+    {
+        return false;
+    }
+    Cursor cursor(payload);
+    tick = cursor.varint();
+    return cursor.valid();
+}
+
+bool decodeSetup(const std::string& payload, LockstepSetup& setup)
+{
+    if (messageType(payload) != MessageType::SETUP)
+    {
+        return false;
+    }
+    Cursor cursor(payload);
+    uint64_t low = cursor.varint();
+    uint64_t high = cursor.varint();
+    setup.seed = low | high << 32;
+    setup.width = cursor.varint();
+    setup.height = cursor.varint();
+    setup.map = cursor.varint();
+    setup.snakes = cursor.varint();
+    setup.length = cursor.varint();
+    setup.tickMillis = cursor.varint();
+    setup.inputDelay = cursor.varint();
+    setup.hashInterval = cursor.varint();
+    return cursor.valid();
+}
+
+bool decodeServerStats(const std::string& payload, ServerStats& stats)
+{
+    if (messageType(payload) != MessageType::STATS || payload.size() < 2)
+    {
+        return false;
+    }
+    Cursor cursor(payload);
+    stats.ticks = cursor.varint();
+    stats.clients = cursor.varint();
+    stats.tickMicrosP50 = cursor.varint();
+    stats.tickMicrosP99 = cursor.varint();
+    stats.tickMicrosMax = cursor.varint();
+    stats.lateMicrosP99 = cursor.varint();
+    stats.lateTicks = cursor.varint();
+    return cursor.valid();
+}
+
+bool decodeTickInput(const std::string& payload, int& input)
+{
+    if (messageType(payload) != MessageType::TICK_INPUT)
+    {
+        return false;
+    }
+    Cursor cursor(payload);
+    int value = cursor.byte();
+    if (!cursor.valid() || (value > 3 && value != 0xff))
+    {
+        return false;
+    }
+    input = value == 0xff ? -1 : value;
+    return true;
+}
+
+bool decodeStateHash(const std::string& payload, uint32_t& tick, uint64_t& hash)
+{
+    if (messageType(payload) != MessageType::STATE_HASH)
+    {
+        return false;
+    }
+    Cursor cursor(payload);
+    tick = cursor.varint();
+    hash = 0;
+    for (int i = 0; i < 8; i ++)
+    {
+        hash |= static_cast<uint64_t>(cursor.byte()) << (i * 8);
+    }
+    return cursor.valid();
+}
+
+bool decodePing(const std::string& payload, uint32_t& stamp)
+{
+    MessageType type = messageType(payload);
+    if (type != MessageType::PING && type != MessageType::PONG)
+    {
+        return false;
+    }
+    Cursor cursor(payload);
+    stamp = cursor.varint();
+    return cursor.valid();
+}
+
+void FrameReader::feed(const char* data, size_t size)
+{
+    // Drop what was already handed out before growing the buffer
+    if (this->mOffset > 0 && this->mOffset == this->mBuffer.size())
+    {
+        this->mBuffer.clear();
+        this->mOffset = 0;
+    }
+    else if (this->mOffset > 4096)
+    {
+        this->mBuffer.erase(0, this->mOffset);
+        this->mOffset = 0;
+    }
+    this->mBuffer.append(data, size);
+}
+
+bool FrameReader::next(std::string& payload)
+{
+    if (this->mBroken)
+    {
+        return false;
+    }
+    size_t available = this->mBuffer.size() - this->mOffset;
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(this->mBuffer.data()) + this->mOffset;
+    size_t length = 0;
+    int prefix = 0;
+    while (true)
+    {
+        if (prefix == available)
+        {
+            return false;
+        }
+        length |= static_cast<size_t>(data[prefix] & 0x7f) << (7 * prefix);
+        if (!(data[prefix ++] & 0x80))
+        {
+            break;
+        }
+        if (prefix == kMaxPrefix)
+        {
+            this->mBroken = true;
+            return false;
+        }
+    }
+    if (length > kMaxMessageBytes)
+    {
+        this->mBroken = true;
+        return false;
+    }
+    if (available < prefix + length)
+    {
+        return false;
+    }
+    payload.assign(this->mBuffer, this->mOffset + prefix, length);
+    this->mOffset += prefix + length;
+    return true;
+}
+
+bool FrameReader::isBroken() const
+{
+    return this->mBroken;
+}
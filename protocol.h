@@ -0,0 +1,138 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "world.h"
+
+// Wire format between snake-server and its clients.
+//
+// Every message is its length as a varint followed by that many bytes,
+// the first of which is the message type. Numbers are varints too, so
+// coordinates and ids on normal boards take one byte each. A tick's
+// delta has a one or two byte length, while the welcome of a huge arena
+// can run to megabytes. Readers refuse anything over kMaxMessageBytes.
+//
+// After HELLO the server answers with WELCOME (board size, obstacles and
+// the id of the snake the client steers) and a KEYFRAME with the whole
+// board. From then on each tick is one DELTA holding the WorldEvents of
+// that tick: a moving snake costs two or three bytes no matter how long
+// it is. Spectators send WATCH instead and get the same stream, plus a
+// fresh KEYFRAME whenever they fell too far behind.
+enum class MessageType
+{
+    HELLO = 1,
+    INPUT = 2,
+    WELCOME = 3,
+    KEYFRAME = 4,
+    DELTA = 5,
+    WATCH = 6,
+    // Lockstep play between two peers, see lockstep.h
+    SETUP = 7,
+    TICK_INPUT = 8,
+    STATE_HASH = 9,
+    // Round trip measurement, the server echoes PING as PONG
+    PING = 10,
+    PONG = 11,
+    // An empty STATS asks the server how its ticks are keeping up, the
+    // reply covers the ticks since the previous request
+    STATS = 12,
+};
+
+struct Welcome
+{
+    // -1 for spectators
+    int snakeId;
+    int width;
+    int height;
+    int tickMillis;
+    std::vector<Obstacle> obstacles;
+};
+
+// Tick timing as measured by the server
+struct ServerStats
+{
+    uint32_t ticks;
+    uint32_t clients;
+    // Time spent inside a tick: inputs, bots, step, encode and fan-out
+    uint32_t tickMicrosP50;
+    uint32_t tickMicrosP99;
+    uint32_t tickMicrosMax;
+    // How long after its slot a tick started, and how many started a
+    // whole tick late
+    uint32_t lateMicrosP99;
+    uint32_t lateTicks;
+};
+
+// What the hosting peer decides for both
+struct LockstepSetup
+{
+    uint64_t seed;
+    int width;
+    int height;
+    int map;
+    int snakes;
+    int length;
+    int tickMillis;
+    int inputDelay;
+    int hashInterval;
+};
+
+std::string encodeHello();
+std::string encodeWatch();
+// Turn for the step that produces the given tick. Late inputs are
+// applied on the next step.
+std::string encodeInput(Direction direction, uint32_t tick);
+std::string encodeWelcome(const World& world, int snakeId, int tickMillis);
+std::string encodeKeyframe(const World& world);
+std::string encodeDelta(uint32_t tick, const std::vector<WorldEvent>& events);
+std::string encodeSetup(const LockstepSetup& setup);
+std::string encodeStatsRequest();
+std::string encodeServerStats(const ServerStats& stats);
+// One per tick and peer, -1 when no key was pressed. The tick is implied
+// by the order on the stream, so this is four bytes.
+std::string encodeTickInput(int input);
+std::string encodeStateHash(uint32_t tick, uint64_t hash);
+std::string encodePing(MessageType type, uint32_t stamp);
+
+// The decoders take a payload returned by FrameReader and return false
+// when it is truncated, of another type or places something off the board
+MessageType messageType(const std::string& payload);
+bool decodeInput(const std::string& payload, Direction& direction, uint32_t& tick);
+bool decodeWelcome(const std::string& payload, Welcome& welcome);
+// Loads the snakes and food into a replica built from the Welcome
+bool decodeKeyframe(const std::string& payload, World& world);
+bool decodeDelta(const std::string& payload, const World& world, uint32_t& tick, std::vector<WorldEvent>& events);
+// Only the tick of a DELTA, for clients that keep no board
+bool decodeDeltaTick(const std::string& payload, uint32_t& tick);
+bool decodeSetup(const std::string& payload, LockstepSetup& setup);
+// False for a request, which has no body
+bool decodeServerStats(const std::string& payload, ServerStats& stats);
+bool decodeTickInput(const std::string& payload, int& input);
+bool decodeStateHash(const std::string& payload, uint32_t& tick, uint64_t& hash);
+// Takes PING and PONG
+bool decodePing(const std::string& payload, uint32_t& stamp);
+
+const size_t kMaxMessageBytes = 64 << 20;
+
+// Splits a byte stream back into message payloads
+class FrameReader
+{
+public:
+    void feed(const char* data, size_t size);
+    // False until a whole message has arrived, and for good once the
+    // stream is broken
+    bool next(std::string& payload);
+    // A length was malformed or over kMaxMessageBytes. Nothing after it
+    // can be framed, the connection should be dropped.
+    bool isBroken() const;
+
+private:
+    std::string mBuffer;
+    size_t mOffset = 0;
+    bool mBroken = false;
+};
+
+#endif
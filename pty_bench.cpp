@@ -0,0 +1,666 @@
+// End-to-end harness: runs the real game binary under a pseudo-terminal,
+// types a key script into it and times what comes back on the terminal.
+// Prints one JSON object with latency, frame rate, bytes and CPU cost.
+// cpuMs is the game's whole life, menus and startup included. gameCpuMs
+// runs from the first to the last output of the game phase, and
+// cpuMsPerFrame divides it by the frames seen there. Under pacing a frame
+// can stand for several ticks, so this is not a per tick cost.
+//
+//   snake-ptybench [--rows R] [--cols C] [--script "enter@500 a@400 ..."] [-- ./snakegame --ansi]
+//
+// Script tokens are key@milliseconds, the time to keep reading output
+// after sending the key. Keys are single characters or enter, esc, space,
+// up, down, left, right.
+//
+// A key's latency runs until the output shows it, not just until the next
+// bytes arrive, since the game repaints every tick anyway. A steering key
+// shows once the snake's head moves that way, any other key once a frame
+// changes something besides the moving snake, or the game exits. Keys
+// that never show within their wait are counted as missed.
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <pty.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Step
+    {
+        std::string keys;
+        int waitMs;
+        bool inGame;
+        // Direction the key steers the snake, zero for other keys
+        int dx;
+        int dy;
+    };
+
+    struct Chunk
+    {
+        Clock::time_point time;
+        size_t bytes;
+        size_t escapes;
+        // The game's CPU time so far
+        double cpuMs;
+    };
+
+    // Enter classic mode on the first map, steer around, pause and resume,
+    // then leave through the pause menu and quit from the main menu
+    const char* kDefaultScript =
+        "enter@500 enter@1000 a@400 w@400 d@400 w@400 a@400 w@400 d@400 w@400 "
+        "p@500 enter@500 a@400 w@400 d@400 w@400 p@300 s@150 s@150 enter@500 esc@1500";
+
+    // Output separated by a quieter gap than this belongs to one frame
+    const auto kFrameGap = std::chrono::milliseconds(3);
+
+    std::string keyBytes(const std::string& name)
+    {
+        if (name == "enter") return "\r";
+        if (name == "esc") return "\x1b";
+        if (name == "space") return " ";
+        if (name == "up") return "\x1b[A";
+        if (name == "down") return "\x1b[B";
+        if (name == "right") return "\x1b[C";
+        if (name == "left") return "\x1b[D";
+        return name;
+    }
+
+    // Mirrors the keys Game::controlSnake steers with
+    void steering(const std::string& name, int& dx, int& dy)
+    {
+        dx = 0;
+        dy = 0;
+        if (name == "w" || name == "W" || name == "up") dy = -1;
+        if (name == "s" || name == "S" || name == "down") dy = 1;
+        if (name == "a" || name == "A" || name == "left") dx = -1;
+        if (name == "d" || name == "D" || name == "right") dx = 1;
+    }
+
+    std::vector<Step> parseScript(const std::string& script)
+    {
+        std::vector<Step> steps;
+        std::istringstream tokens(script);
+        std::string token;
+        // The game board is up after the second enter (mode, then map)
+        int enters = 0;
+        bool inGame = false;
+        while (tokens >> token)
+        {
+            size_t at = token.find('@');
+            Step step;
+            step.keys = keyBytes(token.substr(0, at));
+            steering(token.substr(0, at), step.dx, step.dy);
+            step.waitMs = at == std::string::npos ? 200 : std::atoi(token.c_str() + at + 1);
+            step.inGame = inGame;
+            steps.push_back(step);
+            if (!inGame && step.keys == "\r" && ++ enters == 2)
+            {
+                inGame = true;
+            }
+        }
+        return steps;
+    }
+
+    // Counts escape sequences so frames can be compared by command count
+    class EscapeCounter
+    {
+    public:
+        size_t feed(const char* data, size_t size)
+        {
+            size_t count = 0;
+            for (size_t i = 0; i < size; i ++)
+            {
+                char c = data[i];
+                if (c == '\x1b')
+                {
+                    this->mInEscape = true;
+                    this->mFirst = true;
+                    count ++;
+                }
+                else if (this->mInEscape)
+                {
+                    // ESC [ ... final byte, or a two/three byte ESC ( 0 style sequence
+                    if (this->mFirst && c != '[')
+                    {
+                        this->mInEscape = c == '(' || c == ')';
+                    }
+                    else if (!this->mFirst && c >= '@' && c <= '~')
+                    {
+                        this->mInEscape = false;
+                    }
+                    this->mFirst = false;
+                }
+            }
+            return count;
+        }
+    private:
+        bool mInEscape = false;
+        bool mFirst = false;
+    };
+
+    struct Change
+    {
+        int cell;
+        char before;
+        char after;
+    };
+
+    // Just enough of a terminal to tell which cells the output changed:
+    // printable bytes, cursor movement, erases and attributes, which is
+    // all a menu highlight changes. Anything else is skipped.
+    class Screen
+    {
+    public:
+        Screen(int rows, int cols) : mRows(rows), mCols(cols), mCells(rows * cols, ' '), mAttrs(rows * cols, 0) {}
+
+        void feed(const char* data, size_t size, std::vector<Change>& changes)
+        {
+            for (size_t i = 0; i < size; i ++)
+            {
+                char c = data[i];
+                if (this->mState == CSI)
+                {
+                    if (c >= '@' && c <= '~')
+                    {
+                        this->csi(c, changes);
+                        this->mState = TEXT;
+                    }
+                    else
+                    {
+                        this->mParams += c;
+                    }
+                }
+                else if (this->mState == ESCAPE)
+                {
+                    this->mParams.clear();
+                    this->mState = c == '[' ? CSI : (c == '(' || c == ')') ? CHARSET : TEXT;
+                }
+                else if (this->mState == CHARSET)
+                {
+                    this->mState = TEXT;
+                }
+                else if (c == '\x1b')
+                {
+                    this->mState = ESCAPE;
+                }
+                else if (c == '\r')
+                {
+                    this->mX = 0;
+                }
+                else if (c == '\n')
+                {
+                    this->mY = std::min(this->mY + 1, this->mRows - 1);
+                }
+                else if (c == '\b')
+                {
+                    this->mX = std::max(this->mX - 1, 0);
+                }
+                else if (static_cast<unsigned char>(c) >= 0xc0 || (c >= ' ' && c != '\x7f'))
+                {
+                    // One cell per UTF-8 character, continuation bytes are skipped
+                    this->print(static_cast<unsigned char>(c) >= 0x80 ? '?' : c, changes);
+                }
+            }
+        }
+
+        int getCols() const
+        {
+            return this->mCols;
+        }
+
+        char at(int x, int y) const
+        {
+            if (x < 0 || y < 0 || x >= this->mCols || y >= this->mRows)
+            {
+                return ' ';
+            }
+            return this->mCells[y * this->mCols + x];
+        }
+
+    private:
+        enum State { TEXT, ESCAPE, CSI, CHARSET };
+
+        void set(int x, int y, char c, uint32_t attr, std::vector<Change>& changes)
+        {
+            char& cell = this->mCells[y * this->mCols + x];
+            uint32_t& cellAttr = this->mAttrs[y * this->mCols + x];
+            if (cell != c || cellAttr != attr)
+            {
+                changes.push_back(Change{y * this->mCols + x, cell, c});
+                cell = c;
+                cellAttr = attr;
+            }
+        }
+
+        // Packs bold, dim, underline, blink and reverse into the low bits,
+        // the foreground and background colours above them
+        void sgr(const std::vector<int>& args)
+        {
+            if (args.empty())
+            {
+                this->mAttr = 0;
+            }
+            for (size_t i = 0; i < args.size(); i ++)
+            {
+                int code = args[i];
+                if (code == 0) this->mAttr = 0;
+                else if (code >= 1 && code <= 7) this->mAttr |= 1u << code;
+                else if (code >= 22 && code <= 27) this->mAttr &= ~(code == 22 ? 6u : 1u << (code - 20));
+                else if ((code == 38 || code == 48) && i + 2 < args.size() && args[i + 1] == 5)
+                {
+                    int shift = code == 38 ? 8 : 20;
+                    this->mAttr = (this->mAttr & ~(0xfffu << shift)) | ((args[i + 2] + 1u) << shift);
+                    i += 2;
+                }
+                else if ((code >= 30 && code <= 39) || (code >= 90 && code <= 97))
+                {
+                    this->mAttr = (this->mAttr & ~(0xfffu << 8)) | (code == 39 ? 0u : 0x800u + code) << 8;
+                }
+                else if ((code >= 40 && code <= 49) || (code >= 100 && code <= 107))
+                {
+                    this->mAttr = (this->mAttr & ~(0xfffu << 20)) | (code == 49 ? 0u : 0x800u + code) << 20;
+                }
+            }
+        }
+
+        void print(char c, std::vector<Change>& changes)
+        {
+            if (this->mX >= this->mCols)
+            {
+                this->mX = 0;
+                this->mY = std::min(this->mY + 1, this->mRows - 1);
+            }
+            this->set(this->mX, this->mY, c, this->mAttr, changes);
+            this->mX ++;
+            this->mLast = c;
+        }
+
+        void erase(int from, int to, std::vector<Change>& changes)
+        {
+            for (int cell = std::max(from, 0); cell < std::min(to, this->mRows * this->mCols); cell ++)
+            {
+                this->set(cell % this->mCols, cell / this->mCols, ' ', 0, changes);
+            }
+        }
+
+        void csi(char final, std::vector<Change>& changes)
+        {
+            if (!this->mParams.empty() && (this->mParams[0] == '?' || this->mParams[0] == '>'))
+            {
+                // Private modes such as the cursor and alternate screen
+                return;
+            }
+            std::vector<int> args;
+            std::istringstream params(this->mParams);
+            std::string param;
+            while (std::getline(params, param, ';'))
+            {
+                args.push_back(std::atoi(param.c_str()));
+            }
+            int n = args.empty() || args[0] <= 0 ? 1 : args[0];
+            int mode = args.empty() ? 0 : args[0];
+            int cursor = this->mY * this->mCols + std::min(this->mX, this->mCols - 1);
+            int line = this->mY * this->mCols;
+            switch (final)
+            {
+                case 'H':
+                case 'f':
+                    this->mY = n - 1;
+                    this->mX = args.size() > 1 && args[1] > 0 ? args[1] - 1 : 0;
+                    break;
+                case 'A': this->mY -= n; break;
+                case 'B': this->mY += n; break;
+                case 'C': this->mX += n; break;
+                case 'D': this->mX = std::min(this->mX, this->mCols - 1) - n; break;
+                case 'G': this->mX = n - 1; break;
+                case 'd': this->mY = n - 1; break;
+                case 'J':
+                    if (mode == 0) this->erase(cursor, this->mRows * this->mCols, changes);
+                    else if (mode == 1) this->erase(0, cursor + 1, changes);
+                    else this->erase(0, this->mRows * this->mCols, changes);
+                    break;
+                case 'K':
+                    if (mode == 0) this->erase(cursor, line + this->mCols, changes);
+                    else if (mode == 1) this->erase(line, cursor + 1, changes);
+                    else this->erase(line, line + this->mCols, changes);
+                    break;
+                case 'X':
+                    this->erase(cursor, std::min(cursor + n, line + this->mCols), changes);
+                    break;
+                case 'm':
+                    this->sgr(args);
+                    break;
+                case 'b':
+                    for (int i = 0; i < n; i ++)
+                    {
+                        this->print(this->mLast, changes);
+                    }
+                    break;
+            }
+            this->mX = std::max(0, std::min(this->mX, this->mCols));
+            this->mY = std::max(0, std::min(this->mY, this->mRows - 1));
+        }
+
+        int mRows;
+        int mCols;
+        std::vector<char> mCells;
+        std::vector<uint32_t> mAttrs;
+        uint32_t mAttr = 0;
+        int mX = 0;
+        int mY = 0;
+        char mLast = ' ';
+        State mState = TEXT;
+        std::string mParams;
+    };
+
+    const char kSnakeSymbol = '@';
+
+    // Whether the cells a chunk of output changed show the effect of a key.
+    // head is the last head cell seen, -1 when unknown, and is kept current.
+    bool showsKey(const Screen& screen, const std::vector<Change>& changes, const Step& step, int& head)
+    {
+        std::vector<int> heads;
+        bool other = false;
+        for (const Change& change : changes)
+        {
+            if (change.after == kSnakeSymbol && change.before != kSnakeSymbol)
+            {
+                heads.push_back(change.cell);
+            }
+            else if (change.after != kSnakeSymbol && change.before != kSnakeSymbol)
+            {
+                other = true;
+            }
+        }
+        bool turned = false;
+        int cols = screen.getCols();
+        for (int cell : heads)
+        {
+            if (step.dx == 0 && step.dy == 0)
+            {
+                break;
+            }
+            int x = cell % cols;
+            int y = cell / cols;
+            if (head < 0)
+            {
+                // The body follows right behind a head that moved this way
+                turned = turned || screen.at(x - step.dx, y - step.dy) == kSnakeSymbol;
+                continue;
+            }
+            int headX = head % cols;
+            int headY = head / cols;
+            // A jump of more than one cell is the board wrapping
+            if (step.dx != 0 && y == headY)
+            {
+                turned = turned || (x - headX) * step.dx > 0 || std::abs(x - headX) > 1;
+            }
+            if (step.dy != 0 && x == headX)
+            {
+                turned = turned || (y - headY) * step.dy > 0 || std::abs(y - headY) > 1;
+            }
+        }
+        if (!heads.empty())
+        {
+            // A full repaint draws the whole body at once
+            head = heads.size() == 1 ? heads[0] : -1;
+        }
+        if (step.dx != 0 || step.dy != 0)
+        {
+            // Eating moves the head and changes the food and score in the
+            // same frame, which says nothing about a steering key
+            return turned || (other && heads.empty());
+        }
+        return other;
+    }
+
+    // CPU time of all the game's threads, the clock reads in nanoseconds
+    // where rusage and /proc/<pid>/stat only have scheduler ticks
+    double processCpuMs(clockid_t clock)
+    {
+        timespec time = {};
+        if (clock_gettime(clock, &time) != 0)
+        {
+            return 0;
+        }
+        return time.tv_sec * 1e3 + time.tv_nsec / 1e6;
+    }
+
+    double millis(Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    double percentile(std::vector<double> values, double p)
+    {
+        if (values.empty())
+        {
+            return 0;
+        }
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+    }
+
+    std::string quote(const std::string& text)
+    {
+        std::string quoted = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                quoted += '\\';
+            }
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int rows = 30;
+    int cols = 100;
+    std::string script = kDefaultScript;
+    std::vector<std::string> command = {"./snakegame"};
+    for (int i = 1; i < argc; i ++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rows" && i + 1 < argc) rows = std::atoi(argv[++ i]);
+        else if (arg == "--cols" && i + 1 < argc) cols = std::atoi(argv[++ i]);
+        else if (arg == "--script" && i + 1 < argc) script = argv[++ i];
+        else if (arg == "--")
+        {
+            command.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [--rows R] [--cols C] [--script KEYS] [-- command args...]" << std::endl;
+            return 1;
+        }
+    }
+    if (command.empty())
+    {
+        std::cerr << "no command to run" << std::endl;
+        return 1;
+    }
+    std::vector<Step> steps = parseScript(script);
+
+    winsize size = {};
+    size.ws_row = rows;
+    size.ws_col = cols;
+    int master;
+    pid_t child = forkpty(&master, nullptr, nullptr, &size);
+    if (child < 0)
+    {
+        std::perror("forkpty");
+        return 1;
+    }
+    if (child == 0)
+    {
+        setenv("TERM", "xterm-256color", 0);
+        std::vector<char*> args;
+        for (std::string& arg : command)
+        {
+            args.push_back(&arg[0]);
+        }
+        args.push_back(nullptr);
+        execvp(args[0], args.data());
+        std::perror("execvp");
+        _exit(127);
+    }
+
+    clockid_t childClock;
+    if (clock_getcpuclockid(child, &childClock) != 0)
+    {
+        childClock = -1;
+    }
+
+    std::vector<Chunk> gameChunks;
+    std::vector<double> latencies;
+    size_t missed = 0;
+    EscapeCounter escapes;
+    Screen screen(rows, cols);
+    std::vector<Change> changes;
+    int head = -1;
+    size_t totalBytes = 0;
+    bool childExited = false;
+    int status = 0;
+    char buffer[1 << 16];
+
+    // Read until the deadline, returns the time the output first showed
+    // the step's key
+    auto pump = [&](const Step& step) {
+        Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(step.waitMs);
+        Clock::time_point shown = Clock::time_point::max();
+        while (!childExited)
+        {
+            int timeout = static_cast<int>(millis(deadline - Clock::now()));
+            if (timeout <= 0)
+            {
+                break;
+            }
+            pollfd in = {master, POLLIN, 0};
+            if (poll(&in, 1, timeout) <= 0)
+            {
+                continue;
+            }
+            ssize_t n = read(master, buffer, sizeof(buffer));
+            if (n <= 0)
+            {
+                // EIO once the child closed its side, which is how a
+                // quit key shows
+                childExited = true;
+                shown = std::min(shown, Clock::now());
+                break;
+            }
+            Clock::time_point now = Clock::now();
+            changes.clear();
+            screen.feed(buffer, n, changes);
+            if (showsKey(screen, changes, step, head))
+            {
+                shown = std::min(shown, now);
+            }
+            totalBytes += n;
+            size_t count = escapes.feed(buffer, n);
+            if (step.inGame)
+            {
+                gameChunks.push_back(Chunk{now, static_cast<size_t>(n), count, processCpuMs(childClock)});
+            }
+        }
+        return shown;
+    };
+
+    Clock::time_point start = Clock::now();
+    pump(Step{"", 500, false, 0, 0});
+    for (const Step& step : steps)
+    {
+        if (childExited)
+        {
+            break;
+        }
+        Clock::time_point sent = Clock::now();
+        if (write(master, step.keys.data(), step.keys.size()) < 0)
+        {
+            break;
+        }
+        Clock::time_point shown = pump(step);
+        if (shown != Clock::time_point::max())
+        {
+            latencies.push_back(millis(shown - sent));
+        }
+        else
+        {
+            missed ++;
+        }
+    }
+    double durationMs = millis(Clock::now() - start);
+
+    rusage usage = {};
+    if (wait4(child, &status, WNOHANG, &usage) == 0)
+    {
+        kill(child, SIGKILL);
+        wait4(child, &status, 0, &usage);
+    }
+    close(master);
+
+    // Group chunks into frames and time the game phase
+    size_t frames = 0;
+    size_t gameBytes = 0;
+    size_t gameEscapes = 0;
+    for (size_t i = 0; i < gameChunks.size(); i ++)
+    {
+        if (i == 0 || gameChunks[i].time - gameChunks[i - 1].time > kFrameGap)
+        {
+            frames ++;
+        }
+        gameBytes += gameChunks[i].bytes;
+        gameEscapes += gameChunks[i].escapes;
+    }
+    double gameMs = gameChunks.size() > 1 ? millis(gameChunks.back().time - gameChunks.front().time) : 0;
+    double gameCpuMs = gameChunks.size() > 1 ? gameChunks.back().cpuMs - gameChunks.front().cpuMs : 0;
+    double cpuMs = usage.ru_utime.tv_sec * 1e3 + usage.ru_utime.tv_usec / 1e3
+                 + usage.ru_stime.tv_sec * 1e3 + usage.ru_stime.tv_usec / 1e3;
+
+    std::string commandLine;
+    for (const std::string& arg : command)
+    {
+        commandLine += (commandLine.empty() ? "" : " ") + arg;
+    }
+    std::cout << "{\"command\":" << quote(commandLine)
+              << ",\"rows\":" << rows
+              << ",\"cols\":" << cols
+              << ",\"durationMs\":" << durationMs
+              << ",\"bytes\":" << totalBytes
+              << ",\"frames\":" << frames
+              << ",\"fps\":" << (gameMs > 0 ? frames * 1000.0 / gameMs : 0)
+              << ",\"bytesPerFrame\":" << (frames ? gameBytes / static_cast<double>(frames) : 0)
+              << ",\"escapesPerFrame\":" << (frames ? gameEscapes / static_cast<double>(frames) : 0)
+              << ",\"latencyMs\":{\"p50\":" << percentile(latencies, 0.5)
+              << ",\"p99\":" << percentile(latencies, 0.99)
+              << ",\"max\":" << percentile(latencies, 1.0)
+              << ",\"samples\":" << latencies.size()
+              << ",\"missed\":" << missed << "}"
+              << ",\"cpuMs\":" << cpuMs
+              << ",\"gameCpuMs\":" << gameCpuMs
+              << ",\"cpuMsPerFrame\":" << (frames ? gameCpuMs / frames : 0)
+              << ",\"exited\":" << (WIFEXITED(status) ? "true" : "false")
+              << "}" << std::endl;
+    return 0;
+}
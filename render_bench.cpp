@@ -0,0 +1,178 @@
+// Headless render benchmark: drives the real Game drawing code against
+// a VirtualRenderer and reports frame cost as JSON. With --dump the final
+// screen is printed instead, which is handy for golden comparisons.
+// With --snakes N it times party-mode ticks of N bots on the same board,
+// --arena SIDE runs them on a SIDE x SIDE arena with --foods N food.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "game.h"
+#include "bot.h"
+#include "virtual_renderer.h"
+
+namespace
+{
+    struct Options
+    {
+        int width = 100;
+        int height = 30;
+        int frames = 1000;
+        int map = 0;
+        unsigned seed = 1;
+        int snakes = 0;
+        // Square board of this side instead of the screen sized one
+        int arena = 0;
+        int foods = 0;
+        bool dump = false;
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; i ++)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--width" && hasValue) options.width = std::atoi(argv[++ i]);
+            else if (arg == "--height" && hasValue) options.height = std::atoi(argv[++ i]);
+            else if (arg == "--frames" && hasValue) options.frames = std::atoi(argv[++ i]);
+            else if (arg == "--map" && hasValue) options.map = std::atoi(argv[++ i]);
+            else if (arg == "--seed" && hasValue) options.seed = std::atoi(argv[++ i]);
+            else if (arg == "--snakes" && hasValue) options.snakes = std::atoi(argv[++ i]);
+            else if (arg == "--arena" && hasValue) options.arena = std::atoi(argv[++ i]);
+            else if (arg == "--foods" && hasValue) options.foods = std::atoi(argv[++ i]);
+            else if (arg == "--dump") options.dump = true;
+            else
+            {
+                std::cerr << "usage: " << argv[0]
+                          << " [--width W] [--height H] [--frames N] [--map I] [--seed S] [--snakes N] [--arena SIDE] [--foods N] [--dump]" << std::endl;
+                std::exit(1);
+            }
+        }
+        return options;
+    }
+
+    long percentile(std::vector<long> values, double p)
+    {
+        if (values.empty())
+        {
+            return 0;
+        }
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+    }
+
+    // Bot decisions plus one simultaneous move, timed per tick
+    int benchParty(const Options& options)
+    {
+        // Same board size the game would get on this screen
+        int boardWidth = options.arena > 0 ? options.arena : options.width - 18;
+        int boardHeight = options.arena > 0 ? options.arena : options.height - 6;
+        std::vector<GameMap> maps = GameMap::getDefaultMaps(boardWidth, boardHeight, options.seed);
+        const GameMap& map = maps[std::min<int>(options.map, maps.size() - 1)];
+        World world(boardWidth, boardHeight, options.arena > 0 ? std::vector<Obstacle>() : map.getObstacles(), options.seed);
+        for (int i = 0; i < options.snakes; i ++)
+        {
+            world.spawnSnake(2, false);
+        }
+        world.setFoodCount(options.foods > 0 ? options.foods : std::max(1, options.snakes / 2));
+
+        std::vector<long> tickMicros;
+        for (int tick = 0; tick < options.frames; tick ++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < world.getSnakes().size(); i ++)
+            {
+                // Keep the population constant, as party mode does
+                if (world.getSnakes()[i].alive || world.respawnSnake(i, 2))
+                {
+                    world.turn(i, chooseGreedyMove(world, i));
+                }
+            }
+            world.step();
+            auto end = std::chrono::steady_clock::now();
+            tickMicros.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000);
+        }
+        std::cout << "{\"mode\":\"" << (options.arena > 0 ? "arena" : "party") << "\""
+                  << ",\"snakes\":" << world.getSnakes().size()
+                  << ",\"alive\":" << world.getAliveCount()
+                  << ",\"foods\":" << world.getFoods().size()
+                  << ",\"chunks\":" << world.getIndex().getAllocatedChunks()
+                  << ",\"ticks\":" << options.frames
+                  << ",\"tickMicros\":{\"p50\":" << percentile(tickMicros, 0.5)
+                  << ",\"p99\":" << percentile(tickMicros, 0.99) << "}}" << std::endl;
+        return 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options = parseOptions(argc, argv);
+    if (options.snakes > 0)
+    {
+        return benchParty(options);
+    }
+
+    VirtualRenderer* screen = new VirtualRenderer(options.height, options.width);
+    Game game{std::unique_ptr<Renderer>(screen)};
+    game.setSeed(options.seed);
+
+    // Pick the map through the real menu
+    screen->pushKeys(std::string(options.map, 's') + "\n");
+    game.selectMap();
+    game.showBoards();
+    game.initializeGame();
+
+    // Turn every few frames so the snake wanders across the board
+    const std::string turns = "awdw";
+    std::vector<long> renderMicros;
+    long bytesBefore = screen->getStats().bytes;
+    for (int frame = 0; frame < options.frames; frame ++)
+    {
+        if (frame % 8 == 0)
+        {
+            screen->pushKey(turns[(frame / 8) % turns.size()]);
+        }
+        game.controlSnake();
+        if (!game.stepGame())
+        {
+            game.initializeGame();
+        }
+        auto start = std::chrono::steady_clock::now();
+        game.renderBoards();
+        auto end = std::chrono::steady_clock::now();
+        renderMicros.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+    }
+    long frameBytes = screen->getStats().bytes - bytesBefore;
+
+    // Opening the pause menu over a live board and closing it again
+    long beforePause = screen->getStats().bytes;
+    screen->pushKeys("\n");
+    game.renderPauseMenu();
+    long pauseBytes = screen->getStats().bytes - beforePause;
+
+    if (options.dump)
+    {
+        std::cout << screen->dump();
+        return 0;
+    }
+
+    std::cout << "{\"renderer\":\"virtual\""
+              << ",\"width\":" << options.width
+              << ",\"height\":" << options.height
+              << ",\"map\":" << options.map
+              << ",\"frames\":" << options.frames
+              << ",\"bytes\":" << frameBytes
+              << ",\"bytesPerFrame\":" << (options.frames ? frameBytes / static_cast<double>(options.frames) : 0)
+              << ",\"writes\":" << screen->getStats().writes
+              << ",\"renderMicros\":{\"p50\":" << percentile(renderMicros, 0.5)
+              << ",\"p99\":" << percentile(renderMicros, 0.99) << "}"
+              << ",\"pauseMenuBytes\":" << pauseBytes << "}" << std::endl;
+    return 0;
+}
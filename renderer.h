@@ -0,0 +1,70 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <string>
+
+// Attribute bits (A_BOLD, A_REVERSE, COLOR_PAIR(n) ...) and key codes
+// (KEY_UP ...) are borrowed from curses so every backend speaks the same
+// vocabulary. Only the macros are used, backends other than curses never
+// call into the library.
+#include <ncurses.h>
+
+// A rectangular drawing area, the backend-neutral replacement for WINDOW*.
+// Coordinates are relative to the surface, like the mvw* curses calls.
+class Surface
+{
+public:
+    virtual ~Surface() {}
+
+    virtual void erase() = 0;
+    virtual void drawBox() = 0;
+    virtual void putChar(int y, int x, char ch) = 0;
+    virtual void print(int y, int x, const std::string& text) = 0;
+    virtual void clearToEol(int y, int x) = 0;
+    virtual void attrOn(int attr) = 0;
+    virtual void attrOff(int attr) = 0;
+
+    // Surfaces form a stack. show() raises a surface to the top,
+    // hide() uncovers whatever is below it on the next present().
+    virtual void show() = 0;
+    virtual void hide() = 0;
+    virtual bool isVisible() const = 0;
+};
+
+// Counters every backend keeps so frame cost can be compared
+struct RenderStats
+{
+    long frames = 0;
+    long bytes = 0;
+    long writes = 0;
+    // Time the last present() spent pushing output to the terminal
+    long stallMicros = 0;
+    // Writes the terminal refused with EAGAIN
+    long wouldBlock = 0;
+    // Frames folded into a later one because output was still pending
+    long coalesced = 0;
+};
+
+class Renderer
+{
+public:
+    virtual ~Renderer() {}
+
+    virtual Surface* createSurface(int height, int width, int startY, int startX) = 0;
+    virtual void getScreenSize(int& height, int& width) const = 0;
+
+    virtual bool hasColors() const = 0;
+    virtual void initColorPair(short pair, short foreground, short background) = 0;
+
+    // Send everything drawn since the last call to the terminal
+    virtual void present() = 0;
+
+    // Non-blocking, returns ERR when no key is waiting
+    virtual int readKey() = 0;
+    // Blocks until a key arrives
+    virtual int waitKey() = 0;
+
+    virtual const RenderStats& getStats() const = 0;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+// splitmix64 finalizer, turns any number into well spread 64 bits
+inline uint64_t mixBits(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Small seeded generator (xorshift64*). Unlike rand() it can be copied,
+// stored and replayed, so a simulation using it is reproducible.
+class Rng
+{
+public:
+    explicit Rng(uint64_t seed = 1)
+    {
+        this->seed(seed);
+    }
+
+    void seed(uint64_t seed)
+    {
+        // splitmix64 step so that small seeds still give a good state
+        this->mState = mixBits(seed + 0x9e3779b97f4a7c15ULL) | 1;
+    }
+
+    uint64_t next()
+    {
+        this->mState ^= this->mState >> 12;
+        this->mState ^= this->mState << 25;
+        this->mState ^= this->mState >> 27;
+        return this->mState * 0x2545f4914f6cdd1dULL;
+    }
+
+    // Uniform in [0, bound)
+    int nextInt(int bound)
+    {
+        return static_cast<int>((this->next() >> 32) % static_cast<uint64_t>(bound));
+    }
+
+    uint64_t getState() const
+    {
+        return this->mState;
+    }
+
+private:
+    uint64_t mState;
+};
+
+#endif
@@ -0,0 +1,632 @@
+// Authoritative snake-server: runs one World, takes steering input from
+// TCP clients and broadcasts each tick as a delta (see protocol.h).
+// Every player steers its own snake, bots fill the rest of the board.
+// Spectators get the same stream without a snake. One epoll loop serves
+// everyone and each tick is encoded once for all of them.
+//
+//   snake-server [--host H] [--port P] [--width W] [--height H] [--map I]
+//                [--tick MS] [--bots N] [--length N] [--seed S] [--stats SEC]
+//
+// The default board is what snakegame shows on an 80x24 terminal.
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "world.h"
+#include "bot.h"
+#include "net.h"
+#include "protocol.h"
+
+namespace
+{
+    struct Options
+    {
+        std::string host = "127.0.0.1";
+        int port = 7777;
+        int width = 62;
+        int height = 18;
+        int map = 0;
+        int tickMillis = 100;
+        int bots = 7;
+        int length = 2;
+        unsigned seed = 0;
+        int statsSeconds = 0;
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+        options.seed = std::time(nullptr);
+        for (int i = 1; i < argc; i ++)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--host" && hasValue) options.host = argv[++ i];
+            else if (arg == "--port" && hasValue) options.port = std::atoi(argv[++ i]);
+            else if (arg == "--width" && hasValue) options.width = std::atoi(argv[++ i]);
+            else if (arg == "--height" && hasValue) options.height = std::atoi(argv[++ i]);
+            else if (arg == "--map" && hasValue) options.map = std::atoi(argv[++ i]);
+            else if (arg == "--tick" && hasValue) options.tickMillis = std::max(1, std::atoi(argv[++ i]));
+            else if (arg == "--bots" && hasValue) options.bots = std::atoi(argv[++ i]);
+            else if (arg == "--length" && hasValue) options.length = std::atoi(argv[++ i]);
+            else if (arg == "--seed" && hasValue) options.seed = std::atoi(argv[++ i]);
+            else if (arg == "--stats" && hasValue) options.statsSeconds = std::atoi(argv[++ i]);
+            else
+            {
+                std::cerr << "usage: " << argv[0]
+                          << " [--host H] [--port P] [--width W] [--height H] [--map I] [--tick MS]"
+                          << " [--bots N] [--length N] [--seed S] [--stats SEC]" << std::endl;
+                std::exit(1);
+            }
+        }
+        return options;
+    }
+
+    // A connection that stops reading loses its queued ticks and gets a
+    // keyframe once it drains, so memory stays bounded per connection
+    const size_t kMaxQueuedFrames = 64;
+    const int kSpectatorSendBuffer = 16 * 1024;
+    // Inputs further ahead than this are not kept
+    const size_t kMaxPendingInputs = 64;
+    // Frames handed to one writev()
+    const int kMaxIovecs = 16;
+
+    // Tick timings kept for STATS and the stats line
+    const size_t kMaxTickSamples = 1 << 16;
+
+    volatile std::sig_atomic_t gStop = 0;
+
+    void onSignal(int)
+    {
+        gStop = 1;
+    }
+
+    // Encoded once per tick and shared by every connection sending it
+    typedef std::shared_ptr<const std::string> Frame;
+
+    struct Client
+    {
+        int fd;
+        // -1 for spectators and before HELLO
+        int snakeId;
+        bool joined;
+        FrameReader reader;
+        // Turns by the tick they are meant for, clients predict ahead
+        std::map<uint32_t, Direction> inputs;
+        std::deque<Frame> queue;
+        // Bytes of queue.front() already written
+        size_t offset;
+        bool needsKeyframe;
+        // EPOLLOUT is only asked for while something is queued
+        bool writing;
+        bool closed;
+    };
+
+    uint32_t percentile(std::vector<uint32_t> values, double p)
+    {
+        if (values.empty())
+        {
+            return 0;
+        }
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+    }
+
+    // How long ticks take and how late they start, since the last take()
+    class TickTimes
+    {
+    public:
+        TickTimes() : mTicks(0), mLateTicks(0) {}
+
+        void add(std::chrono::steady_clock::duration late, std::chrono::steady_clock::duration work,
+                 std::chrono::steady_clock::duration tick)
+        {
+            // Only the newest samples count when nobody asks for a while
+            if (this->mWork.size() >= kMaxTickSamples)
+            {
+                this->mWork.erase(this->mWork.begin(), this->mWork.begin() + kMaxTickSamples / 2);
+                this->mLate.erase(this->mLate.begin(), this->mLate.begin() + kMaxTickSamples / 2);
+            }
+            this->mWork.push_back(std::chrono::duration_cast<std::chrono::microseconds>(work).count());
+            this->mLate.push_back(std::chrono::duration_cast<std::chrono::microseconds>(late).count());
+            this->mTicks ++;
+            if (late >= tick)
+            {
+                this->mLateTicks ++;
+            }
+        }
+
+        ServerStats peek(size_t clients) const
+        {
+            ServerStats stats;
+            stats.ticks = this->mTicks;
+            stats.clients = clients;
+            stats.tickMicrosP50 = percentile(this->mWork, 0.5);
+            stats.tickMicrosP99 = percentile(this->mWork, 0.99);
+            stats.tickMicrosMax = this->mWork.empty() ? 0 : *std::max_element(this->mWork.begin(), this->mWork.end());
+            stats.lateMicrosP99 = percentile(this->mLate, 0.99);
+            stats.lateTicks = this->mLateTicks;
+            return stats;
+        }
+
+        ServerStats take(size_t clients)
+        {
+            ServerStats stats = this->peek(clients);
+            this->mWork.clear();
+            this->mLate.clear();
+            this->mTicks = 0;
+            this->mLateTicks = 0;
+            return stats;
+        }
+
+    private:
+        std::vector<uint32_t> mWork;
+        std::vector<uint32_t> mLate;
+        uint32_t mTicks;
+        uint32_t mLateTicks;
+    };
+
+    class Server
+    {
+    public:
+        Server(const Options& options, std::vector<Obstacle> obstacles)
+            : mOptions(options),
+              mWorld(options.width, options.height, obstacles, options.seed),
+              mListen(-1), mEpoll(-1), mSpectators(0), mDeltaBytes(0), mMaxDelta(0),
+              mTicks(0), mResyncs(0), mBytesSent(0)
+        {
+            this->mWorld.setRecordEvents(true);
+            for (int i = 0; i < options.bots; i ++)
+            {
+                int id = this->mWorld.spawnSnake(options.length, false);
+                if (id >= 0)
+                {
+                    this->mOwned.resize(id + 1, false);
+                }
+            }
+            this->mWorld.setFoodCount(std::max(1, (options.bots + 1) / 2));
+        }
+
+        ~Server()
+        {
+            for (auto& entry : this->mClients)
+            {
+                close(entry.first);
+            }
+            if (this->mListen >= 0)
+            {
+                close(this->mListen);
+            }
+            if (this->mEpoll >= 0)
+            {
+                close(this->mEpoll);
+            }
+        }
+
+        bool listen()
+        {
+            this->mListen = listenTcp(this->mOptions.host, this->mOptions.port);
+            this->mEpoll = epoll_create1(0);
+            if (this->mListen < 0 || this->mEpoll < 0)
+            {
+                return false;
+            }
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = this->mListen;
+            return epoll_ctl(this->mEpoll, EPOLL_CTL_ADD, this->mListen, &event) == 0;
+        }
+
+        void run()
+        {
+            epoll_event events[256];
+            auto nextTick = std::chrono::steady_clock::now();
+            auto nextStats = nextTick + std::chrono::seconds(this->mOptions.statsSeconds);
+            while (!gStop)
+            {
+                auto now = std::chrono::steady_clock::now();
+                int timeout = std::max<long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(nextTick - now).count());
+                int count = epoll_wait(this->mEpoll, events, 256, timeout);
+                if (count < 0 && errno != EINTR)
+                {
+                    break;
+                }
+                for (int i = 0; i < count; i ++)
+                {
+                    int fd = events[i].data.fd;
+                    if (fd == this->mListen)
+                    {
+                        this->accept();
+                        continue;
+                    }
+                    auto found = this->mClients.find(fd);
+                    if (found == this->mClients.end())
+                    {
+                        continue;
+                    }
+                    Client& client = *found->second;
+                    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    {
+                        this->receive(client);
+                    }
+                    if ((events[i].events & EPOLLOUT) && !client.closed)
+                    {
+                        this->flush(client);
+                    }
+                }
+
+                now = std::chrono::steady_clock::now();
+                if (now >= nextTick)
+                {
+                    this->tick();
+                    this->mTimes.add(now - nextTick, std::chrono::steady_clock::now() - now,
+                                     std::chrono::milliseconds(this->mOptions.tickMillis));
+                    nextTick += std::chrono::milliseconds(this->mOptions.tickMillis);
+                    // After a long stall start over instead of catching up
+                    if (nextTick < now)
+                    {
+                        nextTick = now + std::chrono::milliseconds(this->mOptions.tickMillis);
+                    }
+                }
+                if (this->mOptions.statsSeconds > 0 && now >= nextStats)
+                {
+                    this->printStats();
+                    nextStats = now + std::chrono::seconds(this->mOptions.statsSeconds);
+                }
+                this->removeClosed();
+            }
+            this->printStats();
+        }
+
+    private:
+        void accept()
+        {
+            int fd;
+            while ((fd = accept4(this->mListen, nullptr, nullptr, SOCK_NONBLOCK)) >= 0)
+            {
+                setNoDelay(fd);
+                epoll_event event = {};
+                event.events = EPOLLIN;
+                event.data.fd = fd;
+                if (epoll_ctl(this->mEpoll, EPOLL_CTL_ADD, fd, &event) != 0)
+                {
+                    close(fd);
+                    continue;
+                }
+                Client* client = new Client{fd, -1, false, FrameReader(), std::map<uint32_t, Direction>(),
+                                            std::deque<Frame>(), 0, false, false, false};
+                this->mClients[fd].reset(client);
+            }
+        }
+
+        void receive(Client& client)
+        {
+            char buffer[4096];
+            ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+            {
+                this->closeClient(client);
+                return;
+            }
+            if (n < 0)
+            {
+                return;
+            }
+            client.reader.feed(buffer, n);
+            std::string payload;
+            while (!client.closed && client.reader.next(payload))
+            {
+                Direction direction;
+                uint32_t tick;
+                MessageType type = messageType(payload);
+                if (!client.joined && (type == MessageType::HELLO || type == MessageType::WATCH))
+                {
+                    this->join(client, type == MessageType::WATCH);
+                }
+                else if (client.snakeId >= 0 && decodeInput(payload, direction, tick))
+                {
+                    if (client.inputs.size() < kMaxPendingInputs)
+                    {
+                        client.inputs[tick] = direction;
+                    }
+                }
+                else if (type == MessageType::STATS)
+                {
+                    ServerStats stats = this->mTimes.take(this->mClients.size());
+                    this->enqueue(client, std::make_shared<const std::string>(encodeServerStats(stats)));
+                    this->flush(client);
+                }
+                else if (type == MessageType::PING && decodePing(payload, tick))
+                {
+                    this->enqueue(client, std::make_shared<const std::string>(encodePing(MessageType::PONG, tick)));
+                    this->flush(client);
+                }
+                else
+                {
+                    this->closeClient(client);
+                }
+            }
+            if (!client.closed && client.reader.isBroken())
+            {
+                this->closeClient(client);
+            }
+        }
+
+        void join(Client& client, bool spectator)
+        {
+            int id = -1;
+            if (!spectator)
+            {
+                // Take over the snake of someone who left before adding one
+                const std::vector<WorldSnake>& snakes = this->mWorld.getSnakes();
+                for (int i = 0; i < snakes.size() && id < 0; i ++)
+                {
+                    if (snakes[i].human && !this->mOwned[i] && this->mWorld.respawnSnake(i, this->mOptions.length))
+                    {
+                        id = i;
+                    }
+                }
+                if (id < 0)
+                {
+                    id = this->mWorld.spawnSnake(this->mOptions.length, true);
+                }
+                if (id < 0)
+                {
+                    this->closeClient(client);
+                    return;
+                }
+                this->mOwned.resize(std::max<size_t>(this->mOwned.size(), id + 1), false);
+                this->mOwned[id] = true;
+            }
+            else
+            {
+                // Left alone the kernel would buffer minutes of ticks for a
+                // stalled viewer before our own queue noticed
+                int size = kSpectatorSendBuffer;
+                setsockopt(client.fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+                this->mSpectators ++;
+            }
+            client.snakeId = id;
+            client.joined = true;
+            // A spawn also goes out with the next delta, applying it twice
+            // on the replica is harmless
+            this->enqueue(client, std::make_shared<const std::string>(encodeWelcome(this->mWorld, id, this->mOptions.tickMillis)));
+            this->enqueue(client, std::make_shared<const std::string>(encodeKeyframe(this->mWorld)));
+            this->flush(client);
+        }
+
+        void tick()
+        {
+            // Inputs for this step, and late ones for earlier steps, in order.
+            // Same rule as local play, so a reversing key is ignored.
+            uint32_t next = this->mWorld.getTick() + 1;
+            for (auto& entry : this->mClients)
+            {
+                Client& client = *entry.second;
+                while (client.snakeId >= 0 && !client.inputs.empty() && client.inputs.begin()->first <= next)
+                {
+                    this->mWorld.turn(client.snakeId, client.inputs.begin()->second);
+                    client.inputs.erase(client.inputs.begin());
+                }
+            }
+
+            const std::vector<WorldSnake>& snakes = this->mWorld.getSnakes();
+            for (int i = 0; i < snakes.size(); i ++)
+            {
+                if (snakes[i].human && !this->mOwned[i])
+                {
+                    continue;
+                }
+                // Players come back at once too, there are no rounds here
+                bool alive = snakes[i].alive || this->mWorld.respawnSnake(i, this->mOptions.length);
+                if (alive && !snakes[i].human)
+                {
+                    this->mWorld.turn(i, chooseGreedyMove(this->mWorld, i));
+                }
+            }
+            this->mWorld.step();
+            this->mWorld.takeEvents(this->mEvents);
+
+            // Encoded once, every connection gets the same bytes. The
+            // keyframe is only built when someone has to resync.
+            Frame delta = std::make_shared<const std::string>(encodeDelta(this->mWorld.getTick(), this->mEvents));
+            Frame keyframe;
+            this->mTicks ++;
+            this->mDeltaBytes += delta->size();
+            this->mMaxDelta = std::max(this->mMaxDelta, delta->size());
+            for (auto& entry : this->mClients)
+            {
+                Client& client = *entry.second;
+                if (!client.joined || client.closed)
+                {
+                    continue;
+                }
+                if (client.needsKeyframe)
+                {
+                    if (!keyframe)
+                    {
+                        keyframe = std::make_shared<const std::string>(encodeKeyframe(this->mWorld));
+                    }
+                    client.needsKeyframe = false;
+                    this->mResyncs ++;
+                    this->enqueue(client, keyframe);
+                }
+                else
+                {
+                    this->enqueue(client, delta);
+                }
+                this->flush(client);
+            }
+        }
+
+        void enqueue(Client& client, const Frame& frame)
+        {
+            if (client.queue.size() >= kMaxQueuedFrames)
+            {
+                // Keep a half written frame so the stream stays parseable
+                Frame partial = client.offset > 0 ? client.queue.front() : Frame();
+                client.queue.clear();
+                if (partial)
+                {
+                    client.queue.push_back(partial);
+                }
+                client.needsKeyframe = true;
+                return;
+            }
+            client.queue.push_back(frame);
+        }
+
+        void flush(Client& client)
+        {
+            while (!client.queue.empty())
+            {
+                iovec iov[kMaxIovecs];
+                int count = std::min<int>(kMaxIovecs, client.queue.size());
+                for (int i = 0; i < count; i ++)
+                {
+                    size_t skip = i == 0 ? client.offset : 0;
+                    iov[i].iov_base = const_cast<char*>(client.queue[i]->data()) + skip;
+                    iov[i].iov_len = client.queue[i]->size() - skip;
+                }
+                ssize_t n = writev(client.fd, iov, count);
+                if (n < 0)
+                {
+                    if (errno != EAGAIN && errno != EINTR)
+                    {
+                        this->closeClient(client);
+                        return;
+                    }
+                    break;
+                }
+                this->mBytesSent += n;
+                size_t written = n + client.offset;
+                while (!client.queue.empty() && written >= client.queue.front()->size())
+                {
+                    written -= client.queue.front()->size();
+                    client.queue.pop_front();
+                }
+                client.offset = written;
+            }
+            bool writing = !client.queue.empty();
+            if (writing != client.writing)
+            {
+                epoll_event event = {};
+                event.events = EPOLLIN | (writing ? EPOLLOUT : 0);
+                event.data.fd = client.fd;
+                epoll_ctl(this->mEpoll, EPOLL_CTL_MOD, client.fd, &event);
+                client.writing = writing;
+            }
+        }
+
+        void closeClient(Client& client)
+        {
+            if (!client.closed)
+            {
+                client.closed = true;
+                this->mClosed.push_back(client.fd);
+            }
+        }
+
+        void removeClosed()
+        {
+            for (int fd : this->mClosed)
+            {
+                Client& client = *this->mClients[fd];
+                if (client.snakeId >= 0)
+                {
+                    this->mWorld.killSnake(client.snakeId);
+                    this->mOwned[client.snakeId] = false;
+                }
+                else if (client.joined)
+                {
+                    this->mSpectators --;
+                }
+                // Closing also takes it out of the epoll set
+                close(fd);
+                this->mClients.erase(fd);
+            }
+            this->mClosed.clear();
+        }
+
+        void printStats() const
+        {
+            double average = this->mTicks > 0 ? static_cast<double>(this->mDeltaBytes) / this->mTicks : 0;
+            ServerStats times = this->mTimes.peek(this->mClients.size());
+            std::cerr << "tick " << this->mWorld.getTick()
+                      << " clients " << this->mClients.size()
+                      << " spectators " << this->mSpectators
+                      << " snakes " << this->mWorld.getAliveCount()
+                      << " bytes/client/tick avg " << average
+                      << " max " << this->mMaxDelta
+                      << " resyncs " << this->mResyncs
+                      << " tick us p50 " << times.tickMicrosP50
+                      << " p99 " << times.tickMicrosP99
+                      << " late " << times.lateTicks
+                      << " sent " << this->mBytesSent << std::endl;
+        }
+
+        Options mOptions;
+        World mWorld;
+        int mListen;
+        int mEpoll;
+        std::unordered_map<int, std::unique_ptr<Client>> mClients;
+        std::vector<int> mClosed;
+        // Human snakes whose player is still connected
+        std::vector<bool> mOwned;
+        std::vector<WorldEvent> mEvents;
+        int mSpectators;
+        uint64_t mDeltaBytes;
+        size_t mMaxDelta;
+        uint64_t mTicks;
+        uint64_t mResyncs;
+        uint64_t mBytesSent;
+        TickTimes mTimes;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    Options options = parseOptions(argc, argv);
+    std::vector<GameMap> maps = GameMap::getDefaultMaps(options.width, options.height, options.seed);
+    std::vector<Obstacle> obstacles;
+    if (options.map >= 0 && options.map < maps.size())
+    {
+        obstacles = maps[options.map].getObstacles();
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    // One descriptor per connection, thousands of them under load
+    rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max)
+    {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    Server server(options, obstacles);
+    if (!server.listen())
+    {
+        std::cerr << "cannot listen on " << options.host << ":" << options.port << std::endl;
+        return 1;
+    }
+    server.run();
+    return 0;
+}
@@ -33,14 +33,8 @@ bool SnakeBody::operator == (const SnakeBody& snakeBody)
 
 Snake::Snake(int gameBoardWidth, int gameBoardHeight, int initialSnakeLength): mGameBoardWidth(gameBoardWidth), mGameBoardHeight(gameBoardHeight), mInitialSnakeLength(initialSnakeLength)
 {
+    // Randomness lives in the game's Rng, the snake itself is deterministic
     this->initializeSnake();
-    this->setRandomSeed();
-}
-
-void Snake::setRandomSeed()
-{
-    // use current time as seed for random generator
-    std::srand(std::time(nullptr));
 }
 
 void Snake::initializeSnake()
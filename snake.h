@@ -31,8 +31,6 @@ class Snake
 public:
     //Snake();
     Snake(int gameBoardWidth, int gameBoardHeight, int initialSnakeLength);
-    // Set random seed
-    void setRandomSeed();
     // Initialize snake
     void initializeSnake();
     // Checking API for generating random food
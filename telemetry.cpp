@@ -0,0 +1,292 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "telemetry.h"
+
+namespace
+{
+    enum EventType
+    {
+        // detail: mode. values: map index, snake length, delay, width,
+        // height, then the seed and the map name (length, bytes)
+        GAME_START = 1,
+        // values: x, y, points after eating
+        FOOD = 2,
+        // detail: new Direction
+        TURN = 3,
+        // detail: 1 paused, 0 resumed
+        PAUSE = 4,
+        // detail: DeathCause as numbered in world.h. values: points, length,
+        // then the ClassicState hash of the board it happened on
+        DEATH = 5,
+        // Written by the writer thread. seed: events dropped so far
+        DROPPED = 6,
+    };
+
+    const char kMagic[] = {'S', 'N', 'K', 'T', 2};
+    const long kMaxFileBytes = 4L << 20;
+    const int kKeptFiles = 4;
+    const int kIdleMillis = 20;
+
+    // Values each event type carries
+    int valueCount(uint8_t type)
+    {
+        switch (type)
+        {
+            case GAME_START:
+                return 5;
+            case FOOD:
+                return 3;
+            case DEATH:
+                return 2;
+            default:
+                return 0;
+        }
+    }
+
+    void putVarint(std::string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    TelemetryEvent makeEvent(uint8_t type, uint32_t tick, uint8_t detail)
+    {
+        TelemetryEvent event;
+        std::memset(&event, 0, sizeof(event));
+        event.type = type;
+        event.tick = tick;
+        event.detail = detail;
+        return event;
+    }
+}
+
+TelemetryQueue::TelemetryQueue() : mHead(0), mTail(0)
+{
+}
+
+bool TelemetryQueue::push(const TelemetryEvent& event)
+{
+    uint32_t tail = this->mTail.load(std::memory_order_relaxed);
+    if (tail - this->mHead.load(std::memory_order_acquire) == kCapacity)
+    {
+        return false;
+    }
+    this->mSlots[tail % kCapacity] = event;
+    this->mTail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool TelemetryQueue::pop(TelemetryEvent& event)
+{
+    uint32_t head = this->mHead.load(std::memory_order_relaxed);
+    if (head == this->mTail.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    event = this->mSlots[head % kCapacity];
+    this->mHead.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+Telemetry::Telemetry() : mRunning(false), mDropped(0), mFileBytes(0)
+{
+}
+
+Telemetry::~Telemetry()
+{
+    this->stop();
+}
+
+bool Telemetry::start(const std::string& path)
+{
+    this->mPath = path;
+    std::ifstream previous(path, std::ios::binary | std::ios::ate);
+    if (previous.is_open() && previous.tellg() > 0)
+    {
+        previous.close();
+        this->shiftLogs();
+    }
+    if (!this->openLog())
+    {
+        return false;
+    }
+    this->mRunning = true;
+    this->mThread = std::thread(&Telemetry::run, this);
+    return true;
+}
+
+void Telemetry::stop()
+{
+    if (!this->mThread.joinable())
+    {
+        return;
+    }
+    // The writer drains the queue before it leaves
+    this->mRunning = false;
+    this->mThread.join();
+    this->mFile.close();
+}
+
+void Telemetry::push(TelemetryEvent& event)
+{
+    if (!this->mRunning.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    if (!this->mQueue.push(event))
+    {
+        this->mDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Telemetry::gameStart(int mode, int mapIndex, const std::string& mapName, int snakeLength,
+                          int delayMillis, int width, int height, uint64_t seed)
+{
+    TelemetryEvent event = makeEvent(GAME_START, 0, mode);
+    event.values[0] = mapIndex;
+    event.values[1] = snakeLength;
+    event.values[2] = delayMillis;
+    event.values[3] = width;
+    event.values[4] = height;
+    event.seed = seed;
+    // Longer names are cut, the map index still tells them apart
+    std::strncpy(event.name, mapName.c_str(), sizeof(event.name));
+    this->push(event);
+}
+
+void Telemetry::foodEaten(uint32_t tick, int x, int y, int points)
+{
+    TelemetryEvent event = makeEvent(FOOD, tick, 0);
+    event.values[0] = x;
+    event.values[1] = y;
+    event.values[2] = points;
+    this->push(event);
+}
+
+void Telemetry::directionChange(uint32_t tick, Direction direction)
+{
+    TelemetryEvent event = makeEvent(TURN, tick, static_cast<uint8_t>(direction));
+    this->push(event);
+}
+
+void Telemetry::pause(uint32_t tick, bool paused)
+{
+    TelemetryEvent event = makeEvent(PAUSE, tick, paused ? 1 : 0);
+    this->push(event);
+}
+
+void Telemetry::death(uint32_t tick, DeathCause cause, int points, int length, uint64_t stateHash)
+{
+    TelemetryEvent event = makeEvent(DEATH, tick, static_cast<uint8_t>(cause));
+    event.values[0] = points;
+    event.values[1] = length;
+    event.seed = stateHash;
+    this->push(event);
+}
+
+uint64_t Telemetry::getDropped() const
+{
+    return this->mDropped.load(std::memory_order_relaxed);
+}
+
+void Telemetry::run()
+{
+    std::string out;
+    uint64_t reportedDrops = 0;
+    TelemetryEvent event;
+    while (true)
+    {
+        // Read the flag first so nothing pushed before stop() is missed
+        bool running = this->mRunning.load();
+        out.clear();
+        while (this->mQueue.pop(event))
+        {
+            this->encode(event, out);
+        }
+        uint64_t dropped = this->getDropped();
+        if (dropped != reportedDrops)
+        {
+            TelemetryEvent drops = makeEvent(DROPPED, 0, 0);
+            drops.seed = dropped;
+            this->encode(drops, out);
+            reportedDrops = dropped;
+        }
+        if (!out.empty())
+        {
+            if (this->mFileBytes + static_cast<long>(out.size()) > kMaxFileBytes)
+            {
+                this->rotate();
+            }
+            this->mFile.write(out.data(), out.size());
+            this->mFile.flush();
+            this->mFileBytes += out.size();
+        }
+        if (!running)
+        {
+            return;
+        }
+        if (out.empty())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(kIdleMillis));
+        }
+    }
+}
+
+void Telemetry::encode(const TelemetryEvent& event, std::string& out) const
+{
+    out.push_back(static_cast<char>(event.type));
+    out.push_back(static_cast<char>(event.detail));
+    putVarint(out, event.tick);
+    for (int i = 0; i < valueCount(event.type); i ++)
+    {
+        // Zigzag, so small negative values stay small too
+        int32_t value = event.values[i];
+        putVarint(out, (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+    }
+    if (event.type == GAME_START || event.type == DEATH || event.type == DROPPED)
+    {
+        putVarint(out, event.seed);
+    }
+    if (event.type == GAME_START)
+    {
+        size_t length = strnlen(event.name, sizeof(event.name));
+        putVarint(out, length);
+        out.append(event.name, length);
+    }
+}
+
+bool Telemetry::openLog()
+{
+    this->mFile.open(this->mPath, std::ios::binary | std::ios::trunc | std::ios::out);
+    if (!this->mFile.is_open())
+    {
+        return false;
+    }
+    this->mFile.write(kMagic, sizeof(kMagic));
+    this->mFileBytes = sizeof(kMagic);
+    return true;
+}
+
+void Telemetry::rotate()
+{
+    this->mFile.close();
+    this->shiftLogs();
+    this->openLog();
+}
+
+void Telemetry::shiftLogs()
+{
+    std::remove((this->mPath + "." + std::to_string(kKeptFiles)).c_str());
+    for (int i = kKeptFiles - 1; i >= 1; i --)
+    {
+        std::rename((this->mPath + "." + std::to_string(i)).c_str(),
+                    (this->mPath + "." + std::to_string(i + 1)).c_str());
+    }
+    std::rename(this->mPath.c_str(), (this->mPath + ".1").c_str());
+}
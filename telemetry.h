@@ -0,0 +1,95 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "snake.h"
+#include "world.h"
+
+// Fixed-size slot of the queue, which fields mean what depends on type
+struct TelemetryEvent
+{
+    uint8_t type;
+    uint8_t detail;
+    uint32_t tick;
+    int32_t values[5];
+    uint64_t seed;
+    char name[16];
+};
+
+// Lock-free queue between exactly one producer and one consumer
+class TelemetryQueue
+{
+public:
+    TelemetryQueue();
+    // Producer side, false when the queue is full
+    bool push(const TelemetryEvent& event);
+    // Consumer side, false when the queue is empty
+    bool pop(TelemetryEvent& event);
+
+private:
+    static const uint32_t kCapacity = 4096;
+    TelemetryEvent mSlots[kCapacity];
+    // Each index on its own cache line, they are written by different threads
+    alignas(64) std::atomic<uint32_t> mHead;
+    alignas(64) std::atomic<uint32_t> mTail;
+};
+
+// Game events for balancing, written to a compact binary log.
+//
+// The game thread only copies an event into the queue. A writer thread
+// encodes it and appends it to path. Once that file reaches its size
+// limit it becomes path.1, older files move up to path.4, and the oldest
+// is deleted. start() moves a log left by the last session up the same
+// way, so a new launch never overwrites one. Recording never waits. An
+// event that finds the queue full is dropped and counted, and the count
+// goes into the log.
+//
+// A file starts with the bytes "SNKT" and a version byte. Then come
+// records: a type byte, a detail byte, the tick as a varint and the
+// values listed in telemetry.cpp.
+class Telemetry
+{
+public:
+    Telemetry();
+    ~Telemetry();
+
+    // Nothing is recorded before this is called
+    bool start(const std::string& path);
+    void stop();
+
+    // mode is the Game::GameMode value
+    void gameStart(int mode, int mapIndex, const std::string& mapName, int snakeLength,
+                   int delayMillis, int width, int height, uint64_t seed);
+    void foodEaten(uint32_t tick, int x, int y, int points);
+    void directionChange(uint32_t tick, Direction direction);
+    void pause(uint32_t tick, bool paused);
+    // stateHash lets a replay of the game check it ended on the same board
+    void death(uint32_t tick, DeathCause cause, int points, int length, uint64_t stateHash);
+
+    uint64_t getDropped() const;
+
+private:
+    void push(TelemetryEvent& event);
+    void run();
+    // Encodes one event into the pending output
+    void encode(const TelemetryEvent& event, std::string& out) const;
+    bool openLog();
+    void rotate();
+    // path becomes path.1 and so on, the oldest is deleted
+    void shiftLogs();
+
+    TelemetryQueue mQueue;
+    std::atomic<bool> mRunning;
+    std::atomic<uint64_t> mDropped;
+    std::thread mThread;
+    std::string mPath;
+    std::ofstream mFile;
+    long mFileBytes;
+};
+
+#endif
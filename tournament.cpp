@@ -0,0 +1,446 @@
+// snake-tournament: round robin between bot strategies on every map of a
+// map set, for gating bot changes. Each pair of bots plays one match per
+// map and seed, twice with the seats swapped, two snakes alone on the
+// board. A match ends when a snake dies and the other one wins. When both
+// die on the same tick, or both are still alive after --ticks, the one
+// that ate more wins and equal food is a draw.
+//
+// Every pair plays the same boards: a match's seed comes from --seed, the
+// map and the seed number only. Matches run on all cores and are tallied
+// in a fixed order, so the same arguments always print the same standings
+// whatever --threads is.
+//
+// Standings go to stdout as JSON, and to --csv FILE as well if asked for.
+// A bot's score is its points per match, a win 1 and a draw 0.5, with a
+// 95% Wilson interval. The two seats of one board are one sample there,
+// as they share the seed and the map.
+//
+//   snake-tournament [--bot SPEC]... [--map-file PATH]... [--no-default-maps]
+//                    [--seeds N] [--ticks T] [--foods N] [--width W]
+//                    [--height H] [--threads T] [--seed S] [--csv FILE]
+//
+// A SPEC is greedy, random, weighted for the default BotWeights or
+// weighted=FOOD,AREA,TAIL,WALL as printed by snake-tune. Without --bot
+// the three plain ones play. Map files are described at GameMap::loadFile.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "world.h"
+#include "bot.h"
+#include "parallel.h"
+#include "rng.h"
+
+namespace
+{
+    struct Options
+    {
+        std::vector<std::string> bots;
+        std::vector<std::string> mapFiles;
+        bool defaultMaps = true;
+        int seeds = 20;
+        int ticks = 2000;
+        int foods = 2;
+        int width = 62;
+        int height = 18;
+        int threads = 0;
+        uint64_t seed = 1;
+        std::string csv;
+    };
+
+    struct Strategy
+    {
+        enum class Kind
+        {
+            GREEDY,
+            RANDOM,
+            WEIGHTED,
+        };
+        std::string name;
+        Kind kind;
+        BotWeights weights;
+    };
+
+    struct Match
+    {
+        int bots[2];
+        int map;
+        uint64_t seed;
+    };
+
+    struct MatchResult
+    {
+        // Seat that won, -1 for a draw
+        int winner;
+        int food[2];
+    };
+
+    // Points of one bot over a set of matches
+    struct Tally
+    {
+        int matches = 0;
+        int wins = 0;
+        int draws = 0;
+        long food = 0;
+
+        void add(double points, int eaten)
+        {
+            this->matches ++;
+            this->wins += points == 1;
+            this->draws += points == 0.5;
+            this->food += eaten;
+        }
+
+        double getScore() const
+        {
+            return this->matches == 0 ? 0 : (this->wins + 0.5 * this->draws) / this->matches;
+        }
+
+        // Ends of the 95% Wilson interval around getScore, -1 for the low
+        // one and 1 for the high one. Every board is played from both
+        // seats, so the samples are half the matches. Points lie in [0, 1],
+        // so score * (1 - score) bounds their variance as it does for
+        // plain wins and losses.
+        double getBound(int side) const
+        {
+            double samples = this->matches / 2;
+            if (samples == 0)
+            {
+                return side < 0 ? 0 : 1;
+            }
+            double z = 1.96;
+            double score = this->getScore();
+            double scale = 1 + z * z / samples;
+            double centre = (score + z * z / (2 * samples)) / scale;
+            double margin = z / scale * std::sqrt(score * (1 - score) / samples + z * z / (4 * samples * samples));
+            return std::min(1.0, std::max(0.0, centre + side * margin));
+        }
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; i ++)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--bot" && hasValue) options.bots.push_back(argv[++ i]);
+            else if (arg == "--map-file" && hasValue) options.mapFiles.push_back(argv[++ i]);
+            else if (arg == "--no-default-maps") options.defaultMaps = false;
+            else if (arg == "--seeds" && hasValue) options.seeds = std::atoi(argv[++ i]);
+            else if (arg == "--ticks" && hasValue) options.ticks = std::atoi(argv[++ i]);
+            else if (arg == "--foods" && hasValue) options.foods = std::atoi(argv[++ i]);
+            else if (arg == "--width" && hasValue) options.width = std::atoi(argv[++ i]);
+            else if (arg == "--height" && hasValue) options.height = std::atoi(argv[++ i]);
+            else if (arg == "--threads" && hasValue) options.threads = std::atoi(argv[++ i]);
+            else if (arg == "--seed" && hasValue) options.seed = std::atoll(argv[++ i]);
+            else if (arg == "--csv" && hasValue) options.csv = argv[++ i];
+            else
+            {
+                std::cerr << "usage: " << argv[0]
+                          << " [--bot SPEC]... [--map-file PATH]... [--no-default-maps] [--seeds N] [--ticks T] [--foods N] [--width W] [--height H] [--threads T] [--seed S] [--csv FILE]" << std::endl;
+                std::exit(1);
+            }
+        }
+        if (options.bots.empty())
+        {
+            options.bots = {"greedy", "weighted", "random"};
+        }
+        options.seeds = std::max(1, options.seeds);
+        options.foods = std::max(1, options.foods);
+        if (options.threads <= 0)
+        {
+            options.threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        return options;
+    }
+
+    bool parseStrategy(const std::string& spec, Strategy& strategy)
+    {
+        strategy.name = spec;
+        if (spec == "greedy")
+        {
+            strategy.kind = Strategy::Kind::GREEDY;
+            return true;
+        }
+        if (spec == "random")
+        {
+            strategy.kind = Strategy::Kind::RANDOM;
+            return true;
+        }
+        strategy.kind = Strategy::Kind::WEIGHTED;
+        if (spec == "weighted")
+        {
+            return true;
+        }
+        if (spec.compare(0, 9, "weighted=") != 0)
+        {
+            return false;
+        }
+        // Same order snake-tune prints them in
+        std::istringstream in(spec.substr(9));
+        double* values[4] = {&strategy.weights.food, &strategy.weights.area, &strategy.weights.tail,
+                             &strategy.weights.wall};
+        for (int i = 0; i < 4; i ++)
+        {
+            char comma = ',';
+            if ((i > 0 && !(in >> comma)) || comma != ',' || !(in >> *values[i]))
+            {
+                return false;
+            }
+        }
+        return in.peek() == EOF;
+    }
+
+    Direction chooseMove(const Strategy& strategy, const World& world, int id, Rng& rng)
+    {
+        switch (strategy.kind) {
+            case Strategy::Kind::GREEDY:   return chooseGreedyMove(world, id);
+            case Strategy::Kind::RANDOM:   return chooseRandomMove(world, id, rng);
+            case Strategy::Kind::WEIGHTED: return chooseWeightedMove(world, id, strategy.weights);
+        }
+        return world.getSnakes()[id].movedDirection;
+    }
+
+    MatchResult playMatch(const Options& options, const std::vector<Strategy>& strategies,
+                          const std::vector<GameMap>& maps, const Match& match)
+    {
+        World world(options.width, options.height, maps[match.map].getObstacles(), match.seed);
+        MatchResult result;
+        result.winner = -1;
+        // A board too full for both snakes is nobody's match
+        if (world.spawnSnake(2, false) < 0 || world.spawnSnake(2, false) < 0)
+        {
+            result.food[0] = 0;
+            result.food[1] = 0;
+            return result;
+        }
+        world.setFoodCount(options.foods);
+        // Random moves get their own stream, so they do not shift the food
+        Rng rng(mixBits(match.seed));
+        const std::vector<WorldSnake>& snakes = world.getSnakes();
+        for (int tick = 0; tick < options.ticks && snakes[0].alive && snakes[1].alive; tick ++)
+        {
+            for (int seat = 0; seat < 2; seat ++)
+            {
+                world.turn(seat, chooseMove(strategies[match.bots[seat]], world, seat, rng));
+            }
+            world.step();
+        }
+        result.food[0] = snakes[0].score;
+        result.food[1] = snakes[1].score;
+        if (snakes[0].alive != snakes[1].alive)
+        {
+            result.winner = snakes[0].alive ? 0 : 1;
+        }
+        else if (result.food[0] != result.food[1])
+        {
+            result.winner = result.food[0] > result.food[1] ? 0 : 1;
+        }
+        return result;
+    }
+
+    std::string quoteJson(const std::string& text)
+    {
+        std::string quoted = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                quoted += '\\';
+            }
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    std::string quoteCsv(const std::string& text)
+    {
+        std::string quoted = "\"";
+        for (char c : text)
+        {
+            quoted += c;
+            if (c == '"')
+            {
+                quoted += '"';
+            }
+        }
+        return quoted + "\"";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options = parseOptions(argc, argv);
+    std::vector<Strategy> strategies(options.bots.size());
+    for (int i = 0; i < strategies.size(); i ++)
+    {
+        if (!parseStrategy(options.bots[i], strategies[i]))
+        {
+            std::cerr << "unknown bot " << options.bots[i] << std::endl;
+            return 1;
+        }
+    }
+    if (strategies.size() < 2)
+    {
+        std::cerr << "a tournament needs two bots at least" << std::endl;
+        return 1;
+    }
+    std::vector<GameMap> maps;
+    if (options.defaultMaps)
+    {
+        maps = GameMap::getDefaultMaps(options.width, options.height, options.seed);
+    }
+    for (const std::string& path : options.mapFiles)
+    {
+        GameMap map;
+        if (!GameMap::loadFile(path, map))
+        {
+            std::cerr << "could not read " << path << std::endl;
+            return 1;
+        }
+        maps.push_back(map);
+    }
+    if (maps.empty())
+    {
+        std::cerr << "no maps to play on" << std::endl;
+        return 1;
+    }
+
+    std::vector<Match> matches;
+    for (int a = 0; a < strategies.size(); a ++)
+    {
+        for (int b = a + 1; b < strategies.size(); b ++)
+        {
+            for (int map = 0; map < maps.size(); map ++)
+            {
+                for (int seed = 0; seed < options.seeds; seed ++)
+                {
+                    Match match;
+                    match.map = map;
+                    match.seed = mixBits(mixBits(options.seed + map) + seed);
+                    // Spawn spots depend on the seat, so both get a turn
+                    match.bots[0] = a;
+                    match.bots[1] = b;
+                    matches.push_back(match);
+                    std::swap(match.bots[0], match.bots[1]);
+                    matches.push_back(match);
+                }
+            }
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<MatchResult> results(matches.size());
+    runParallel(matches.size(), options.threads, [&](int i) {
+        results[i] = playMatch(options, strategies, maps, matches[i]);
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << matches.size() << " matches on " << options.threads << " threads in " << seconds << "s" << std::endl;
+
+    int count = strategies.size();
+    std::vector<Tally> overall(count);
+    std::vector<Tally> byMap(count * maps.size());
+    std::vector<Tally> headToHead(count * count);
+    for (int i = 0; i < matches.size(); i ++)
+    {
+        const Match& match = matches[i];
+        const MatchResult& result = results[i];
+        for (int seat = 0; seat < 2; seat ++)
+        {
+            int bot = match.bots[seat];
+            int opponent = match.bots[1 - seat];
+            double points = result.winner < 0 ? 0.5 : result.winner == seat ? 1 : 0;
+            overall[bot].add(points, result.food[seat]);
+            byMap[bot * maps.size() + match.map].add(points, result.food[seat]);
+            headToHead[bot * count + opponent].add(points, result.food[seat]);
+        }
+    }
+    // Best score first, the order given on ties
+    std::vector<int> ranking(count);
+    for (int i = 0; i < count; i ++)
+    {
+        ranking[i] = i;
+    }
+    std::stable_sort(ranking.begin(), ranking.end(), [&](int a, int b) {
+        return overall[a].getScore() > overall[b].getScore();
+    });
+
+    std::cout << "{\"seed\":" << options.seed
+              << ",\"board\":[" << options.width << "," << options.height << "]"
+              << ",\"seeds\":" << options.seeds
+              << ",\"ticks\":" << options.ticks
+              << ",\"matches\":" << matches.size()
+              << ",\"maps\":[";
+    for (int map = 0; map < maps.size(); map ++)
+    {
+        std::cout << (map > 0 ? "," : "") << quoteJson(maps[map].getName());
+    }
+    std::cout << "],\"standings\":[";
+    for (int rank = 0; rank < count; rank ++)
+    {
+        int bot = ranking[rank];
+        const Tally& tally = overall[bot];
+        std::cout << (rank > 0 ? "," : "") << "{\"rank\":" << rank + 1
+                  << ",\"bot\":" << quoteJson(strategies[bot].name)
+                  << ",\"matches\":" << tally.matches
+                  << ",\"wins\":" << tally.wins
+                  << ",\"draws\":" << tally.draws
+                  << ",\"losses\":" << tally.matches - tally.wins - tally.draws
+                  << ",\"score\":" << tally.getScore()
+                  << ",\"ci95\":[" << tally.getBound(-1) << "," << tally.getBound(1) << "]"
+                  << ",\"food\":" << static_cast<double>(tally.food) / std::max(1, tally.matches)
+                  << ",\"byMap\":[";
+        for (int map = 0; map < maps.size(); map ++)
+        {
+            std::cout << (map > 0 ? "," : "") << byMap[bot * maps.size() + map].getScore();
+        }
+        std::cout << "],\"against\":[";
+        bool first = true;
+        for (int opponent : ranking)
+        {
+            if (opponent == bot)
+            {
+                continue;
+            }
+            const Tally& pair = headToHead[bot * count + opponent];
+            std::cout << (first ? "" : ",") << "{\"bot\":" << quoteJson(strategies[opponent].name)
+                      << ",\"score\":" << pair.getScore()
+                      << ",\"ci95\":[" << pair.getBound(-1) << "," << pair.getBound(1) << "]}";
+            first = false;
+        }
+        std::cout << "]}";
+    }
+    std::cout << "]}" << std::endl;
+
+    if (!options.csv.empty())
+    {
+        std::ofstream csv(options.csv, std::ios::trunc);
+        csv << "rank,bot,matches,wins,draws,losses,score,ci_low,ci_high,food\n";
+        for (int rank = 0; rank < count; rank ++)
+        {
+            int bot = ranking[rank];
+            const Tally& tally = overall[bot];
+            csv << rank + 1 << "," << quoteCsv(strategies[bot].name)
+                << "," << tally.matches << "," << tally.wins << "," << tally.draws
+                << "," << tally.matches - tally.wins - tally.draws
+                << "," << tally.getScore()
+                << "," << tally.getBound(-1)
+                << "," << tally.getBound(1)
+                << "," << static_cast<double>(tally.food) / std::max(1, tally.matches) << "\n";
+        }
+        if (!csv.good())
+        {
+            std::cerr << "could not write " << options.csv << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+namespace
+{
+    // Events kept per thread, older ones are overwritten
+    const int kRingSize = 1 << 16;
+    const int kMaxThreads = 64;
+
+    struct TraceEvent
+    {
+        const char* name;
+        int64_t nanos;
+        char phase;
+    };
+
+    struct TraceRing
+    {
+        int tid;
+        // Events ever written, the writer publishes each one by bumping it
+        std::atomic<uint64_t> head;
+        TraceEvent events[kRingSize];
+    };
+
+    std::atomic<TraceRing*> rings[kMaxThreads];
+    std::atomic<int> ringCount(0);
+    thread_local TraceRing* threadRing = nullptr;
+    std::atomic<bool> dumped(false);
+
+    std::chrono::steady_clock::time_point start;
+    char tracePath[4096];
+    struct sigaction previousInt;
+    struct sigaction previousTerm;
+
+    TraceRing* ringOfThread()
+    {
+        if (threadRing == nullptr)
+        {
+            int slot = ringCount.fetch_add(1);
+            if (slot >= kMaxThreads)
+            {
+                return nullptr;
+            }
+            threadRing = new TraceRing();
+            threadRing->tid = slot + 1;
+            threadRing->head.store(0);
+            rings[slot].store(threadRing, std::memory_order_release);
+        }
+        return threadRing;
+    }
+
+    // Nothing below may allocate or lock, it also runs in signal handlers
+    class JsonWriter
+    {
+    public:
+        explicit JsonWriter(int fd) : mFd(fd), mUsed(0) {}
+        ~JsonWriter()
+        {
+            this->flush();
+        }
+        void text(const char* text)
+        {
+            while (*text != '\0')
+            {
+                if (this->mUsed == sizeof(this->mBuffer))
+                {
+                    this->flush();
+                }
+                this->mBuffer[this->mUsed ++] = *text ++;
+            }
+        }
+        void number(uint64_t value)
+        {
+            char digits[24];
+            int n = sizeof(digits) - 1;
+            digits[n] = '\0';
+            do
+            {
+                digits[-- n] = '0' + value % 10;
+                value /= 10;
+            } while (value > 0);
+            this->text(digits + n);
+        }
+        void flush()
+        {
+            if (this->mUsed > 0 && ::write(this->mFd, this->mBuffer, this->mUsed) < 0)
+            {
+                // Nothing sensible left to do with a trace that cannot be written
+            }
+            this->mUsed = 0;
+        }
+
+    private:
+        int mFd;
+        size_t mUsed;
+        char mBuffer[1 << 16];
+    };
+
+    void onSignal(int sig)
+    {
+        Tracer::dump();
+        // Hand the signal to whoever had it before, curses restores the
+        // terminal there
+        sigaction(sig, sig == SIGINT ? &previousInt : &previousTerm, nullptr);
+        raise(sig);
+    }
+
+    void onExit()
+    {
+        Tracer::dump();
+    }
+}
+
+bool Tracer::sEnabled = false;
+
+void Tracer::enable(const std::string& path)
+{
+    std::strncpy(tracePath, path.c_str(), sizeof(tracePath) - 1);
+    start = std::chrono::steady_clock::now();
+    sEnabled = true;
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &previousInt);
+    sigaction(SIGTERM, &action, &previousTerm);
+    std::atexit(onExit);
+}
+
+void Tracer::record(const char* name, char phase)
+{
+    TraceRing* ring = ringOfThread();
+    if (ring == nullptr)
+    {
+        return;
+    }
+    int64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ring->events[head % kRingSize] = {name, nanos, phase};
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::dump()
+{
+    if (!sEnabled || dumped.exchange(true))
+    {
+        return;
+    }
+    int fd = ::open(tracePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return;
+    }
+    {
+        JsonWriter out(fd);
+        out.text("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        int count = std::min(ringCount.load(), kMaxThreads);
+        for (int i = 0; i < count; i ++)
+        {
+            TraceRing* ring = rings[i].load(std::memory_order_acquire);
+            if (ring == nullptr)
+            {
+                continue;
+            }
+            // Threads still running may overwrite the oldest events
+            // while they are read, a signal dump accepts that
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t begin = head > kRingSize ? head - kRingSize : 0;
+            for (uint64_t j = begin; j < head; j ++)
+            {
+                const TraceEvent& event = ring->events[j % kRingSize];
+                char phase[2] = {event.phase, '\0'};
+                out.text(first ? "{\"name\":\"" : ",\n{\"name\":\"");
+                out.text(event.name);
+                out.text("\",\"ph\":\"");
+                out.text(phase);
+                out.text("\",\"pid\":1,\"tid\":");
+                out.number(ring->tid);
+                // Microseconds with the nanoseconds as decimals
+                out.text(",\"ts\":");
+                out.number(event.nanos / 1000);
+                char decimals[5] = {'.', static_cast<char>('0' + event.nanos / 100 % 10),
+                                    static_cast<char>('0' + event.nanos / 10 % 10),
+                                    static_cast<char>('0' + event.nanos % 10), '\0'};
+                out.text(decimals);
+                out.text("}");
+                first = false;
+            }
+        }
+        out.text("\n]}\n");
+    }
+    ::close(fd);
+}
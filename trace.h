@@ -0,0 +1,64 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+
+// Optional timeline of what the game spends its time on, written as
+// Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+//
+// Every thread records begin/end events into its own ring buffer with a
+// single writer, so recording takes no lock. The newest events of every
+// thread are written out at exit or when SIGINT/SIGTERM arrives. While
+// tracing is off begin() and end() are one test of a flag that never
+// changes.
+class Tracer
+{
+public:
+    // Starts recording into path. Call it after the renderer exists, its
+    // own signal handlers still run after the trace is written.
+    static void enable(const std::string& path);
+
+    // Names must be string literals, only the pointer is kept
+    static void begin(const char* name)
+    {
+        if (sEnabled)
+        {
+            record(name, 'B');
+        }
+    }
+    static void end(const char* name)
+    {
+        if (sEnabled)
+        {
+            record(name, 'E');
+        }
+    }
+
+    // Writes the trace, only the first call does anything. Safe to call
+    // from a signal handler.
+    static void dump();
+
+private:
+    static void record(const char* name, char phase);
+    static bool sEnabled;
+};
+
+// Begin event now, end event when the scope is left
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name) : mName(name)
+    {
+        Tracer::begin(name);
+    }
+    ~TraceScope()
+    {
+        Tracer::end(this->mName);
+    }
+
+private:
+    const char* mName;
+};
+
+#endif
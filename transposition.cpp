@@ -0,0 +1,109 @@
+#include <cstring>
+
+#include "transposition.h"
+
+namespace
+{
+    // Layout of a packed entry
+    const int kDepthShift = 32;
+    const int kMoveShift = 40;
+    const int kGenerationShift = 42;
+    // Set in every stored entry, so an empty slot never matches
+    const uint64_t kValid = 1ULL << 63;
+
+    int depthOf(uint64_t data)
+    {
+        return (data >> kDepthShift) & 0xff;
+    }
+
+    int generationOf(uint64_t data)
+    {
+        return (data >> kGenerationShift) & 0xff;
+    }
+}
+
+TranspositionTable::TranspositionTable(int sizeBits)
+    : mSlots(static_cast<size_t>(1) << sizeBits), mMask((static_cast<uint64_t>(1) << sizeBits) - 1),
+      mGeneration(0), mProbes(0), mHits(0)
+{
+    this->clear();
+}
+
+bool TranspositionTable::probe(uint64_t hash, Entry& entry)
+{
+    const Slot& slot = this->mSlots[hash & this->mMask];
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    uint64_t check = slot.check.load(std::memory_order_relaxed);
+    this->mProbes.fetch_add(1, std::memory_order_relaxed);
+    if ((data & kValid) == 0 || (check ^ data) != hash)
+    {
+        return false;
+    }
+    this->mHits.fetch_add(1, std::memory_order_relaxed);
+    uint32_t bits = static_cast<uint32_t>(data);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    entry.value = value;
+    entry.depth = depthOf(data);
+    entry.move = static_cast<Direction>((data >> kMoveShift) & 3);
+    return true;
+}
+
+void TranspositionTable::store(uint64_t hash, int depth, double value, Direction move)
+{
+    Slot& slot = this->mSlots[hash & this->mMask];
+    int generation = this->mGeneration.load(std::memory_order_relaxed);
+    uint64_t old = slot.data.load(std::memory_order_relaxed);
+    bool same = (slot.check.load(std::memory_order_relaxed) ^ old) == hash;
+    // Keep a deeper result from this search, whatever state it is for
+    if ((old & kValid) != 0 && generationOf(old) == generation && depthOf(old) > depth && !same)
+    {
+        return;
+    }
+    if (same && depthOf(old) > depth)
+    {
+        return;
+    }
+    uint64_t data = pack(depth, value, move, generation);
+    // Racing writers may leave the words of two entries, which fails the check
+    slot.check.store(hash ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::age()
+{
+    this->mGeneration.store((this->mGeneration.load(std::memory_order_relaxed) + 1) & 0xff, std::memory_order_relaxed);
+}
+
+void TranspositionTable::clear()
+{
+    for (Slot& slot : this->mSlots)
+    {
+        slot.check.store(0, std::memory_order_relaxed);
+        slot.data.store(0, std::memory_order_relaxed);
+    }
+    this->mProbes = 0;
+    this->mHits = 0;
+}
+
+long TranspositionTable::getProbes() const
+{
+    return this->mProbes.load(std::memory_order_relaxed);
+}
+
+long TranspositionTable::getHits() const
+{
+    return this->mHits.load(std::memory_order_relaxed);
+}
+
+uint64_t TranspositionTable::pack(int depth, double value, Direction move, int generation)
+{
+    float narrow = static_cast<float>(value);
+    uint32_t bits;
+    std::memcpy(&bits, &narrow, sizeof(bits));
+    return kValid
+           | static_cast<uint64_t>(generation & 0xff) << kGenerationShift
+           | static_cast<uint64_t>(static_cast<int>(move) & 3) << kMoveShift
+           | static_cast<uint64_t>(depth & 0xff) << kDepthShift
+           | bits;
+}
@@ -0,0 +1,59 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "snake.h"
+
+// Search results by state hash (see ClassicState::getHash), shared by
+// any number of threads without locks.
+//
+// Each slot holds two words: the packed result, and the hash XORed with
+// it. A reader only trusts a slot whose words XOR back to the hash it
+// asked for, so a slot torn by two threads writing at once reads as a
+// miss instead of as someone else's result. A slot keeps the deeper of
+// two results for the same state, and anything left from an earlier
+// search gives way to the current one.
+class TranspositionTable
+{
+public:
+    struct Entry
+    {
+        double value;
+        // Moves searched below the state
+        int depth;
+        Direction move;
+    };
+
+    // 2^sizeBits slots of 16 bytes
+    explicit TranspositionTable(int sizeBits = 18);
+
+    bool probe(uint64_t hash, Entry& entry);
+    void store(uint64_t hash, int depth, double value, Direction move);
+    // Starts a new search, older entries may then be replaced
+    void age();
+    void clear();
+
+    long getProbes() const;
+    long getHits() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> data;
+    };
+
+    static uint64_t pack(int depth, double value, Direction move, int generation);
+
+    std::vector<Slot> mSlots;
+    uint64_t mMask;
+    std::atomic<int> mGeneration;
+    // Counted loosely, for the HUD
+    std::atomic<long> mProbes;
+    std::atomic<long> mHits;
+};
+
+#endif
@@ -0,0 +1,469 @@
+// snake-tune: evolves BotWeights for chooseWeightedMove with a genetic
+// algorithm. Every generation each new candidate plays the same fixed set
+// of headless World games as snake 0 against greedy bots, spread over all
+// cores. A game's score is the food snake 0 eats before it first dies.
+// The best candidates are kept as they are and the rest of the next
+// generation is bred from tournament winners by uniform crossover and
+// Gaussian mutation.
+//
+// Each generation is written to --checkpoint, and --resume carries on
+// from there, e.g. with more --generations. Results are the same for any
+// --threads. At the end the best weights are printed as JSON with their
+// score distribution on the training games, and on --validate games they
+// never saw, next to the greedy bot on the same games.
+//
+//   snake-tune [--population P] [--generations G] [--games N] [--validate N]
+//              [--ticks T] [--bots N] [--width W] [--height H] [--map I]
+//              [--threads T] [--seed S] [--checkpoint FILE] [--resume]
+//
+// --map -1, the default, deals the games out over every default map.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "world.h"
+#include "bot.h"
+#include "parallel.h"
+#include "rng.h"
+
+namespace
+{
+    struct Options
+    {
+        int population = 24;
+        int generations = 30;
+        int games = 16;
+        int validate = 64;
+        int ticks = 1000;
+        int bots = 3;
+        int width = 62;
+        int height = 18;
+        int map = -1;
+        int threads = 0;
+        uint64_t seed = 1;
+        std::string checkpoint = "tune.ckpt";
+        bool resume = false;
+    };
+
+    const int kGenes = 4;
+    const char* kGeneNames[kGenes] = {"food", "area", "tail", "wall"};
+    // Rough size of each weight, mutations are scaled by it
+    const double kGeneScales[kGenes] = {1, 10, 0.5, 1};
+    // Kept unchanged into the next generation
+    const int kElites = 2;
+    const int kTournament = 3;
+    const double kMutationChance = 0.5;
+    const double kMutationSize = 0.3;
+    const char* kCheckpointMagic = "snake-tune 1";
+
+    struct Candidate
+    {
+        double genes[kGenes];
+        bool scored;
+        // Mean score over the training games
+        double fitness;
+    };
+
+    struct Summary
+    {
+        double mean;
+        double stddev;
+        int min;
+        int p25;
+        int median;
+        int p75;
+        int max;
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; i ++)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--population" && hasValue) options.population = std::atoi(argv[++ i]);
+            else if (arg == "--generations" && hasValue) options.generations = std::atoi(argv[++ i]);
+            else if (arg == "--games" && hasValue) options.games = std::atoi(argv[++ i]);
+            else if (arg == "--validate" && hasValue) options.validate = std::atoi(argv[++ i]);
+            else if (arg == "--ticks" && hasValue) options.ticks = std::atoi(argv[++ i]);
+            else if (arg == "--bots" && hasValue) options.bots = std::atoi(argv[++ i]);
+            else if (arg == "--width" && hasValue) options.width = std::atoi(argv[++ i]);
+            else if (arg == "--height" && hasValue) options.height = std::atoi(argv[++ i]);
+            else if (arg == "--map" && hasValue) options.map = std::atoi(argv[++ i]);
+            else if (arg == "--threads" && hasValue) options.threads = std::atoi(argv[++ i]);
+            else if (arg == "--seed" && hasValue) options.seed = std::atoll(argv[++ i]);
+            else if (arg == "--checkpoint" && hasValue) options.checkpoint = argv[++ i];
+            else if (arg == "--resume") options.resume = true;
+            else
+            {
+                std::cerr << "usage: " << argv[0]
+                          << " [--population P] [--generations G] [--games N] [--validate N] [--ticks T] [--bots N] [--width W] [--height H] [--map I] [--threads T] [--seed S] [--checkpoint FILE] [--resume]" << std::endl;
+                std::exit(1);
+            }
+        }
+        options.population = std::max(kElites + 1, options.population);
+        options.games = std::max(1, options.games);
+        options.bots = std::max(0, options.bots);
+        if (options.threads <= 0)
+        {
+            options.threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        return options;
+    }
+
+    BotWeights toWeights(const double* genes)
+    {
+        BotWeights weights;
+        weights.food = genes[0];
+        weights.area = genes[1];
+        weights.tail = genes[2];
+        weights.wall = genes[3];
+        return weights;
+    }
+
+    // Uniform in [0, 1)
+    double nextUnit(Rng& rng)
+    {
+        return (rng.next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Box-Muller, one of the pair is enough here
+    double nextGaussian(Rng& rng)
+    {
+        double u = 1 - nextUnit(rng);
+        return std::sqrt(-2 * std::log(u)) * std::cos(2 * M_PI * nextUnit(rng));
+    }
+
+    // Game i of a set, set 0 trains and set 1 validates
+    uint64_t gameSeed(const Options& options, int set, int i)
+    {
+        return mixBits(mixBits(options.seed + set) + i);
+    }
+
+    // One headless game. Snake 0 plays the weights, or is a greedy bot
+    // itself without them, the others are greedy bots that respawn as
+    // in party mode. Ends when snake 0 dies or after --ticks.
+    int playGame(const Options& options, const std::vector<GameMap>& maps, uint64_t seed, int index,
+                 const BotWeights* weights)
+    {
+        int map = options.map >= 0 ? std::min<int>(options.map, maps.size() - 1) : index % maps.size();
+        World world(options.width, options.height, maps[map].getObstacles(), seed);
+        int count = options.bots + 1;
+        for (int i = 0; i < count; i ++)
+        {
+            world.spawnSnake(2, false);
+        }
+        world.setFoodCount(std::max(1, count / 2));
+        const std::vector<WorldSnake>& snakes = world.getSnakes();
+        if (snakes.empty())
+        {
+            return 0;
+        }
+        for (int tick = 0; tick < options.ticks && snakes[0].alive; tick ++)
+        {
+            world.turn(0, weights != nullptr ? chooseWeightedMove(world, 0, *weights) : chooseGreedyMove(world, 0));
+            for (int i = 1; i < snakes.size(); i ++)
+            {
+                if (snakes[i].alive || world.respawnSnake(i, 2))
+                {
+                    world.turn(i, chooseGreedyMove(world, i));
+                }
+            }
+            world.step();
+        }
+        return snakes[0].score;
+    }
+
+    // Scores of the weights, or of the greedy bot, on a whole game set
+    std::vector<int> playSet(const Options& options, const std::vector<GameMap>& maps, int set, int games,
+                             const BotWeights* weights)
+    {
+        std::vector<int> scores(games);
+        runParallel(games, options.threads, [&](int i) {
+            scores[i] = playGame(options, maps, gameSeed(options, set, i), i, weights);
+        });
+        return scores;
+    }
+
+    // Plays the training games of every candidate not scored yet
+    void evaluate(const Options& options, const std::vector<GameMap>& maps, std::vector<Candidate>& population)
+    {
+        std::vector<int> pending;
+        for (int i = 0; i < population.size(); i ++)
+        {
+            if (!population[i].scored)
+            {
+                pending.push_back(i);
+            }
+        }
+        int games = options.games;
+        std::vector<int> scores(pending.size() * games);
+        runParallel(scores.size(), options.threads, [&](int job) {
+            BotWeights weights = toWeights(population[pending[job / games]].genes);
+            int game = job % games;
+            scores[job] = playGame(options, maps, gameSeed(options, 0, game), game, &weights);
+        });
+        for (int p = 0; p < pending.size(); p ++)
+        {
+            long total = 0;
+            for (int game = 0; game < games; game ++)
+            {
+                total += scores[p * games + game];
+            }
+            population[pending[p]].fitness = static_cast<double>(total) / games;
+            population[pending[p]].scored = true;
+        }
+        // Best first, earlier ones first on ties so the elites stay put
+        std::stable_sort(population.begin(), population.end(), [](const Candidate& a, const Candidate& b) {
+            return a.fitness > b.fitness;
+        });
+    }
+
+    // The default weights and random ones around them
+    std::vector<Candidate> seedPopulation(const Options& options)
+    {
+        Rng rng(mixBits(options.seed));
+        BotWeights defaults;
+        double start[kGenes] = {defaults.food, defaults.area, defaults.tail, defaults.wall};
+        std::vector<Candidate> population(options.population);
+        for (int i = 0; i < population.size(); i ++)
+        {
+            for (int g = 0; g < kGenes; g ++)
+            {
+                population[i].genes[g] = start[g] + (i == 0 ? 0 : nextGaussian(rng) * kGeneScales[g]);
+            }
+            population[i].scored = false;
+            population[i].fitness = 0;
+        }
+        return population;
+    }
+
+    const Candidate& pickParent(const std::vector<Candidate>& population, Rng& rng)
+    {
+        // The population is sorted, so the lowest index drawn wins
+        int best = rng.nextInt(population.size());
+        for (int i = 1; i < kTournament; i ++)
+        {
+            best = std::min(best, rng.nextInt(population.size()));
+        }
+        return population[best];
+    }
+
+    // Next generation from a scored and sorted one. Depends only on the
+    // seed and the generation, so a resumed run breeds the same children.
+    std::vector<Candidate> breed(const Options& options, const std::vector<Candidate>& parents, int generation)
+    {
+        Rng rng(mixBits(options.seed) ^ mixBits(generation));
+        std::vector<Candidate> children(parents.begin(), parents.begin() + kElites);
+        while (children.size() < options.population)
+        {
+            const Candidate& a = pickParent(parents, rng);
+            const Candidate& b = pickParent(parents, rng);
+            Candidate child;
+            for (int g = 0; g < kGenes; g ++)
+            {
+                child.genes[g] = rng.nextInt(2) == 0 ? a.genes[g] : b.genes[g];
+                if (nextUnit(rng) < kMutationChance)
+                {
+                    child.genes[g] += nextGaussian(rng) * kGeneScales[g] * kMutationSize;
+                }
+            }
+            child.scored = false;
+            child.fitness = 0;
+            children.push_back(child);
+        }
+        return children;
+    }
+
+    std::string describeConfig(const Options& options)
+    {
+        return std::to_string(options.seed) + " " + std::to_string(options.population) + " "
+               + std::to_string(options.games) + " " + std::to_string(options.ticks) + " "
+               + std::to_string(options.bots) + " " + std::to_string(options.width) + " "
+               + std::to_string(options.height) + " " + std::to_string(options.map);
+    }
+
+    // Written next to the checkpoint first and renamed over it, so a run
+    // killed halfway through a write still has the last generation
+    bool saveCheckpoint(const Options& options, int generation, const std::vector<Candidate>& population)
+    {
+        std::string temporary = options.checkpoint + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::trunc);
+            if (!out.is_open())
+            {
+                return false;
+            }
+            out << kCheckpointMagic << "\n"
+                << "config " << describeConfig(options) << "\n"
+                << "generation " << generation << "\n"
+                << std::setprecision(17);
+            for (const Candidate& candidate : population)
+            {
+                for (int g = 0; g < kGenes; g ++)
+                {
+                    out << candidate.genes[g] << " ";
+                }
+                out << candidate.fitness << "\n";
+            }
+            if (!out.good())
+            {
+                return false;
+            }
+        }
+        return std::rename(temporary.c_str(), options.checkpoint.c_str()) == 0;
+    }
+
+    // The last scored generation, false when the file is missing or was
+    // written with other settings
+    bool loadCheckpoint(const Options& options, int& generation, std::vector<Candidate>& population)
+    {
+        std::ifstream in(options.checkpoint);
+        std::string magic;
+        std::string config;
+        std::string word;
+        if (!std::getline(in, magic) || magic != kCheckpointMagic
+            || !(in >> word) || word != "config" || !std::getline(in >> std::ws, config)
+            || config != describeConfig(options) || !(in >> word >> generation) || word != "generation")
+        {
+            return false;
+        }
+        population.assign(options.population, Candidate());
+        for (Candidate& candidate : population)
+        {
+            for (int g = 0; g < kGenes; g ++)
+            {
+                in >> candidate.genes[g];
+            }
+            in >> candidate.fitness;
+            candidate.scored = true;
+        }
+        return !in.fail();
+    }
+
+    Summary summarize(std::vector<int> scores)
+    {
+        std::sort(scores.begin(), scores.end());
+        int n = scores.size();
+        double mean = 0;
+        for (int score : scores)
+        {
+            mean += score;
+        }
+        mean /= n;
+        double variance = 0;
+        for (int score : scores)
+        {
+            variance += (score - mean) * (score - mean);
+        }
+        Summary summary;
+        summary.mean = mean;
+        summary.stddev = n > 1 ? std::sqrt(variance / (n - 1)) : 0;
+        summary.min = scores.front();
+        summary.p25 = scores[n / 4];
+        summary.median = scores[n / 2];
+        summary.p75 = scores[std::min(n - 1, 3 * n / 4)];
+        summary.max = scores.back();
+        return summary;
+    }
+
+    void printSummary(const Summary& summary)
+    {
+        std::cout << "{\"mean\":" << summary.mean
+                  << ",\"stddev\":" << summary.stddev
+                  << ",\"min\":" << summary.min
+                  << ",\"p25\":" << summary.p25
+                  << ",\"median\":" << summary.median
+                  << ",\"p75\":" << summary.p75
+                  << ",\"max\":" << summary.max << "}";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options = parseOptions(argc, argv);
+    std::vector<GameMap> maps = GameMap::getDefaultMaps(options.width, options.height, options.seed);
+
+    // Generation is the next one to score
+    std::vector<Candidate> population;
+    int generation = 0;
+    if (options.resume && loadCheckpoint(options, generation, population))
+    {
+        std::cerr << "resuming after generation " << generation << " from " << options.checkpoint << std::endl;
+        generation ++;
+    }
+    else if (options.resume && std::ifstream(options.checkpoint).good())
+    {
+        // Not overwritten, it may be another run's
+        std::cerr << options.checkpoint << " was written with other settings" << std::endl;
+        return 1;
+    }
+    else
+    {
+        population = seedPopulation(options);
+    }
+
+    for (; generation < options.generations; generation ++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (generation > 0 && population[0].scored)
+        {
+            population = breed(options, population, generation);
+        }
+        evaluate(options, maps, population);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double mean = 0;
+        for (const Candidate& candidate : population)
+        {
+            mean += candidate.fitness;
+        }
+        mean /= population.size();
+        std::cerr << "generation " << generation << " best " << population[0].fitness << " mean " << mean;
+        for (int g = 0; g < kGenes; g ++)
+        {
+            std::cerr << " " << kGeneNames[g] << " " << population[0].genes[g];
+        }
+        std::cerr << " (" << seconds << "s)" << std::endl;
+        if (!saveCheckpoint(options, generation, population))
+        {
+            std::cerr << "could not write " << options.checkpoint << std::endl;
+        }
+    }
+
+    if (!population[0].scored)
+    {
+        evaluate(options, maps, population);
+    }
+    BotWeights best = toWeights(population[0].genes);
+    std::cout << "{\"generations\":" << options.generations
+              << ",\"population\":" << options.population
+              << ",\"games\":" << options.games
+              << ",\"weights\":{";
+    for (int g = 0; g < kGenes; g ++)
+    {
+        std::cout << (g > 0 ? "," : "") << "\"" << kGeneNames[g] << "\":" << population[0].genes[g];
+    }
+    std::cout << "},\"train\":";
+    printSummary(summarize(playSet(options, maps, 0, options.games, &best)));
+    std::cout << ",\"greedyTrain\":";
+    printSummary(summarize(playSet(options, maps, 0, options.games, nullptr)));
+    if (options.validate > 0)
+    {
+        std::cout << ",\"validate\":";
+        printSummary(summarize(playSet(options, maps, 1, options.validate, &best)));
+        std::cout << ",\"greedyValidate\":";
+        printSummary(summarize(playSet(options, maps, 1, options.validate, nullptr)));
+    }
+    std::cout << "}" << std::endl;
+    return 0;
+}
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <cstring>
+
+#include "vec_env.h"
+
+namespace
+{
+    // Random probes before food placement falls back to a scan
+    const int kFoodTries = 64;
+}
+
+VecEnv::VecEnv(int count, const VecEnvConfig& config)
+    : mConfig(config), mEnvs(std::max(1, count)), mObservations(nullptr),
+      mPlaneSize(static_cast<size_t>(config.width) * config.height),
+      mActions(nullptr), mRewards(nullptr), mDones(nullptr),
+      mGeneration(0), mPending(0), mStopping(false)
+{
+    std::vector<GameMap> maps = GameMap::getDefaultMaps(config.width, config.height, config.seed);
+    const GameMap& map = maps[std::min<int>(std::max(0, config.map), maps.size() - 1)];
+    // Some layouts reach past the board, those cells can never be hit
+    for (const Obstacle& obs : map.getObstacles())
+    {
+        if (obs.x >= 0 && obs.x < config.width && obs.y >= 0 && obs.y < config.height)
+        {
+            this->mObstacles.push_back(obs);
+        }
+    }
+    for (int i = 0; i < this->mEnvs.size(); i ++)
+    {
+        this->mEnvs[i].rng.seed(mixBits(config.seed + i));
+        this->mEnvs[i].snake.reset(new Snake(config.width, config.height, config.snakeLength));
+        this->mEnvs[i].bits.reset(config.width - 2, config.height - 2, PLANES);
+    }
+
+    int threads = std::min<int>(std::max(1, config.threads), this->mEnvs.size());
+    for (int i = 1; i < threads; i ++)
+    {
+        this->mWorkers.emplace_back(&VecEnv::work, this, i);
+    }
+}
+
+VecEnv::~VecEnv()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mStopping = true;
+    }
+    this->mStart.notify_all();
+    for (std::thread& worker : this->mWorkers)
+    {
+        worker.join();
+    }
+}
+
+void VecEnv::resetAll(uint8_t* observations)
+{
+    this->mObservations = observations;
+    for (int i = 0; i < this->mEnvs.size(); i ++)
+    {
+        this->reset(i);
+    }
+}
+
+void VecEnv::stepAll(const int* actions, float* rewards, uint8_t* dones)
+{
+    this->mActions = actions;
+    this->mRewards = rewards;
+    this->mDones = dones;
+    if (this->mWorkers.empty())
+    {
+        this->runShard(0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mPending = this->mWorkers.size();
+        this->mGeneration ++;
+    }
+    this->mStart.notify_all();
+    this->runShard(0);
+    std::unique_lock<std::mutex> lock(this->mMutex);
+    this->mFinished.wait(lock, [this] { return this->mPending == 0; });
+}
+
+void VecEnv::work(int shard)
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->mMutex);
+            this->mStart.wait(lock, [&] { return this->mStopping || this->mGeneration != seen; });
+            if (this->mStopping)
+            {
+                return;
+            }
+            seen = this->mGeneration;
+        }
+        this->runShard(shard);
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        if (-- this->mPending == 0)
+        {
+            this->mFinished.notify_one();
+        }
+    }
+}
+
+void VecEnv::runShard(int shard)
+{
+    // Contiguous slices keep every thread on its own part of the buffer
+    int shards = this->mWorkers.size() + 1;
+    int count = this->mEnvs.size();
+    int begin = static_cast<long>(count) * shard / shards;
+    int end = static_cast<long>(count) * (shard + 1) / shards;
+    for (int i = begin; i < end; i ++)
+    {
+        this->step(i);
+    }
+}
+
+uint8_t* VecEnv::plane(int index, Plane plane) const
+{
+    return this->mObservations + (static_cast<size_t>(index) * PLANES + plane) * this->mPlaneSize;
+}
+
+void VecEnv::reset(int index)
+{
+    Env& env = this->mEnvs[index];
+    std::memset(this->plane(index, BODY), 0, this->getObservationSize());
+    env.bits.clear();
+    for (const Obstacle& obs : this->mObstacles)
+    {
+        this->mark(index, OBSTACLE, obs.x, obs.y, true);
+    }
+
+    // Same start as the classic game, reusing the body's storage
+    env.snake->getSnake().clear();
+    env.snake->initializeSnake();
+    for (const SnakeBody& part : env.snake->getSnake())
+    {
+        this->mark(index, BODY, part.getX(), part.getY(), true);
+    }
+    const SnakeBody& head = env.snake->getSnake().front();
+    this->mark(index, HEAD, head.getX(), head.getY(), true);
+    env.steps = 0;
+    this->placeFood(index);
+}
+
+void VecEnv::placeFood(int index)
+{
+    Env& env = this->mEnvs[index];
+    const int width = this->mConfig.width;
+    const uint8_t* body = this->plane(index, BODY);
+    const uint8_t* obstacles = this->plane(index, OBSTACLE);
+    auto isFree = [&](int x, int y) {
+        return body[y * width + x] == 0 && obstacles[y * width + x] == 0;
+    };
+
+    // Like Game::createRamdonFood, but a crowded board cannot spin forever
+    int x = 0;
+    int y = 0;
+    bool found = false;
+    for (int i = 0; i < kFoodTries && !found; i ++)
+    {
+        x = env.rng.nextInt(width - 2) + 1;
+        y = env.rng.nextInt(this->mConfig.height - 2) + 1;
+        found = isFree(x, y);
+    }
+    for (int cell = 0; cell < this->mPlaneSize && !found; cell ++)
+    {
+        x = cell % width;
+        y = cell / width;
+        found = x >= 1 && x < width - 1 && y >= 1 && y < this->mConfig.height - 1 && isFree(x, y);
+    }
+    // Without a free cell the food sits under the snake, the game is won
+    env.food = SnakeBody(x, y);
+    env.snake->senseFood(env.food);
+    this->mark(index, FOOD, x, y, true);
+}
+
+void VecEnv::mark(int index, Plane plane, int x, int y, bool on)
+{
+    this->plane(index, plane)[y * this->mConfig.width + x] = on ? 1 : 0;
+    // The packed planes only cover the cells snakes can reach
+    if (x < 1 || x > this->mConfig.width - 2 || y < 1 || y > this->mConfig.height - 2)
+    {
+        return;
+    }
+    if (on)
+    {
+        this->mEnvs[index].bits.set(plane, x - 1, y - 1);
+    }
+    else
+    {
+        this->mEnvs[index].bits.unset(plane, x - 1, y - 1);
+    }
+}
+
+void VecEnv::step(int index)
+{
+    Env& env = this->mEnvs[index];
+    const int width = this->mConfig.width;
+    const uint8_t* body = this->plane(index, BODY);
+    std::vector<SnakeBody>& parts = env.snake->getSnake();
+
+    // Only turns across the current direction, as Game::controlSnake
+    // checks before it calls changeDirection
+    int action = this->mActions[index];
+    bool vertical = env.snake->getDirection() == Direction::Up || env.snake->getDirection() == Direction::Down;
+    if (action >= 0 && action < 4 && vertical != (action == static_cast<int>(Direction::Up)
+                                                  || action == static_cast<int>(Direction::Down)))
+    {
+        env.snake->changeDirection(static_cast<Direction>(action));
+    }
+    const SnakeBody& oldHead = parts.front();
+    this->mark(index, HEAD, oldHead.getX(), oldHead.getY(), false);
+
+    // The cell the head really moves to, wrapping around the board.
+    // The tail still counts as body, as in Game::stepGame.
+    SnakeBody newHead = env.snake->createNewHead();
+    int cell = newHead.getY() * width + newHead.getX();
+    env.steps ++;
+    float reward = 0;
+    bool done = false;
+    if (body[cell] != 0 || this->plane(index, OBSTACLE)[cell] != 0)
+    {
+        reward = -1;
+        done = true;
+    }
+    else if (newHead == env.food)
+    {
+        reward = 1;
+        this->mark(index, BODY, newHead.getX(), newHead.getY(), true);
+        this->mark(index, HEAD, newHead.getX(), newHead.getY(), true);
+        this->mark(index, FOOD, newHead.getX(), newHead.getY(), false);
+        this->placeFood(index);
+    }
+    else
+    {
+        this->mark(index, BODY, newHead.getX(), newHead.getY(), true);
+        this->mark(index, HEAD, newHead.getX(), newHead.getY(), true);
+        const SnakeBody& tail = parts.back();
+        this->mark(index, BODY, tail.getX(), tail.getY(), false);
+        parts.pop_back();
+    }
+    if (!done && env.steps >= this->mConfig.maxSteps)
+    {
+        done = true;
+    }
+
+    this->mRewards[index] = reward;
+    this->mDones[index] = done ? 1 : 0;
+    if (done)
+    {
+        this->reset(index);
+    }
+}
+
+void VecEnv::writeWindows(int radius, uint64_t* windows) const
+{
+    if (radius > BitPlanes::kMaxRadius)
+    {
+        radius = BitPlanes::kMaxRadius;
+    }
+    if (radius < 0)
+    {
+        radius = 0;
+    }
+    int side = 2 * radius + 1;
+    for (int i = 0; i < this->mEnvs.size(); i ++)
+    {
+        const Env& env = this->mEnvs[i];
+        const SnakeBody& head = env.snake->getSnake().front();
+        for (int plane = 0; plane < PLANES; plane ++)
+        {
+            env.bits.window(plane, head.getX() - 1, head.getY() - 1, radius, windows);
+            windows += side;
+        }
+    }
+}
+
+const BitPlanes& VecEnv::getPlanes(int index) const
+{
+    return this->mEnvs[index].bits;
+}
+
+int VecEnv::getCount() const
+{
+    return this->mEnvs.size();
+}
+
+int VecEnv::getWidth() const
+{
+    return this->mConfig.width;
+}
+
+int VecEnv::getHeight() const
+{
+    return this->mConfig.height;
+}
+
+size_t VecEnv::getObservationSize() const
+{
+    return this->mPlaneSize * PLANES;
+}
@@ -0,0 +1,116 @@
+#ifndef VEC_ENV_H
+#define VEC_ENV_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "snake.h"
+#include "map.h"
+#include "rng.h"
+#include "bit_planes.h"
+
+struct VecEnvConfig
+{
+    // Board size with its border, like the classic game window
+    int width = 62;
+    int height = 24;
+    int snakeLength = 2;
+    // Index into GameMap::getDefaultMaps
+    int map = 0;
+    // Episodes are cut off after this many steps, a short snake on a
+    // wrapping board could otherwise circle forever
+    int maxSteps = 1000;
+    // Threads stepping the games, the caller's included
+    int threads = 1;
+    uint64_t seed = 1;
+};
+
+// Many classic games stepped together, for training agents.
+//
+// Observations go into one buffer the caller owns. It holds count x
+// kPlanes x height x width bytes, games one after another, each game a
+// stack of 0/1 planes (BODY with the head included, HEAD, FOOD,
+// OBSTACLE) indexed [y][x]. resetAll() fills the whole buffer. After
+// that stepAll() only rewrites the cells that changed, so the buffer
+// must not be touched between calls.
+//
+// A game that ends is reset within the same stepAll(). Its reward and
+// done flag belong to the step that ended it, its observation already
+// shows the new game. Nothing is allocated once the snakes have grown
+// to their longest.
+//
+// Every game also keeps the same planes bit-packed over the cells inside
+// the border, updated on each step alongside the bytes. Cut out around
+// the head they give bots and small networks a fixed size view.
+class VecEnv
+{
+public:
+    enum Plane { BODY, HEAD, FOOD, OBSTACLE, PLANES };
+
+    VecEnv(int count, const VecEnvConfig& config);
+    ~VecEnv();
+
+    void resetAll(uint8_t* observations);
+    // actions holds a Direction per game, -1 keeps going straight. Food
+    // is worth +1, dying -1, and done is 1 once the game ended.
+    void stepAll(const int* actions, float* rewards, uint8_t* dones);
+    // count x PLANES x (2 * radius + 1) words, one per window row, with
+    // the head in the middle, see BitPlanes::window. radius is clamped to
+    // [0, BitPlanes::kMaxRadius].
+    void writeWindows(int radius, uint64_t* windows) const;
+    // Packed planes of one game, (x, y) inside the border is (x - 1, y - 1)
+    const BitPlanes& getPlanes(int index) const;
+
+    int getCount() const;
+    int getWidth() const;
+    int getHeight() const;
+    // Bytes of one game's observation
+    size_t getObservationSize() const;
+
+private:
+    struct Env
+    {
+        std::unique_ptr<Snake> snake;
+        Rng rng;
+        SnakeBody food;
+        int steps;
+        BitPlanes bits;
+    };
+
+    void reset(int index);
+    void step(int index);
+    void placeFood(int index);
+    uint8_t* plane(int index, Plane plane) const;
+    // Sets or clears a cell in both the byte and the packed planes
+    void mark(int index, Plane plane, int x, int y, bool on);
+    // Runs games [begin, end) of the current call
+    void runShard(int shard);
+    void work(int shard);
+
+    VecEnvConfig mConfig;
+    std::vector<Env> mEnvs;
+    std::vector<Obstacle> mObstacles;
+    uint8_t* mObservations;
+    size_t mPlaneSize;
+
+    // Arguments of the stepAll() in progress
+    const int* mActions;
+    float* mRewards;
+    uint8_t* mDones;
+
+    // Worker threads wait for the next generation, step their shard
+    // and report back
+    std::vector<std::thread> mWorkers;
+    std::mutex mMutex;
+    std::condition_variable mStart;
+    std::condition_variable mFinished;
+    uint64_t mGeneration;
+    int mPending;
+    bool mStopping;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include <stdexcept>
+
+#include "virtual_renderer.h"
+
+VirtualRenderer::VirtualRenderer(int height, int width): CellRenderer(height, width)
+{
+}
+
+void VirtualRenderer::pushKey(int key)
+{
+    this->mKeys.push_back(key);
+}
+
+void VirtualRenderer::pushKeys(const std::string& keys)
+{
+    for (char key : keys)
+    {
+        this->mKeys.push_back(key == '\r' ? 10 : key);
+    }
+}
+
+int VirtualRenderer::readKey()
+{
+    if (this->mKeys.empty())
+    {
+        return ERR;
+    }
+    int key = this->mKeys.front();
+    this->mKeys.pop_front();
+    return key;
+}
+
+int VirtualRenderer::waitKey()
+{
+    if (this->mKeys.empty())
+    {
+        throw std::out_of_range("virtual terminal ran out of scripted keys");
+    }
+    return this->readKey();
+}
+
+std::string VirtualRenderer::dump() const
+{
+    int height, width;
+    this->getScreenSize(height, width);
+    std::string screen;
+    screen.reserve((width + 1) * height);
+    for (int y = 0; y < height; y ++)
+    {
+        for (int x = 0; x < width; x ++)
+        {
+            const Cell& cell = this->getCell(y, x);
+            char ch = cell.ch;
+            if (cell.attr & A_ALTCHARSET)
+            {
+                ch = ch == 'q' ? '-' : ch == 'x' ? '|' : '+';
+            }
+            screen += ch;
+        }
+        screen += '\n';
+    }
+    return screen;
+}
+
+const std::vector<size_t>& VirtualRenderer::getFrameSizes() const
+{
+    return this->mFrameSizes;
+}
+
+void VirtualRenderer::writeFrame(const std::string& frame)
+{
+    this->mStats.writes ++;
+    this->mFrameSizes.push_back(frame.size());
+}
@@ -0,0 +1,40 @@
+#ifndef VIRTUAL_RENDERER_H
+#define VIRTUAL_RENDERER_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "cell_renderer.h"
+
+// In-memory terminal for headless runs. Frames are encoded exactly as
+// AnsiRenderer would send them but only their sizes are kept, and keys
+// come from a script instead of stdin.
+class VirtualRenderer : public CellRenderer
+{
+public:
+    VirtualRenderer(int height, int width);
+
+    void pushKey(int key);
+    void pushKeys(const std::string& keys);
+
+    // Returns ERR once the script is used up
+    int readKey() override;
+    // A virtual terminal cannot wait for a human: throws
+    // std::out_of_range when the script is used up
+    int waitKey() override;
+
+    // Screen contents, one line per row, box drawing mapped to + - |
+    std::string dump() const;
+    // Encoded size of every present() that changed something
+    const std::vector<size_t>& getFrameSizes() const;
+
+protected:
+    void writeFrame(const std::string& frame) override;
+
+private:
+    std::deque<int> mKeys;
+    std::vector<size_t> mFrameSizes;
+};
+
+#endif
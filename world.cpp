@@ -0,0 +1,727 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "world.h"
+
+namespace
+{
+    bool samePosition(const SnakeBody& a, const SnakeBody& b)
+    {
+        return a.getX() == b.getX() && a.getY() == b.getY();
+    }
+
+    bool isPerpendicular(Direction a, Direction b)
+    {
+        bool aVertical = a == Direction::Up || a == Direction::Down;
+        bool bVertical = b == Direction::Up || b == Direction::Down;
+        return aVertical != bVertical;
+    }
+
+    // Give up after this many random probes, the board is nearly full
+    const int kSpawnAttempts = 64;
+
+    // Side of a food bucket. Below the scan limit the food list is
+    // simply walked.
+    const int kFoodBucket = 32;
+    const int kFoodScanLimit = 32;
+
+    // Distance from a coordinate to the closest one in [low, high] along
+    // an axis of the given size that wraps around
+    int wrappedGap(int at, int low, int high, int size)
+    {
+        if (at >= low && at <= high)
+        {
+            return 0;
+        }
+        int toLow = std::abs(at - low);
+        int toHigh = std::abs(at - high);
+        return std::min(std::min(toLow, size - toLow), std::min(toHigh, size - toHigh));
+    }
+
+    // Parts of a snake that snakeHash keys one by one. Numbered from 1,
+    // mixBits(0) is 0.
+    enum SnakeField { FLAGS = 1, SCORE, HEAD_X, HEAD_Y, LENGTH };
+
+    // Each (snake, field, value) gets its own key, so no field can run
+    // into another however large it grows
+    uint64_t snakeKey(int id, SnakeField field, uint32_t value)
+    {
+        return mixBits(static_cast<uint64_t>(value) << 32 | static_cast<uint64_t>(id) << 3 | field);
+    }
+
+    // Placeholder for ids a replica has not heard about yet
+    WorldSnake deadSnake()
+    {
+        WorldSnake snake;
+        snake.direction = Direction::Up;
+        snake.movedDirection = Direction::Up;
+        snake.alive = false;
+        snake.human = false;
+        snake.score = 0;
+        snake.cause = DeathCause::NONE;
+        return snake;
+    }
+}
+
+World::World(int width, int height, const std::vector<Obstacle>& obstacles, uint64_t seed)
+    : mWidth(width), mHeight(height), mIndex(width, height), mRng(seed), mTick(0), mFoodCount(0),
+      mRecordEvents(false)
+{
+    this->mBucketsX = std::max(1, (width - 2 + kFoodBucket - 1) / kFoodBucket);
+    this->mBucketsY = std::max(1, (height - 2 + kFoodBucket - 1) / kFoodBucket);
+    this->mFoodBuckets.resize(this->mBucketsX * this->mBucketsY);
+    for (const Obstacle& obs : obstacles)
+    {
+        // Some default maps reach onto the border, only keep what is inside
+        if (obs.x >= 0 && obs.x < width && obs.y >= 0 && obs.y < height)
+        {
+            this->mObstacles.push_back(obs);
+            this->mIndex.set(obs.x, obs.y, BoardIndex::kObstacle);
+        }
+    }
+}
+
+int World::spawnSnake(int length, bool human)
+{
+    int id = this->mSnakes.size();
+    WorldSnake snake;
+    snake.human = human;
+    snake.score = 0;
+    if (!this->placeBody(id, length, snake))
+    {
+        return -1;
+    }
+    this->mSnakes.push_back(snake);
+    return id;
+}
+
+bool World::respawnSnake(int id, int length)
+{
+    WorldSnake& snake = this->mSnakes[id];
+    if (snake.alive)
+    {
+        return false;
+    }
+    return this->placeBody(id, length, snake);
+}
+
+bool World::placeBody(int id, int length, WorldSnake& snake)
+{
+    length = std::max(2, length);
+    int innerWidth = this->mWidth - 2;
+    int innerHeight = this->mHeight - 2 - length;
+    if (innerWidth <= 0 || innerHeight <= 0)
+    {
+        return false;
+    }
+    for (int attempt = 0; attempt < kSpawnAttempts; attempt ++)
+    {
+        int x = this->mRng.nextInt(innerWidth) + 1;
+        int y = this->mRng.nextInt(innerHeight) + 1;
+        // The cell above the head must be free too, or it dies at once
+        bool free = true;
+        for (int i = -1; i < length && free; i ++)
+        {
+            free = this->mIndex.get(x, y + i) == BoardIndex::kEmpty;
+        }
+        if (!free)
+        {
+            continue;
+        }
+
+        snake.body.clear();
+        for (int i = 0; i < length; i ++)
+        {
+            snake.body.push_back(SnakeBody(x, y + i));
+            this->mIndex.set(x, y + i, BoardIndex::snakeValue(id));
+        }
+        snake.direction = Direction::Up;
+        snake.movedDirection = Direction::Up;
+        snake.alive = true;
+        snake.cause = DeathCause::NONE;
+        this->record(WorldEvent::Type::SPAWN, id, x, y, length, snake.human);
+        return true;
+    }
+    return false;
+}
+
+void World::setFoodCount(int count)
+{
+    this->mFoodCount = count;
+    while (this->mFoods.size() < this->mFoodCount)
+    {
+        int before = this->mFoods.size();
+        this->spawnFood();
+        if (this->mFoods.size() == before)
+        {
+            break;
+        }
+    }
+}
+
+void World::spawnFood()
+{
+    for (int attempt = 0; attempt < kSpawnAttempts; attempt ++)
+    {
+        int x = this->mRng.nextInt(this->mWidth - 2) + 1;
+        int y = this->mRng.nextInt(this->mHeight - 2) + 1;
+        if (this->mIndex.get(x, y) == BoardIndex::kEmpty)
+        {
+            this->addFood(SnakeBody(x, y));
+            this->record(WorldEvent::Type::FOOD, -1, x, y, 0, false);
+            return;
+        }
+    }
+}
+
+void World::addFood(const SnakeBody& food)
+{
+    this->mIndex.set(food.getX(), food.getY(), BoardIndex::kFood);
+    this->mFoods.push_back(food);
+    this->bucketOf(food).push_back(food);
+}
+
+void World::removeFood(const SnakeBody& food)
+{
+    for (int i = 0; i < this->mFoods.size(); i ++)
+    {
+        if (samePosition(this->mFoods[i], food))
+        {
+            this->mFoods[i] = this->mFoods.back();
+            this->mFoods.pop_back();
+            break;
+        }
+    }
+    std::vector<SnakeBody>& bucket = this->bucketOf(food);
+    for (int i = 0; i < bucket.size(); i ++)
+    {
+        if (samePosition(bucket[i], food))
+        {
+            bucket[i] = bucket.back();
+            bucket.pop_back();
+            return;
+        }
+    }
+}
+
+std::vector<SnakeBody>& World::bucketOf(const SnakeBody& cell)
+{
+    int x = std::min(this->mBucketsX - 1, std::max(0, (cell.getX() - 1) / kFoodBucket));
+    int y = std::min(this->mBucketsY - 1, std::max(0, (cell.getY() - 1) / kFoodBucket));
+    return this->mFoodBuckets[y * this->mBucketsX + x];
+}
+
+bool World::turn(int id, Direction direction)
+{
+    WorldSnake& snake = this->mSnakes[id];
+    if (!snake.alive || !isPerpendicular(snake.movedDirection, direction))
+    {
+        return false;
+    }
+    snake.direction = direction;
+    return true;
+}
+
+SnakeBody World::nextHead(const SnakeBody& head, Direction direction) const
+{
+    int headX = head.getX();
+    int headY = head.getY();
+    switch (direction) {
+        case Direction::Up:    headY--; break;
+        case Direction::Down:  headY++; break;
+        case Direction::Left:  headX--; break;
+        case Direction::Right: headX++; break;
+    }
+    // Same wrap-around as Snake::createNewHead
+    if (headX < 1) headX = this->mWidth - 2;
+    else if (headX >= this->mWidth - 1) headX = 1;
+    if (headY < 1) headY = this->mHeight - 2;
+    else if (headY >= this->mHeight - 1) headY = 1;
+    return SnakeBody(headX, headY);
+}
+
+int World::distance(const SnakeBody& a, const SnakeBody& b) const
+{
+    int innerWidth = this->mWidth - 2;
+    int innerHeight = this->mHeight - 2;
+    int dx = std::abs(a.getX() - b.getX());
+    int dy = std::abs(a.getY() - b.getY());
+    return std::min(dx, innerWidth - dx) + std::min(dy, innerHeight - dy);
+}
+
+int World::foodDistance(const SnakeBody& from) const
+{
+    int best = -1;
+    if (this->mFoods.size() <= kFoodScanLimit)
+    {
+        for (const SnakeBody& food : this->mFoods)
+        {
+            int d = this->distance(from, food);
+            best = best < 0 ? d : std::min(best, d);
+        }
+        return best;
+    }
+
+    // Walk square rings of buckets outwards. Between the start and a
+    // bucket r rings out lie at least r - 1 buckets along one axis, all
+    // full size except maybe the short one at the wrap seam, so nothing
+    // from ring r on can beat a food (r - 2) buckets away. Buckets that
+    // cannot beat the best food so far are not opened.
+    int innerWidth = this->mWidth - 2;
+    int innerHeight = this->mHeight - 2;
+    int fromX = std::min(this->mBucketsX - 1, std::max(0, (from.getX() - 1) / kFoodBucket));
+    int fromY = std::min(this->mBucketsY - 1, std::max(0, (from.getY() - 1) / kFoodBucket));
+    int rings = std::max(this->mBucketsX, this->mBucketsY) / 2 + 1;
+    for (int r = 0; r <= rings; r ++)
+    {
+        if (best >= 0 && best <= (r - 2) * kFoodBucket)
+        {
+            break;
+        }
+        for (int dy = -r; dy <= r; dy ++)
+        {
+            // Whole rows at the top and bottom, only the two ends between
+            int step = dy == -r || dy == r ? 1 : 2 * r;
+            for (int dx = -r; dx <= r; dx += step)
+            {
+                int x = ((fromX + dx) % this->mBucketsX + this->mBucketsX) % this->mBucketsX;
+                int y = ((fromY + dy) % this->mBucketsY + this->mBucketsY) % this->mBucketsY;
+                const std::vector<SnakeBody>& bucket = this->mFoodBuckets[y * this->mBucketsX + x];
+                if (bucket.empty())
+                {
+                    continue;
+                }
+                int bound = wrappedGap(from.getX(), x * kFoodBucket + 1, std::min(innerWidth, (x + 1) * kFoodBucket), innerWidth)
+                            + wrappedGap(from.getY(), y * kFoodBucket + 1, std::min(innerHeight, (y + 1) * kFoodBucket), innerHeight);
+                if (best >= 0 && bound >= best)
+                {
+                    continue;
+                }
+                for (const SnakeBody& food : bucket)
+                {
+                    int d = this->distance(from, food);
+                    best = best < 0 ? d : std::min(best, d);
+                }
+            }
+        }
+    }
+    return best;
+}
+
+void World::step()
+{
+    this->mTick ++;
+    int count = this->mSnakes.size();
+    this->mNewHeads.resize(count);
+    this->mEats.assign(count, 0);
+    this->mDying.assign(count, DeathCause::NONE);
+
+    // Plan every move before anything changes
+    for (int i = 0; i < count; i ++)
+    {
+        WorldSnake& snake = this->mSnakes[i];
+        if (!snake.alive)
+        {
+            continue;
+        }
+        this->mNewHeads[i] = this->nextHead(snake.body.front(), snake.direction);
+        const SnakeBody& head = this->mNewHeads[i];
+        this->mEats[i] = this->mIndex.get(head.getX(), head.getY()) == BoardIndex::kFood;
+    }
+
+    // Tails of snakes that do not grow leave their cells this tick
+    for (int i = 0; i < count; i ++)
+    {
+        const WorldSnake& snake = this->mSnakes[i];
+        if (snake.alive && !this->mEats[i])
+        {
+            this->mIndex.set(snake.body.back().getX(), snake.body.back().getY(), BoardIndex::kEmpty);
+        }
+    }
+
+    // Resolve conflicts with one index lookup per head
+    for (int i = 0; i < count; i ++)
+    {
+        const WorldSnake& snake = this->mSnakes[i];
+        if (!snake.alive)
+        {
+            continue;
+        }
+        const SnakeBody& head = this->mNewHeads[i];
+        int other = this->mIndex.claim(head.getX(), head.getY(), this->mTick, i);
+        if (other >= 0)
+        {
+            this->mDying[i] = DeathCause::HEAD_ON;
+            this->mDying[other] = DeathCause::HEAD_ON;
+            continue;
+        }
+
+        int32_t value = this->mIndex.get(head.getX(), head.getY());
+        if (value == BoardIndex::kObstacle)
+        {
+            this->mDying[i] = DeathCause::OBSTACLE;
+        }
+        else if (BoardIndex::isSnake(value))
+        {
+            int j = BoardIndex::snakeId(value);
+            if (j == i)
+            {
+                this->mDying[i] = DeathCause::SELF;
+            }
+            else if (samePosition(this->mSnakes[j].body.front(), head)
+                     && samePosition(this->mNewHeads[j], snake.body.front()))
+            {
+                this->mDying[i] = DeathCause::SWAP;
+                this->mDying[j] = DeathCause::SWAP;
+            }
+            else
+            {
+                this->mDying[i] = DeathCause::BODY;
+            }
+        }
+    }
+
+    // Apply: the dead vanish, everyone else moves
+    for (int i = 0; i < count; i ++)
+    {
+        WorldSnake& snake = this->mSnakes[i];
+        if (!snake.alive)
+        {
+            continue;
+        }
+        if (this->mDying[i] != DeathCause::NONE)
+        {
+            // The tail was already released above unless it was eating
+            int keep = this->mEats[i] ? snake.body.size() : snake.body.size() - 1;
+            for (int s = 0; s < keep; s ++)
+            {
+                this->mIndex.set(snake.body[s].getX(), snake.body[s].getY(), BoardIndex::kEmpty);
+            }
+            snake.alive = false;
+            snake.cause = this->mDying[i];
+            this->record(WorldEvent::Type::DIE, i, 0, 0, static_cast<int>(snake.cause), snake.human);
+        }
+    }
+    for (int i = 0; i < count; i ++)
+    {
+        WorldSnake& snake = this->mSnakes[i];
+        if (!snake.alive)
+        {
+            continue;
+        }
+        const SnakeBody& head = this->mNewHeads[i];
+        snake.body.push_front(head);
+        this->mIndex.set(head.getX(), head.getY(), BoardIndex::snakeValue(i));
+        snake.movedDirection = snake.direction;
+        this->record(this->mEats[i] ? WorldEvent::Type::GROW : WorldEvent::Type::MOVE,
+                     i, head.getX(), head.getY(), static_cast<int>(snake.direction), snake.human);
+        if (this->mEats[i])
+        {
+            snake.score ++;
+            this->removeFood(head);
+        }
+        else
+        {
+            snake.body.pop_back();
+        }
+    }
+
+    while (this->mFoods.size() < this->mFoodCount)
+    {
+        int before = this->mFoods.size();
+        this->spawnFood();
+        if (this->mFoods.size() == before)
+        {
+            break;
+        }
+    }
+}
+
+void World::killSnake(int id)
+{
+    WorldSnake& snake = this->mSnakes[id];
+    if (!snake.alive)
+    {
+        return;
+    }
+    this->clearBody(id);
+    snake.alive = false;
+    snake.cause = DeathCause::NONE;
+    this->record(WorldEvent::Type::DIE, id, 0, 0, static_cast<int>(DeathCause::NONE), snake.human);
+}
+
+void World::clearBody(int id)
+{
+    // A head of another snake may already sit on our old tail cell
+    for (const SnakeBody& part : this->mSnakes[id].body)
+    {
+        if (this->mIndex.get(part.getX(), part.getY()) == BoardIndex::snakeValue(id))
+        {
+            this->mIndex.set(part.getX(), part.getY(), BoardIndex::kEmpty);
+        }
+    }
+}
+
+void World::setRecordEvents(bool record)
+{
+    this->mRecordEvents = record;
+    this->mEvents.clear();
+}
+
+void World::record(WorldEvent::Type type, int id, int x, int y, int value, bool human)
+{
+    if (this->mRecordEvents)
+    {
+        this->mEvents.push_back(WorldEvent{type, id, x, y, value, human});
+    }
+}
+
+void World::takeEvents(std::vector<WorldEvent>& events)
+{
+    events.clear();
+    events.swap(this->mEvents);
+}
+
+void World::apply(const WorldEvent& event)
+{
+    if (event.type == WorldEvent::Type::FOOD)
+    {
+        this->restoreFood(SnakeBody(event.x, event.y));
+        return;
+    }
+    if (event.id >= this->mSnakes.size())
+    {
+        this->mSnakes.resize(event.id + 1, deadSnake());
+    }
+    WorldSnake& snake = this->mSnakes[event.id];
+    switch (event.type)
+    {
+        case WorldEvent::Type::MOVE:
+        case WorldEvent::Type::GROW:
+        {
+            if (!snake.alive)
+            {
+                return;
+            }
+            // Only the direction is sent, the head follows from it
+            SnakeBody head = this->nextHead(snake.body.front(), static_cast<Direction>(event.value));
+            if (event.type == WorldEvent::Type::GROW)
+            {
+                snake.score ++;
+                if (this->mIndex.get(head.getX(), head.getY()) == BoardIndex::kFood)
+                {
+                    this->removeFood(head);
+                }
+            }
+            else
+            {
+                // Events come in snake order, so a lower id may already
+                // have moved its head onto this tail
+                const SnakeBody& tail = snake.body.back();
+                if (this->mIndex.get(tail.getX(), tail.getY()) == BoardIndex::snakeValue(event.id))
+                {
+                    this->mIndex.set(tail.getX(), tail.getY(), BoardIndex::kEmpty);
+                }
+                snake.body.pop_back();
+            }
+            snake.body.push_front(head);
+            this->mIndex.set(head.getX(), head.getY(), BoardIndex::snakeValue(event.id));
+            snake.direction = static_cast<Direction>(event.value);
+            snake.movedDirection = snake.direction;
+            break;
+        }
+        case WorldEvent::Type::DIE:
+            if (snake.alive)
+            {
+                this->clearBody(event.id);
+            }
+            snake.alive = false;
+            snake.cause = static_cast<DeathCause>(event.value);
+            break;
+        case WorldEvent::Type::SPAWN:
+        {
+            WorldSnake spawned = snake;
+            spawned.body.clear();
+            for (int i = 0; i < event.value; i ++)
+            {
+                spawned.body.push_back(SnakeBody(event.x, event.y + i));
+            }
+            spawned.direction = Direction::Up;
+            spawned.movedDirection = Direction::Up;
+            spawned.alive = true;
+            spawned.human = event.human;
+            spawned.cause = DeathCause::NONE;
+            this->restoreSnake(event.id, spawned);
+            break;
+        }
+        case WorldEvent::Type::FOOD:
+            break;
+    }
+}
+
+void World::clearState()
+{
+    for (int i = 0; i < this->mSnakes.size(); i ++)
+    {
+        if (this->mSnakes[i].alive)
+        {
+            this->clearBody(i);
+        }
+    }
+    for (const SnakeBody& food : this->mFoods)
+    {
+        this->mIndex.set(food.getX(), food.getY(), BoardIndex::kEmpty);
+    }
+    this->mSnakes.clear();
+    this->mFoods.clear();
+    for (std::vector<SnakeBody>& bucket : this->mFoodBuckets)
+    {
+        bucket.clear();
+    }
+}
+
+void World::restoreSnake(int id, const WorldSnake& snake)
+{
+    if (id >= this->mSnakes.size())
+    {
+        this->mSnakes.resize(id + 1, deadSnake());
+    }
+    else if (this->mSnakes[id].alive)
+    {
+        this->clearBody(id);
+    }
+    this->mSnakes[id] = snake;
+    if (snake.alive)
+    {
+        for (const SnakeBody& part : snake.body)
+        {
+            this->mIndex.set(part.getX(), part.getY(), BoardIndex::snakeValue(id));
+        }
+    }
+}
+
+void World::restoreFood(const SnakeBody& food)
+{
+    if (this->mIndex.get(food.getX(), food.getY()) == BoardIndex::kFood)
+    {
+        return;
+    }
+    this->addFood(food);
+}
+
+void World::setTick(uint32_t tick)
+{
+    this->mTick = tick;
+}
+
+void World::copyFood(const World& other)
+{
+    for (const SnakeBody& food : this->mFoods)
+    {
+        this->mIndex.set(food.getX(), food.getY(), BoardIndex::kEmpty);
+        // All the food in it is going
+        this->bucketOf(food).clear();
+    }
+    this->mFoods.clear();
+    for (const SnakeBody& food : other.mFoods)
+    {
+        if (this->mIndex.get(food.getX(), food.getY()) == BoardIndex::kEmpty)
+        {
+            this->addFood(food);
+        }
+    }
+}
+
+uint64_t World::stateHash() const
+{
+    return this->boardHash() ^ mixBits(this->mTick) ^ mixBits(this->mRng.getState() + 1);
+}
+
+uint64_t World::boardHash() const
+{
+    uint64_t hash = this->snakeHash();
+    for (const SnakeBody& food : this->mFoods)
+    {
+        uint64_t cell = static_cast<uint64_t>(food.getY()) * this->mWidth + food.getX();
+        hash ^= mixBits(cell << 24 ^ static_cast<uint32_t>(BoardIndex::kFood));
+    }
+    return hash;
+}
+
+uint64_t World::snakeHash() const
+{
+    // Every (cell, contents) pair has its own key and the board is the XOR
+    // of the keys of its occupied cells. Keys are mixed from the pair
+    // instead of being kept in a table of width * height * snakes.
+    uint64_t hash = 0;
+    int width = this->mWidth;
+    this->mIndex.forEachOccupied([&hash, width](int x, int y, int32_t value) {
+        if (value == BoardIndex::kFood)
+        {
+            return;
+        }
+        uint64_t cell = static_cast<uint64_t>(y) * width + x;
+        hash ^= mixBits(cell << 24 ^ static_cast<uint32_t>(value));
+    });
+    // Cells do not say which end of a body is the head
+    for (int i = 0; i < this->mSnakes.size(); i ++)
+    {
+        const WorldSnake& snake = this->mSnakes[i];
+        uint32_t flags = static_cast<int>(snake.direction) << 3
+                         | static_cast<int>(snake.movedDirection) << 1
+                         | (snake.alive ? 1 : 0);
+        hash ^= snakeKey(i, FLAGS, flags) ^ snakeKey(i, SCORE, snake.score);
+        if (snake.alive)
+        {
+            hash ^= snakeKey(i, HEAD_X, snake.body.front().getX())
+                    ^ snakeKey(i, HEAD_Y, snake.body.front().getY())
+                    ^ snakeKey(i, LENGTH, snake.body.size());
+        }
+    }
+    return hash;
+}
+
+int World::getWidth() const
+{
+    return this->mWidth;
+}
+
+int World::getHeight() const
+{
+    return this->mHeight;
+}
+
+uint32_t World::getTick() const
+{
+    return this->mTick;
+}
+
+int World::getAliveCount() const
+{
+    int alive = 0;
+    for (const WorldSnake& snake : this->mSnakes)
+    {
+        alive += snake.alive;
+    }
+    return alive;
+}
+
+const std::vector<WorldSnake>& World::getSnakes() const
+{
+    return this->mSnakes;
+}
+
+const std::vector<SnakeBody>& World::getFoods() const
+{
+    return this->mFoods;
+}
+
+const std::vector<Obstacle>& World::getObstacles() const
+{
+    return this->mObstacles;
+}
+
+const BoardIndex& World::getIndex() const
+{
+    return this->mIndex;
+}
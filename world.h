@@ -0,0 +1,160 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "snake.h"
+#include "map.h"
+#include "board_index.h"
+#include "rng.h"
+
+enum class DeathCause
+{
+    NONE,
+    OBSTACLE,
+    SELF,
+    BODY,       // ran into another snake
+    HEAD_ON,    // two heads entered the same cell
+    SWAP,       // two heads tried to pass through each other
+};
+
+struct WorldSnake
+{
+    // front() is the head
+    std::deque<SnakeBody> body;
+    Direction direction;
+    // Direction of the last move, turns are checked against it
+    Direction movedDirection;
+    bool alive;
+    bool human;
+    int score;
+    DeathCause cause;
+};
+
+// One change made by World, enough to replay it on a copy of the board.
+// The server sends these instead of whole boards, see protocol.h
+struct WorldEvent
+{
+    enum class Type
+    {
+        MOVE,   // head moved one cell, tail followed
+        GROW,   // head moved onto food, tail stayed
+        DIE,
+        SPAWN,  // vertical body heading up, head at (x, y)
+        FOOD,   // food appeared at (x, y)
+    };
+    Type type;
+    int id;
+    int x;
+    int y;
+    // Direction for MOVE and GROW, cause for DIE, length for SPAWN
+    int value;
+    bool human;
+};
+
+// Board with any number of snakes moving at the same time. Unlike Snake,
+// nothing here is per-snake: obstacles, food and every body segment live
+// in one BoardIndex and all collisions are resolved through it.
+//
+// Worlds are plain values: copying one is a snapshot and assigning it
+// back restores it.
+//
+// Movement follows Snake: the playable area is [1, width-2] x [1, height-2]
+// and heads wrap around its edges. Snakes are at least two cells long, so a
+// tail leaving a cell frees it for a head entering during the same tick.
+class World
+{
+public:
+    World(int width, int height, const std::vector<Obstacle>& obstacles, uint64_t seed);
+
+    // Places a vertical snake heading up on free cells, -1 when no room
+    int spawnSnake(int length, bool human);
+    // Brings a dead snake back somewhere else with a fresh body.
+    // False when there is no room right now.
+    bool respawnSnake(int id, int length);
+    // Keep this many food items on the board
+    void setFoodCount(int count);
+    // Perpendicular turns only, like Snake::changeDirection
+    bool turn(int id, Direction direction);
+    // Moves every living snake one cell at the same time
+    void step();
+    // Removes a snake from the board, e.g. when its player left
+    void killSnake(int id);
+
+    // Events are only kept when asked for, local games do not pay for them
+    void setRecordEvents(bool record);
+    // Moves everything recorded since the last call into events
+    void takeEvents(std::vector<WorldEvent>& events);
+    // Replays a recorded event on a replica of the recording world
+    void apply(const WorldEvent& event);
+    // Replica setup from a full snapshot, starting from a board with
+    // only the obstacles left
+    void clearState();
+    void restoreSnake(int id, const WorldSnake& snake);
+    void restoreFood(const SnakeBody& food);
+    void setTick(uint32_t tick);
+    // Swaps this world's food for the other one's, leaving out any that
+    // would land on a snake here. A prediction takes the server's food
+    // this way, since the food it would spawn itself is random.
+    void copyFood(const World& other);
+
+    SnakeBody nextHead(const SnakeBody& head, Direction direction) const;
+    // Manhattan distance across the wrapping playable area
+    int distance(const SnakeBody& a, const SnakeBody& b) const;
+    // Distance to the closest food, -1 when there is none. Searches the
+    // food buckets around the cell, so the cost does not grow with the
+    // amount of food on big boards.
+    int foodDistance(const SnakeBody& from) const;
+    // Zobrist style hash of everything that affects later ticks: board
+    // cells, snake heads and lengths, directions, scores and the Rng
+    uint64_t stateHash() const;
+    // The same without tick and Rng, i.e. only what is on the board
+    uint64_t boardHash() const;
+    // The board without its food, for a copy that does not spawn any
+    uint64_t snakeHash() const;
+
+    int getWidth() const;
+    int getHeight() const;
+    uint32_t getTick() const;
+    int getAliveCount() const;
+    const std::vector<WorldSnake>& getSnakes() const;
+    const std::vector<SnakeBody>& getFoods() const;
+    const std::vector<Obstacle>& getObstacles() const;
+    const BoardIndex& getIndex() const;
+
+private:
+    // Finds a free column for a new body, false when the board is too full
+    bool placeBody(int id, int length, WorldSnake& snake);
+    void spawnFood();
+    void addFood(const SnakeBody& food);
+    void removeFood(const SnakeBody& food);
+    std::vector<SnakeBody>& bucketOf(const SnakeBody& cell);
+    // Clears the cells of a snake that still belong to it
+    void clearBody(int id);
+    void record(WorldEvent::Type type, int id, int x, int y, int value, bool human);
+
+    // Not const, so that a World can be assigned as a snapshot
+    int mWidth;
+    int mHeight;
+    BoardIndex mIndex;
+    Rng mRng;
+    uint32_t mTick;
+    int mFoodCount;
+    std::vector<Obstacle> mObstacles;
+    std::vector<WorldSnake> mSnakes;
+    std::vector<SnakeBody> mFoods;
+    // The same food again, sorted into square buckets of the playable area
+    int mBucketsX;
+    int mBucketsY;
+    std::vector<std::vector<SnakeBody>> mFoodBuckets;
+    bool mRecordEvents;
+    std::vector<WorldEvent> mEvents;
+    // Per-tick scratch space, kept to avoid allocating every step
+    std::vector<SnakeBody> mNewHeads;
+    std::vector<char> mEats;
+    std::vector<DeathCause> mDying;
+};
+
+#endif